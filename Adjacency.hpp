@@ -0,0 +1,374 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef ADJACENCY_HPP
+#define ADJACENCY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class Direction {
+    Outgoing,
+    Incoming,
+    Both,
+};
+
+// Compressed sparse row view of edges between node slots. Neighbours of a slot are contiguous,
+// so traversals read adjacency sequentially instead of scanning the whole edge list.
+struct Adjacency {
+    // Neighbour list of one slot, edited in memory in place of the list in a mapped base.
+    struct Patch {
+        std::vector<uint32_t> targets;
+        // Parallel to targets when the graph is weighted.
+        std::vector<float> weights;
+        // Undirected adjacency only: whether targets[i] is the source of an edge into the slot.
+        std::vector<bool> incoming;
+    };
+
+    // Arrays of an adjacency built in memory, empty for a view of mapped storage.
+    std::vector<size_t> owned_offsets{0};
+    std::vector<uint32_t> owned_targets;
+    std::vector<float> owned_weights;
+    // Keeps the storage behind a view alive.
+    std::shared_ptr<const void> mapping;
+
+    std::span<const size_t> offsets{owned_offsets};
+    std::span<const uint32_t> targets;
+    // Weight of targets[i], empty when the graph has no weighted edges.
+    std::span<const float> weights;
+
+    // Changes made since a mapped base was written, see AdjacencyOverlay. A patch replaces the base list of
+    // its slot, and slots past the base without a patch have no neighbours.
+    std::unordered_map<uint32_t, Patch> patches;
+    size_t added_slots = 0;
+    std::ptrdiff_t added_edges = 0;
+
+    Adjacency() = default;
+
+    // Moving a vector keeps its buffer, so the spans stay valid.
+    Adjacency(Adjacency &&) noexcept = default;
+
+    auto operator=(Adjacency &&) noexcept -> Adjacency & = default;
+
+    Adjacency(const Adjacency &other)
+        : owned_offsets(other.owned_offsets), owned_targets(other.owned_targets),
+          owned_weights(other.owned_weights), mapping(other.mapping), offsets(other.offsets),
+          targets(other.targets), weights(other.weights), patches(other.patches), added_slots(other.added_slots),
+          added_edges(other.added_edges) {
+        if (!mapping) {
+            rebind();
+        }
+    }
+
+    auto operator=(const Adjacency &other) -> Adjacency & {
+        if (this != &other) {
+            *this = Adjacency(other);
+        }
+        return *this;
+    }
+
+    // Adjacency over arrays owned by someone else, e.g. a mapped file kept alive by mapping.
+    static auto view(const std::span<const size_t> offsets, const std::span<const uint32_t> targets,
+                     const std::span<const float> weights, std::shared_ptr<const void> mapping) -> Adjacency {
+        Adjacency adjacency;
+        adjacency.owned_offsets.clear();
+        adjacency.mapping = std::move(mapping);
+        adjacency.offsets = offsets;
+        adjacency.targets = targets;
+        adjacency.weights = weights;
+        return adjacency;
+    }
+
+    // Edges are (from slot, to slot) pairs. Both direction stores every edge in both endpoints.
+    // weights is either empty or parallel to edges.
+    static auto build(const size_t node_count, const std::vector<std::pair<uint32_t, uint32_t> > &edges,
+                      const Direction direction, const std::vector<float> &weights = {}) -> Adjacency {
+        Adjacency adjacency;
+        auto &offsets = adjacency.owned_offsets;
+        auto &targets = adjacency.owned_targets;
+        offsets.assign(node_count + 1, 0);
+
+        auto add_degrees = [&](const uint32_t from, const uint32_t to) {
+            if (direction != Direction::Incoming) ++offsets[from + 1];
+            if (direction != Direction::Outgoing) ++offsets[to + 1];
+        };
+        for (const auto &[from, to]: edges) {
+            add_degrees(from, to);
+        }
+        for (size_t slot = 0; slot < node_count; ++slot) {
+            offsets[slot + 1] += offsets[slot];
+        }
+
+        targets.resize(offsets.back());
+        adjacency.owned_weights.resize(weights.empty() ? 0 : targets.size());
+        auto cursor = std::vector(offsets.begin(), offsets.end() - 1);
+        auto place = [&](const uint32_t source, const uint32_t target, const size_t edge) {
+            if (!weights.empty()) adjacency.owned_weights[cursor[source]] = weights[edge];
+            targets[cursor[source]++] = target;
+        };
+        for (size_t edge = 0; edge < edges.size(); ++edge) {
+            const auto [from, to] = edges[edge];
+            if (direction != Direction::Incoming) place(from, to, edge);
+            if (direction != Direction::Outgoing) place(to, from, edge);
+        }
+        adjacency.rebind();
+        return adjacency;
+    }
+
+    // Adjacency among the given slots only, each renumbered to its position in slots. Neighbours outside
+    // slots are dropped, weights are kept.
+    [[nodiscard]]
+    auto restricted_to(const std::vector<uint32_t> &slots) const -> Adjacency {
+        constexpr auto absent = std::numeric_limits<uint32_t>::max();
+        auto number = std::vector<uint32_t>(node_count(), absent);
+        for (uint32_t index = 0; index < slots.size(); ++index) {
+            number[slots[index]] = index;
+        }
+
+        Adjacency adjacency;
+        auto &offsets = adjacency.owned_offsets;
+        offsets.assign(slots.size() + 1, 0);
+        for (size_t index = 0; index < slots.size(); ++index) {
+            offsets[index + 1] = offsets[index] + static_cast<size_t>(std::ranges::count_if(
+                                     neighbors(slots[index]), [&](const uint32_t target) {
+                                         return number[target] != absent;
+                                     }));
+        }
+        adjacency.owned_targets.reserve(offsets.back());
+        adjacency.owned_weights.reserve(weights.empty() ? 0 : offsets.back());
+        for (const auto slot: slots) {
+            const auto targets_of = neighbors(slot);
+            const auto weights_of = neighbor_weights(slot);
+            for (size_t i = 0; i < targets_of.size(); ++i) {
+                if (number[targets_of[i]] != absent) {
+                    adjacency.owned_targets.push_back(number[targets_of[i]]);
+                    if (!weights_of.empty()) {
+                        adjacency.owned_weights.push_back(weights_of[i]);
+                    }
+                }
+            }
+        }
+        adjacency.rebind();
+        return adjacency;
+    }
+
+    [[nodiscard]]
+    auto node_count() const -> size_t {
+        return base_node_count() + added_slots;
+    }
+
+    [[nodiscard]]
+    auto edge_count() const -> size_t {
+        return static_cast<size_t>(static_cast<std::ptrdiff_t>(targets.size()) + added_edges);
+    }
+
+    // Heap bytes only, a mapped view is accounted to the page cache.
+    [[nodiscard]]
+    auto memory_usage() const -> size_t {
+        auto bytes = owned_offsets.capacity() * sizeof(size_t) + owned_targets.capacity() * sizeof(uint32_t)
+                     + owned_weights.capacity() * sizeof(float);
+        for (const auto &patch: patches | std::views::values) {
+            bytes += sizeof(std::pair<const uint32_t, Patch>) + 2 * sizeof(void *) + patch.targets.capacity() *
+                     sizeof(uint32_t) + patch.weights.capacity() * sizeof(float) + patch.incoming.capacity() / 8;
+        }
+        return bytes;
+    }
+
+    [[nodiscard]]
+    auto degree(const size_t slot) const -> size_t {
+        return neighbors(slot).size();
+    }
+
+    [[nodiscard]]
+    auto neighbors(const size_t slot) const -> std::span<const uint32_t> {
+        if (const auto *patch = patch_of(slot)) {
+            return patch->targets;
+        }
+        if (slot >= base_node_count()) {
+            return {};
+        }
+        return {targets.data() + offsets[slot], offsets[slot + 1] - offsets[slot]};
+    }
+
+    // Weights of neighbors(slot) in the same order, empty for an unweighted graph.
+    [[nodiscard]]
+    auto neighbor_weights(const size_t slot) const -> std::span<const float> {
+        if (const auto *patch = patch_of(slot)) {
+            return patch->weights;
+        }
+        if (weights.empty() || slot >= base_node_count()) {
+            return {};
+        }
+        return {weights.data() + offsets[slot], offsets[slot + 1] - offsets[slot]};
+    }
+
+    [[nodiscard]]
+    auto patch_of(const size_t slot) const -> const Patch * {
+        if (patches.empty()) {
+            return nullptr;
+        }
+        const auto it = patches.find(static_cast<uint32_t>(slot));
+        return it == patches.end() ? nullptr : &it->second;
+    }
+
+private:
+    [[nodiscard]]
+    auto base_node_count() const -> size_t {
+        return offsets.size() - 1;
+    }
+
+    auto rebind() -> void {
+        offsets = owned_offsets;
+        targets = owned_targets;
+        weights = owned_weights;
+    }
+};
+
+// Outgoing, incoming and undirected adjacency of a mapped graph, kept current while the graph changes by
+// patching the lists of the slots a change touches, so the mapped CSR is not read and built again. A list
+// is copied from the base the first time it changes. Undirected lists keep the outgoing entries followed by
+// the incoming ones and flag the latter, so removing u -> v drops v from u's list but not the entry of v -> u.
+class AdjacencyOverlay {
+    Adjacency &outgoing;
+    Adjacency &incoming;
+    Adjacency &both;
+    bool weighted;
+
+    auto patch(Adjacency &adjacency, const uint32_t slot) -> Adjacency::Patch & {
+        if (const auto it = adjacency.patches.find(slot); it != adjacency.patches.end()) {
+            return it->second;
+        }
+        const auto targets = adjacency.neighbors(slot);
+        auto patch = Adjacency::Patch{{targets.begin(), targets.end()}, weighted ? weights_of(adjacency, slot)
+                                                                                  : std::vector<float>{}, {}};
+        return adjacency.patches.emplace(slot, std::move(patch)).first->second;
+    }
+
+    // Taken before the outgoing and incoming lists of the slot change, which it is built from.
+    auto patch_both(const uint32_t slot) -> Adjacency::Patch & {
+        const auto [it, inserted] = both.patches.try_emplace(slot);
+        if (inserted) {
+            auto &patch = it->second;
+            for (const auto *source: {&outgoing, &incoming}) {
+                const auto targets = source->neighbors(slot);
+                patch.targets.insert(patch.targets.end(), targets.begin(), targets.end());
+                patch.incoming.resize(patch.targets.size(), source == &incoming);
+                if (weighted) {
+                    const auto weights = weights_of(*source, slot);
+                    patch.weights.insert(patch.weights.end(), weights.begin(), weights.end());
+                }
+            }
+        }
+        return it->second;
+    }
+
+    [[nodiscard]]
+    static auto weights_of(const Adjacency &adjacency, const uint32_t slot) -> std::vector<float> {
+        const auto weights = adjacency.neighbor_weights(slot);
+        if (weights.empty()) {
+            return std::vector(adjacency.degree(slot), 1.0f);
+        }
+        return {weights.begin(), weights.end()};
+    }
+
+    static auto push(Adjacency &adjacency, Adjacency::Patch &patch, const uint32_t target, const float weight,
+                     const bool weighted) -> void {
+        patch.targets.push_back(target);
+        if (weighted) {
+            patch.weights.push_back(weight);
+        }
+        ++adjacency.added_edges;
+    }
+
+    // Drops the entries for which drop(target, incoming) holds.
+    template<typename Drop>
+    static auto erase(Adjacency &adjacency, Adjacency::Patch &patch, Drop drop) -> void {
+        size_t write = 0;
+        for (size_t read = 0; read < patch.targets.size(); ++read) {
+            const auto from_incoming = !patch.incoming.empty() && patch.incoming[read];
+            if (drop(patch.targets[read], from_incoming)) {
+                continue;
+            }
+            patch.targets[write] = patch.targets[read];
+            if (!patch.weights.empty()) {
+                patch.weights[write] = patch.weights[read];
+            }
+            if (!patch.incoming.empty()) {
+                patch.incoming[write] = from_incoming;
+            }
+            ++write;
+        }
+        adjacency.added_edges -= static_cast<std::ptrdiff_t>(patch.targets.size() - write);
+        patch.targets.resize(write);
+        patch.weights.resize(patch.weights.empty() ? 0 : write);
+        patch.incoming.resize(patch.incoming.empty() ? 0 : write);
+    }
+
+public:
+    AdjacencyOverlay(Adjacency &outgoing, Adjacency &incoming, Adjacency &both, const bool weighted)
+        : outgoing(outgoing), incoming(incoming), both(both), weighted(weighted) {
+    }
+
+    // A node appended after the last slot, without edges yet.
+    auto add_slot() -> void {
+        for (auto *adjacency: {&outgoing, &incoming, &both}) {
+            ++adjacency->added_slots;
+        }
+    }
+
+    auto add_edge(const uint32_t from, const uint32_t to, const float weight) -> void {
+        auto &both_from = patch_both(from);
+        auto &both_to = patch_both(to);
+        push(outgoing, patch(outgoing, from), to, weight, weighted);
+        push(incoming, patch(incoming, to), from, weight, weighted);
+        push(both, both_from, to, weight, weighted);
+        both_from.incoming.push_back(false);
+        push(both, both_to, from, weight, weighted);
+        both_to.incoming.push_back(true);
+    }
+
+    // Every edge from -> to was removed.
+    auto remove_edges(const uint32_t from, const uint32_t to) -> void {
+        erase(both, patch_both(from), [to](const uint32_t target, const bool from_incoming) {
+            return target == to && !from_incoming;
+        });
+        erase(both, patch_both(to), [from](const uint32_t target, const bool from_incoming) {
+            return target == from && from_incoming;
+        });
+        erase(outgoing, patch(outgoing, from), [to](const uint32_t target, bool) { return target == to; });
+        erase(incoming, patch(incoming, to), [from](const uint32_t target, bool) { return target == from; });
+    }
+
+    // The node in slot was removed: its lists empty and its neighbours no longer list it.
+    auto remove_slot(const uint32_t slot) -> void {
+        const auto sources = std::vector(incoming.neighbors(slot).begin(), incoming.neighbors(slot).end());
+        const auto targets = std::vector(outgoing.neighbors(slot).begin(), outgoing.neighbors(slot).end());
+        auto is_slot = [slot](const uint32_t target, bool) { return target == slot; };
+        for (const auto source: sources) {
+            erase(both, patch_both(source), [slot](const uint32_t target, const bool from_incoming) {
+                return target == slot && !from_incoming;
+            });
+            erase(outgoing, patch(outgoing, source), is_slot);
+        }
+        for (const auto target: targets) {
+            erase(both, patch_both(target), [slot](const uint32_t other, const bool from_incoming) {
+                return other == slot && from_incoming;
+            });
+            erase(incoming, patch(incoming, target), is_slot);
+        }
+        for (auto *adjacency: {&outgoing, &incoming, &both}) {
+            auto &own = adjacency == &both ? patch_both(slot) : patch(*adjacency, slot);
+            erase(*adjacency, own, [](uint32_t, bool) { return true; });
+        }
+    }
+};
+
+#endif //ADJACENCY_HPP
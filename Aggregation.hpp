@@ -0,0 +1,207 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef AGGREGATION_HPP
+#define AGGREGATION_HPP
+
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Database.hpp"
+
+struct Aggregate {
+    enum class Kind { Count, Sum, Avg, Min, Max };
+
+    static const inline std::vector<std::string> valid_values{"COUNT", "SUM", "AVG", "MIN", "MAX"};
+
+    Kind kind{};
+    // Empty only for COUNT(*).
+    std::string field;
+
+    // Parses a single aggregate call, e.g. COUNT(*) or SUM("salary").
+    static auto parse(const std::string_view token) -> Aggregate {
+        const auto open = token.find('(');
+        if (open == std::string_view::npos || !token.ends_with(')')) {
+            throw std::invalid_argument(std::format("Invalid aggregate: {}", token));
+        }
+
+        const auto name = token.substr(0, open);
+        const auto it = std::ranges::find(valid_values, name);
+        if (it == valid_values.end()) {
+            throw std::invalid_argument(std::format("Unsupported aggregate: {}", name));
+        }
+
+        auto aggregate = Aggregate{};
+        aggregate.kind = static_cast<Kind>(it - valid_values.begin());
+
+        const auto argument = std::string(token.substr(open + 1, token.size() - open - 2));
+        if (argument == "*") {
+            if (aggregate.kind != Kind::Count) {
+                throw std::invalid_argument(std::format("{} requires a field", name));
+            }
+            return aggregate;
+        }
+        std::istringstream(argument) >> std::quoted(aggregate.field);
+        if (aggregate.field.empty()) {
+            throw std::invalid_argument(std::format("Invalid aggregate argument: {}", argument));
+        }
+        return aggregate;
+    }
+
+    [[nodiscard]]
+    auto label() const -> std::string {
+        const auto &name = valid_values[static_cast<size_t>(kind)];
+        return field.empty() ? std::format("{}(*)", name) : std::format("{}(\"{}\")", name, field);
+    }
+};
+
+// Running state of one aggregate within one group. Updated in place, so a scan never keeps matched nodes.
+struct Accumulator {
+    size_t count = 0;
+    double sum = 0.0;
+    std::optional<BasicValue> min;
+    std::optional<BasicValue> max;
+
+    auto add(const Aggregate &aggregate, const Node &node) -> void {
+        if (aggregate.field.empty()) {
+            ++count;
+            return;
+        }
+
+        const auto value = node.field(aggregate.field);
+        if (!value) {
+            return;
+        }
+        switch (aggregate.kind) {
+            case Aggregate::Kind::Count:
+                ++count;
+                break;
+            case Aggregate::Kind::Sum:
+            case Aggregate::Kind::Avg:
+                if (value->is_numeric()) {
+                    ++count;
+                    sum += value->as_number();
+                }
+                break;
+            case Aggregate::Kind::Min:
+                if (!min || *value < *min) {
+                    min = *value;
+                }
+                break;
+            case Aggregate::Kind::Max:
+                if (!max || *value > *max) {
+                    max = *value;
+                }
+                break;
+        }
+    }
+
+    [[nodiscard]]
+    auto result(const Aggregate &aggregate) const -> std::string {
+        switch (aggregate.kind) {
+            case Aggregate::Kind::Count:
+                return std::to_string(count);
+            case Aggregate::Kind::Sum:
+                return std::format("{}", sum);
+            case Aggregate::Kind::Avg:
+                return count == 0 ? "null" : std::format("{}", sum / static_cast<double>(count));
+            case Aggregate::Kind::Min:
+                return min ? min->toString() : "null";
+            case Aggregate::Kind::Max:
+                return max ? max->toString() : "null";
+        }
+        return "null";
+    }
+};
+
+// Hash aggregation keyed by the raw value of the GROUP BY field. Nodes without that field form their own group.
+class GroupedAggregation {
+public:
+    using Key = std::optional<BasicValue::Data>;
+
+private:
+    std::vector<Aggregate> aggregates;
+    std::optional<std::string> group_field;
+    std::unordered_map<Key, std::vector<Accumulator> > groups;
+
+public:
+    GroupedAggregation(std::vector<Aggregate> aggregates, std::optional<std::string> group_field)
+        : aggregates(std::move(aggregates)), group_field(std::move(group_field)) {
+    }
+
+    auto add(const Node &node) -> void {
+        auto key = Key{};
+        if (group_field) {
+            if (const auto value = node.field(*group_field)) {
+                key = value->data;
+            }
+        }
+
+        auto [it, inserted] = groups.try_emplace(std::move(key));
+        if (inserted) {
+            it->second.resize(aggregates.size());
+        }
+        for (size_t i = 0; i < aggregates.size(); ++i) {
+            it->second[i].add(aggregates[i], node);
+        }
+    }
+
+    // Seeds a group from a precomputed counter instead of scanning. Only meaningful for COUNT(*).
+    auto add_count(Key key, const size_t count) -> void {
+        auto [it, inserted] = groups.try_emplace(std::move(key));
+        if (inserted) {
+            it->second.resize(aggregates.size());
+        }
+        for (auto &accumulator: it->second) {
+            accumulator.count += count;
+        }
+    }
+
+    // Rows print() writes.
+    [[nodiscard]]
+    auto row_count() const -> size_t {
+        return groups.empty() && !group_field ? 1 : groups.size();
+    }
+
+    auto print() const -> void {
+        auto header = std::string{};
+        if (group_field) {
+            header += std::format("\"{}\" | ", *group_field);
+        }
+        for (size_t i = 0; i < aggregates.size(); ++i) {
+            header += aggregates[i].label();
+            if (i + 1 < aggregates.size()) header += " | ";
+        }
+        fmt::println("{}", header);
+
+        if (groups.empty() && !group_field) {
+            // An aggregate over no rows still yields one row, e.g. COUNT(*) = 0.
+            print_row(std::nullopt, std::vector<Accumulator>(aggregates.size()));
+        }
+        for (const auto &[key, accumulators]: groups) {
+            print_row(key, accumulators);
+        }
+    }
+
+private:
+    auto print_row(const Key &key, const std::vector<Accumulator> &accumulators) const -> void {
+        auto row = std::string{};
+        if (group_field) {
+            row += key ? BasicValue(*key).toString() : "null";
+            row += " | ";
+        }
+        for (size_t i = 0; i < aggregates.size(); ++i) {
+            row += accumulators[i].result(aggregates[i]);
+            if (i + 1 < aggregates.size()) row += " | ";
+        }
+        fmt::println("{}", row);
+    }
+};
+
+#endif //AGGREGATION_HPP
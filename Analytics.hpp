@@ -0,0 +1,323 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef ANALYTICS_HPP
+#define ANALYTICS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#include "Adjacency.hpp"
+#include "Parallel.hpp"
+#include "SetKernels.hpp"
+
+struct PageRankResult {
+    std::vector<float> ranks;
+    int iterations = 0;
+};
+
+struct DegreeDistribution {
+    // degree -> number of nodes with that degree
+    std::map<size_t, size_t> outgoing;
+    std::map<size_t, size_t> incoming;
+};
+
+struct TriangleCounts {
+    // Triangles through every slot, edge directions ignored.
+    std::vector<uint64_t> triangles;
+    // Distinct neighbours of every slot, edge directions and self loops ignored.
+    std::vector<uint32_t> degrees;
+    uint64_t total = 0;
+
+    // Share of neighbour pairs of the slot that are connected themselves, 0 below two neighbours.
+    [[nodiscard]]
+    auto clustering(const size_t slot) const -> double {
+        const auto degree = static_cast<double>(degrees[slot]);
+        return degrees[slot] < 2 ? 0.0 : 2.0 * static_cast<double>(triangles[slot]) / (degree * (degree - 1));
+    }
+
+    // Closed share of all connected triples, the global clustering coefficient.
+    [[nodiscard]]
+    auto transitivity() const -> double {
+        double triples = 0;
+        for (const auto degree: degrees) {
+            triples += static_cast<double>(degree) * (static_cast<double>(degree) - 1) / 2;
+        }
+        return triples == 0 ? 0.0 : 3.0 * static_cast<double>(total) / triples;
+    }
+};
+
+// Whole-graph algorithms over CSR adjacency, parallelized across contiguous chunks of node slots.
+struct Analytics {
+    static constexpr auto unassigned = std::numeric_limits<uint32_t>::max();
+
+    // Pull-based PageRank: every node sums contributions of its predecessors, so each worker only
+    // writes its own chunk of the rank array and no atomics are needed. Dangling nodes spread their
+    // rank uniformly.
+    static auto pagerank(const Adjacency &outgoing, const Adjacency &incoming, const float damping = 0.85f,
+                         const int max_iterations = 50, const double tolerance = 1e-6) -> PageRankResult {
+        const auto node_count = outgoing.node_count();
+        auto result = PageRankResult{};
+        if (node_count == 0) {
+            return result;
+        }
+
+        const auto workers = Parallel::workers_for(node_count);
+        const auto initial = 1.0f / static_cast<float>(node_count);
+        auto ranks = std::vector(node_count, initial);
+        auto next = std::vector(node_count, 0.0f);
+        auto contributions = std::vector(node_count, 0.0f);
+        auto dangling = std::vector(workers, 0.0);
+        auto difference = std::vector(workers, 0.0);
+
+        while (result.iterations < max_iterations) {
+            ++result.iterations;
+
+            Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, const size_t worker) {
+                double dangling_rank = 0.0;
+                for (auto slot = begin; slot < end; ++slot) {
+                    const auto degree = outgoing.degree(slot);
+                    if (degree == 0) {
+                        dangling_rank += ranks[slot];
+                        contributions[slot] = 0.0f;
+                    } else {
+                        contributions[slot] = ranks[slot] / static_cast<float>(degree);
+                    }
+                }
+                dangling[worker] = dangling_rank;
+            });
+
+            const auto dangling_total = std::accumulate(dangling.begin(), dangling.end(), 0.0);
+            const auto base = static_cast<float>(
+                (1.0 - damping) / static_cast<double>(node_count) +
+                damping * dangling_total / static_cast<double>(node_count));
+
+            Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, const size_t worker) {
+                double local_difference = 0.0;
+                for (auto slot = begin; slot < end; ++slot) {
+                    float sum = 0.0f;
+                    for (const auto predecessor: incoming.neighbors(slot)) {
+                        sum += contributions[predecessor];
+                    }
+                    next[slot] = base + damping * sum;
+                    local_difference += std::abs(next[slot] - ranks[slot]);
+                }
+                difference[worker] = local_difference;
+            });
+
+            ranks.swap(next);
+            if (std::accumulate(difference.begin(), difference.end(), 0.0) < tolerance) {
+                break;
+            }
+        }
+
+        result.ranks = std::move(ranks);
+        return result;
+    }
+
+    static auto degree_distribution(const Adjacency &outgoing, const Adjacency &incoming) -> DegreeDistribution {
+        const auto node_count = outgoing.node_count();
+        const auto workers = Parallel::workers_for(node_count);
+        auto partial = std::vector<DegreeDistribution>(workers);
+
+        Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, const size_t worker) {
+            for (auto slot = begin; slot < end; ++slot) {
+                ++partial[worker].outgoing[outgoing.degree(slot)];
+                ++partial[worker].incoming[incoming.degree(slot)];
+            }
+        });
+
+        auto result = DegreeDistribution{};
+        for (const auto &[outgoing_part, incoming_part]: partial) {
+            for (const auto &[degree, count]: outgoing_part) result.outgoing[degree] += count;
+            for (const auto &[degree, count]: incoming_part) result.incoming[degree] += count;
+        }
+        return result;
+    }
+
+    // Counts triangles over undirected adjacency. Every edge is kept only at its endpoint of lower
+    // (degree, slot) rank, so each triangle is found once, from its lowest ranked node, and hub
+    // neighbourhoods stay short. Triangles are the common entries of two sorted forward lists.
+    static auto triangles(const Adjacency &both) -> TriangleCounts {
+        const auto node_count = both.node_count();
+        const auto workers = Parallel::workers_for(node_count);
+        auto result = TriangleCounts{};
+        result.degrees.resize(node_count);
+
+        // Neighbours sorted and deduplicated in a copy, parallel and reciprocal edges collapse. The copy is
+        // laid out by its own offsets, since patched adjacency has no single target array.
+        auto offsets = std::vector<size_t>(node_count + 1, 0);
+        for (size_t slot = 0; slot < node_count; ++slot) {
+            offsets[slot + 1] = offsets[slot] + both.degree(slot);
+        }
+        auto neighbors = std::vector<uint32_t>(offsets.back());
+        Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, size_t) {
+            for (auto slot = begin; slot < end; ++slot) {
+                const auto first = neighbors.begin() + static_cast<std::ptrdiff_t>(offsets[slot]);
+                const auto last = neighbors.begin() + static_cast<std::ptrdiff_t>(offsets[slot + 1]);
+                std::ranges::copy(both.neighbors(slot), first);
+                std::sort(first, last);
+                const auto unique_end = std::remove(first, std::unique(first, last), static_cast<uint32_t>(slot));
+                result.degrees[slot] = static_cast<uint32_t>(unique_end - first);
+            }
+        });
+
+        auto ranks_below = [&result](const uint32_t slot, const uint32_t other) {
+            return result.degrees[slot] < result.degrees[other] ||
+                   (result.degrees[slot] == result.degrees[other] && slot < other);
+        };
+        auto forward_offsets = std::vector<size_t>(node_count + 1, 0);
+        Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, size_t) {
+            for (auto slot = begin; slot < end; ++slot) {
+                const auto *first = neighbors.data() + offsets[slot];
+                forward_offsets[slot + 1] = static_cast<size_t>(std::count_if(
+                    first, first + result.degrees[slot], [&](const uint32_t neighbor) {
+                        return ranks_below(static_cast<uint32_t>(slot), neighbor);
+                    }));
+            }
+        });
+        for (size_t slot = 0; slot < node_count; ++slot) {
+            forward_offsets[slot + 1] += forward_offsets[slot];
+        }
+        auto forward_targets = std::vector<uint32_t>(forward_offsets.back());
+        Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, size_t) {
+            for (auto slot = begin; slot < end; ++slot) {
+                const auto *first = neighbors.data() + offsets[slot];
+                std::copy_if(first, first + result.degrees[slot],
+                             forward_targets.begin() + static_cast<std::ptrdiff_t>(forward_offsets[slot]),
+                             [&](const uint32_t neighbor) {
+                                 return ranks_below(static_cast<uint32_t>(slot), neighbor);
+                             });
+            }
+        });
+        neighbors = {};
+
+        auto forward = [&](const size_t slot) {
+            return std::span<const uint32_t>(forward_targets.data() + forward_offsets[slot],
+                                             forward_offsets[slot + 1] - forward_offsets[slot]);
+        };
+        // A triangle adds to all three corners and the other two may belong to other workers.
+        auto counts = std::vector<std::atomic<uint64_t> >(node_count);
+        auto totals = std::vector<uint64_t>(workers, 0);
+        Parallel::for_chunks(node_count, workers, [&](const size_t begin, const size_t end, const size_t worker) {
+            for (auto slot = begin; slot < end; ++slot) {
+                uint64_t found = 0;
+                for (const auto neighbor: forward(slot)) {
+                    SetKernels::intersect(forward(slot), forward(neighbor), [&](const uint32_t third) {
+                        ++found;
+                        counts[neighbor].fetch_add(1, std::memory_order_relaxed);
+                        counts[third].fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+                counts[slot].fetch_add(found, std::memory_order_relaxed);
+                totals[worker] += found;
+            }
+        });
+
+        result.triangles.resize(node_count);
+        for (size_t slot = 0; slot < node_count; ++slot) {
+            result.triangles[slot] = counts[slot].load(std::memory_order_relaxed);
+        }
+        result.total = std::accumulate(totals.begin(), totals.end(), uint64_t{0});
+        return result;
+    }
+
+    // Parallel coloring SCC. Each round trims nodes that can not be on a cycle, propagates the highest
+    // slot that reaches every node, and then every color root collects its component with a backward
+    // search limited to its own color. Colors are disjoint, so roots are processed in parallel.
+    // Returns for every slot the root slot of its component.
+    static auto strongly_connected_components(const Adjacency &outgoing,
+                                              const Adjacency &incoming) -> std::vector<uint32_t> {
+        const auto node_count = outgoing.node_count();
+        auto component = std::vector(node_count, unassigned);
+        auto colors = std::vector<std::atomic<uint32_t> >(node_count);
+
+        auto remaining = std::vector<uint32_t>(node_count);
+        std::iota(remaining.begin(), remaining.end(), 0);
+
+        auto has_remaining_neighbor = [&component](const Adjacency &adjacency, const uint32_t slot) {
+            return std::ranges::any_of(adjacency.neighbors(slot), [&](const uint32_t neighbor) {
+                return neighbor != slot && component[neighbor] == unassigned;
+            });
+        };
+
+        while (!remaining.empty()) {
+            for (const auto slot: remaining) {
+                if (!has_remaining_neighbor(outgoing, slot) || !has_remaining_neighbor(incoming, slot)) {
+                    component[slot] = slot;
+                }
+            }
+            std::erase_if(remaining, [&component](const uint32_t slot) { return component[slot] != unassigned; });
+            if (remaining.empty()) {
+                break;
+            }
+
+            const auto workers = Parallel::workers_for(remaining.size());
+            for (const auto slot: remaining) {
+                colors[slot].store(slot, std::memory_order_relaxed);
+            }
+
+            auto changed = std::atomic<bool>{true};
+            while (changed.exchange(false)) {
+                Parallel::for_chunks(remaining.size(), workers, [&](const size_t begin, const size_t end, size_t) {
+                    for (auto index = begin; index < end; ++index) {
+                        const auto slot = remaining[index];
+                        const auto color = colors[slot].load(std::memory_order_relaxed);
+                        for (const auto neighbor: outgoing.neighbors(slot)) {
+                            if (component[neighbor] != unassigned) {
+                                continue;
+                            }
+                            auto current = colors[neighbor].load(std::memory_order_relaxed);
+                            while (current < color &&
+                                   !colors[neighbor].compare_exchange_weak(current, color, std::memory_order_relaxed)) {
+                            }
+                            if (current < color) {
+                                changed.store(true, std::memory_order_relaxed);
+                            }
+                        }
+                    }
+                });
+            }
+
+            auto roots = std::vector<uint32_t>{};
+            for (const auto slot: remaining) {
+                if (colors[slot].load(std::memory_order_relaxed) == slot) {
+                    roots.push_back(slot);
+                }
+            }
+
+            Parallel::for_chunks(roots.size(), Parallel::workers_for(remaining.size()),
+                                 [&](const size_t begin, const size_t end, size_t) {
+                                     auto stack = std::vector<uint32_t>{};
+                                     for (auto index = begin; index < end; ++index) {
+                                         const auto root = roots[index];
+                                         component[root] = root;
+                                         stack.push_back(root);
+                                         while (!stack.empty()) {
+                                             const auto slot = stack.back();
+                                             stack.pop_back();
+                                             for (const auto predecessor: incoming.neighbors(slot)) {
+                                                 if (colors[predecessor].load(std::memory_order_relaxed) == root &&
+                                                     component[predecessor] == unassigned) {
+                                                     component[predecessor] = root;
+                                                     stack.push_back(predecessor);
+                                                 }
+                                             }
+                                         }
+                                     }
+                                 });
+
+            std::erase_if(remaining, [&component](const uint32_t slot) { return component[slot] != unassigned; });
+        }
+        return component;
+    }
+};
+
+#endif //ANALYTICS_HPP
@@ -0,0 +1,85 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef BASE64_HPP
+#define BASE64_HPP
+
+#include <array>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Standard alphabet with '=' padding, used to embed binary segments in the JSON snapshot.
+struct Base64 {
+    static constexpr std::string_view alphabet =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    static auto encode(const std::string_view bytes) -> std::string {
+        auto result = std::string{};
+        result.reserve((bytes.size() + 2) / 3 * 4);
+
+        size_t i = 0;
+        for (; i + 3 <= bytes.size(); i += 3) {
+            const auto triple = static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << 16 |
+                                static_cast<uint32_t>(static_cast<uint8_t>(bytes[i + 1])) << 8 |
+                                static_cast<uint32_t>(static_cast<uint8_t>(bytes[i + 2]));
+            result += alphabet[triple >> 18 & 0x3f];
+            result += alphabet[triple >> 12 & 0x3f];
+            result += alphabet[triple >> 6 & 0x3f];
+            result += alphabet[triple & 0x3f];
+        }
+
+        if (const auto rest = bytes.size() - i; rest > 0) {
+            auto triple = static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << 16;
+            if (rest == 2) {
+                triple |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i + 1])) << 8;
+            }
+            result += alphabet[triple >> 18 & 0x3f];
+            result += alphabet[triple >> 12 & 0x3f];
+            result += rest == 2 ? alphabet[triple >> 6 & 0x3f] : '=';
+            result += '=';
+        }
+        return result;
+    }
+
+    static auto decode(const std::string_view text) -> std::string {
+        if (text.size() % 4 != 0) {
+            throw std::runtime_error("Invalid base64 length");
+        }
+
+        auto result = std::string{};
+        result.reserve(text.size() / 4 * 3);
+        for (size_t i = 0; i < text.size(); i += 4) {
+            const auto padding = i + 4 == text.size() ? (text[i + 3] == '=') + (text[i + 2] == '=') : 0;
+            uint32_t quad = 0;
+            for (size_t j = 0; j < 4; ++j) {
+                const auto digit = j < 4 - static_cast<size_t>(padding) ? lookup[static_cast<uint8_t>(text[i + j])] : 0;
+                if (digit == invalid) {
+                    throw std::runtime_error(std::format("Invalid base64 character at {}", i + j));
+                }
+                quad = quad << 6 | digit;
+            }
+            result += static_cast<char>(quad >> 16 & 0xff);
+            if (padding < 2) result += static_cast<char>(quad >> 8 & 0xff);
+            if (padding < 1) result += static_cast<char>(quad & 0xff);
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint8_t invalid = 0xff;
+
+    static constexpr auto lookup = [] {
+        auto table = std::array<uint8_t, 256>{};
+        table.fill(invalid);
+        for (size_t i = 0; i < alphabet.size(); ++i) {
+            table[static_cast<uint8_t>(alphabet[i])] = static_cast<uint8_t>(i);
+        }
+        return table;
+    }();
+};
+
+#endif //BASE64_HPP
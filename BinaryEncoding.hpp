@@ -0,0 +1,97 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef BINARY_ENCODING_HPP
+#define BINARY_ENCODING_HPP
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "Database.hpp"
+
+// Compact tagged encoding of values: one tag byte followed by a little-endian payload.
+// Strings and objects are length-prefixed with a 32-bit count.
+struct BinaryEncoding {
+    enum Tag : uint8_t {
+        Int = 0,
+        Double = 1,
+        Bool = 2,
+        String = 3,
+        Object = 4,
+    };
+
+    template<typename T>
+    static auto append_fixed(std::string &out, T value) -> void {
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    static auto append_string(std::string &out, const std::string_view value) -> void {
+        append_fixed(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    static auto append_value(std::string &out, const BasicValue &value) -> void {
+        std::visit([&out]<typename T0>(const T0 &arg) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::same_as<T, int>) {
+                out += static_cast<char>(Int);
+                append_fixed(out, static_cast<int32_t>(arg));
+            } else if constexpr (std::same_as<T, double>) {
+                out += static_cast<char>(Double);
+                append_fixed(out, std::bit_cast<uint64_t>(arg));
+            } else if constexpr (std::same_as<T, bool>) {
+                out += static_cast<char>(Bool);
+                out += static_cast<char>(arg ? 1 : 0);
+            } else {
+                out += static_cast<char>(String);
+                append_string(out, arg);
+            }
+        }, value.data);
+    }
+
+    static auto append_user_defined_value(std::string &out, const UserDefinedValue &value) -> void {
+        const auto &data = value.get_data();
+        out += static_cast<char>(Object);
+        append_fixed(out, static_cast<uint32_t>(data.size()));
+        for (const auto &[key, field]: data) {
+            append_string(out, key);
+            std::visit([&out]<typename U>(const U &v) {
+                if constexpr (std::same_as<std::remove_cvref_t<U>, BasicValue>) {
+                    append_value(out, v);
+                } else {
+                    append_user_defined_value(out, v);
+                }
+            }, field);
+        }
+    }
+
+    // Record layout: u32 length of the rest, i32 node id, encoded data.
+    static auto append_node(std::string &out, const Node &node) -> void {
+        const auto length_at = out.size();
+        append_fixed(out, uint32_t{0});
+        append_fixed(out, static_cast<int32_t>(node.id));
+        std::visit([&out]<typename U>(const U &v) {
+            if constexpr (std::same_as<std::remove_cvref_t<U>, BasicValue>) {
+                append_value(out, v);
+            } else {
+                append_user_defined_value(out, v);
+            }
+        }, node.data);
+
+        auto length = static_cast<uint32_t>(out.size() - length_at - sizeof(uint32_t));
+        if constexpr (std::endian::native == std::endian::big) {
+            length = std::byteswap(length);
+        }
+        std::memcpy(out.data() + length_at, &length, sizeof(length));
+    }
+};
+
+#endif //BINARY_ENCODING_HPP
@@ -0,0 +1,292 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef BITMAP_HPP
+#define BITMAP_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "SetKernels.hpp"
+
+// Compressed set of node slots in the style of roaring bitmaps. Slots are split by their high 16 bits
+// into containers; a container holds its low halves as a sorted array while it has at most
+// array_limit of them and as a 65536-bit set once it gets denser, so neither sparse nor dense sets
+// waste space. Intersections and unions work container by container, bitsets word by word.
+class Bitmap {
+public:
+    static constexpr size_t array_limit = 4096;
+    static constexpr size_t words = 65536 / 64;
+
+private:
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        // Set instead of array once the container holds more than array_limit values.
+        std::unique_ptr<std::array<uint64_t, words> > bits;
+
+        Container() = default;
+
+        explicit Container(const uint16_t key) : key(key) {
+        }
+
+        Container(Container &&) noexcept = default;
+
+        auto operator=(Container &&) noexcept -> Container & = default;
+
+        Container(const Container &other)
+            : key(other.key), cardinality(other.cardinality), array(other.array),
+              bits(other.bits ? std::make_unique<std::array<uint64_t, words> >(*other.bits) : nullptr) {
+        }
+
+        auto operator=(const Container &other) -> Container & {
+            if (this != &other) {
+                *this = Container(other);
+            }
+            return *this;
+        }
+
+        [[nodiscard]]
+        auto contains(const uint16_t low) const -> bool {
+            if (bits) {
+                return ((*bits)[low >> 6] >> (low & 63) & 1) != 0;
+            }
+            return std::ranges::binary_search(array, low);
+        }
+
+        auto to_bits() -> void {
+            bits = std::make_unique<std::array<uint64_t, words> >();
+            bits->fill(0);
+            for (const auto low: array) {
+                (*bits)[low >> 6] |= uint64_t{1} << (low & 63);
+            }
+            array = {};
+        }
+
+        auto to_array() -> void {
+            array.clear();
+            array.reserve(cardinality);
+            for_each_low([this](const uint16_t low) {
+                array.push_back(low);
+                return true;
+            });
+            bits.reset();
+        }
+
+        // Switches representation to the smaller one for the current cardinality.
+        auto normalize() -> void {
+            if (bits && cardinality <= array_limit) {
+                to_array();
+            } else if (!bits && cardinality > array_limit) {
+                to_bits();
+            }
+        }
+
+        template<typename Visitor>
+        auto for_each_low(Visitor visit) const -> bool {
+            if (!bits) {
+                for (const auto low: array) {
+                    if (!visit(low)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            for (size_t word = 0; word < words; ++word) {
+                for (auto set = (*bits)[word]; set != 0; set &= set - 1) {
+                    if (!visit(static_cast<uint16_t>(word * 64 + std::countr_zero(set)))) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        [[nodiscard]]
+        auto memory_usage() const -> size_t {
+            return sizeof(Container) + array.capacity() * sizeof(uint16_t) + (bits ? sizeof(*bits) : 0);
+        }
+    };
+
+    // Sorted by key.
+    std::vector<Container> containers;
+
+    static auto high(const uint32_t slot) -> uint16_t { return static_cast<uint16_t>(slot >> 16); }
+
+    static auto low(const uint32_t slot) -> uint16_t { return static_cast<uint16_t>(slot & 0xffff); }
+
+    auto find(const uint16_t key) -> std::vector<Container>::iterator {
+        return std::ranges::lower_bound(containers, key, {}, &Container::key);
+    }
+
+    template<typename Op>
+    static auto combine_bits(const Container &left, const Container &right, Container &out) -> void {
+        out.bits = std::make_unique<std::array<uint64_t, words> >();
+        out.cardinality = static_cast<uint32_t>(SetKernels::combine<Op>(*left.bits, *right.bits, *out.bits));
+    }
+
+    static auto intersect(const Container &left, const Container &right) -> Container {
+        auto out = Container(left.key);
+        if (left.bits && right.bits) {
+            combine_bits<SetKernels::Intersection>(left, right, out);
+            out.normalize();
+            return out;
+        }
+        if (left.bits || right.bits) {
+            const auto &sparse = left.bits ? right : left;
+            const auto &dense = left.bits ? left : right;
+            std::ranges::copy_if(sparse.array, std::back_inserter(out.array), [&dense](const uint16_t value) {
+                return dense.contains(value);
+            });
+        } else {
+            std::ranges::set_intersection(left.array, right.array, std::back_inserter(out.array));
+        }
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+
+    static auto unite(const Container &left, const Container &right) -> Container {
+        auto out = Container(left.key);
+        if (left.bits && right.bits) {
+            combine_bits<SetKernels::Union>(left, right, out);
+            return out;
+        }
+        if (left.bits || right.bits) {
+            out = left.bits ? left : right;
+            for (const auto value: (left.bits ? right : left).array) {
+                auto &word = (*out.bits)[value >> 6];
+                const auto bit = uint64_t{1} << (value & 63);
+                out.cardinality += (word & bit) == 0 ? 1 : 0;
+                word |= bit;
+            }
+            return out;
+        }
+        out.array.reserve(left.array.size() + right.array.size());
+        std::ranges::set_union(left.array, right.array, std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        out.normalize();
+        return out;
+    }
+
+public:
+    auto add(const uint32_t slot) -> void {
+        auto it = find(high(slot));
+        if (it == containers.end() || it->key != high(slot)) {
+            it = containers.emplace(it, high(slot));
+        }
+        const auto value = low(slot);
+        if (it->bits) {
+            auto &word = (*it->bits)[value >> 6];
+            const auto bit = uint64_t{1} << (value & 63);
+            it->cardinality += (word & bit) == 0 ? 1 : 0;
+            word |= bit;
+            return;
+        }
+        // Slots are mostly added in increasing order, so this is usually an append.
+        const auto position = std::ranges::lower_bound(it->array, value);
+        if (position != it->array.end() && *position == value) {
+            return;
+        }
+        it->array.insert(position, value);
+        ++it->cardinality;
+        it->normalize();
+    }
+
+    auto remove(const uint32_t slot) -> void {
+        const auto it = find(high(slot));
+        if (it == containers.end() || it->key != high(slot) || !it->contains(low(slot))) {
+            return;
+        }
+        const auto value = low(slot);
+        if (it->bits) {
+            (*it->bits)[value >> 6] &= ~(uint64_t{1} << (value & 63));
+        } else {
+            it->array.erase(std::ranges::lower_bound(it->array, value));
+        }
+        if (--it->cardinality == 0) {
+            containers.erase(it);
+            return;
+        }
+        it->normalize();
+    }
+
+    [[nodiscard]]
+    auto cardinality() const -> size_t {
+        size_t total = 0;
+        for (const auto &container: containers) {
+            total += container.cardinality;
+        }
+        return total;
+    }
+
+    [[nodiscard]]
+    auto empty() const -> bool {
+        return containers.empty();
+    }
+
+    // Calls visit(slot) in increasing order until it returns false.
+    template<typename Visitor>
+    auto for_each(Visitor visit) const -> void {
+        for (const auto &container: containers) {
+            const auto base = static_cast<uint32_t>(container.key) << 16;
+            if (!container.for_each_low([&](const uint16_t value) { return visit(base | value); })) {
+                return;
+            }
+        }
+    }
+
+    static auto intersect(const Bitmap &left, const Bitmap &right) -> Bitmap {
+        auto result = Bitmap{};
+        auto l = left.containers.begin();
+        auto r = right.containers.begin();
+        while (l != left.containers.end() && r != right.containers.end()) {
+            if (l->key < r->key) {
+                ++l;
+            } else if (r->key < l->key) {
+                ++r;
+            } else {
+                if (auto container = intersect(*l, *r); container.cardinality > 0) {
+                    result.containers.push_back(std::move(container));
+                }
+                ++l;
+                ++r;
+            }
+        }
+        return result;
+    }
+
+    static auto unite(const Bitmap &left, const Bitmap &right) -> Bitmap {
+        auto result = Bitmap{};
+        result.containers.reserve(left.containers.size() + right.containers.size());
+        auto l = left.containers.begin();
+        auto r = right.containers.begin();
+        while (l != left.containers.end() || r != right.containers.end()) {
+            if (r == right.containers.end() || (l != left.containers.end() && l->key < r->key)) {
+                result.containers.push_back(*l++);
+            } else if (l == left.containers.end() || r->key < l->key) {
+                result.containers.push_back(*r++);
+            } else {
+                result.containers.push_back(unite(*l++, *r++));
+            }
+        }
+        return result;
+    }
+
+    [[nodiscard]]
+    auto memory_usage() const -> size_t {
+        size_t bytes = containers.capacity() * sizeof(Container);
+        for (const auto &container: containers) {
+            bytes += container.memory_usage() - sizeof(Container);
+        }
+        return bytes;
+    }
+};
+
+#endif //BITMAP_HPP
@@ -0,0 +1,112 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CHECKSUM_SSE42 1
+#endif
+
+// CRC32C (Castagnoli) of snapshot segments and mutation log records. On x86-64 CPUs with SSE4.2 the
+// crc32 instruction handles 8 bytes at a time, elsewhere slicing-by-8 tables do; both give the same
+// values. Unlike the text and set kernels the instruction is picked at runtime, since every graph
+// load is checked and builds without EDGYDB_NATIVE_ARCH would otherwise pay for the tables.
+struct Crc32c {
+    static auto of(const std::string_view data) -> uint32_t {
+        return extend(0, data);
+    }
+
+    // Checksum of the bytes covered by crc followed by data.
+    static auto extend(const uint32_t crc, const std::string_view data) -> uint32_t {
+#ifdef CHECKSUM_SSE42
+        if (hardware) {
+            return ~extend_sse42(~crc, data.data(), data.data() + data.size());
+        }
+#endif
+        return ~extend_table(~crc, data.data(), data.data() + data.size());
+    }
+
+    static auto implementation() -> std::string_view {
+#ifdef CHECKSUM_SSE42
+        if (hardware) {
+            return "SSE4.2";
+        }
+#endif
+        return "table";
+    }
+
+private:
+#ifdef CHECKSUM_SSE42
+    // Initialized before main, when the CPU features may not have been read yet.
+    inline static const bool hardware = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+
+    __attribute__((target("sse4.2")))
+    static auto extend_sse42(uint32_t state, const char *pos, const char *const end) -> uint32_t {
+        auto wide = uint64_t{state};
+        for (; end - pos >= 8; pos += 8) {
+            wide = _mm_crc32_u64(wide, load(pos));
+        }
+        state = static_cast<uint32_t>(wide);
+        for (; pos < end; ++pos) {
+            state = _mm_crc32_u8(state, static_cast<uint8_t>(*pos));
+        }
+        return state;
+    }
+#endif
+
+    static auto extend_table(uint32_t state, const char *pos, const char *const end) -> uint32_t {
+        for (; end - pos >= 8; pos += 8) {
+            const auto word = load(pos) ^ state;
+            state = tables[7][word & 0xff] ^ tables[6][word >> 8 & 0xff] ^ tables[5][word >> 16 & 0xff] ^
+                    tables[4][word >> 24 & 0xff] ^ tables[3][word >> 32 & 0xff] ^ tables[2][word >> 40 & 0xff] ^
+                    tables[1][word >> 48 & 0xff] ^ tables[0][word >> 56];
+        }
+        for (; pos < end; ++pos) {
+            state = tables[0][(state ^ static_cast<uint8_t>(*pos)) & 0xff] ^ state >> 8;
+        }
+        return state;
+    }
+
+    // Little-endian, the byte order both paths consume.
+    static auto load(const char *pos) -> uint64_t {
+        uint64_t word;
+        std::memcpy(&word, pos, sizeof(word));
+        if constexpr (std::endian::native == std::endian::big) {
+            word = std::byteswap(word);
+        }
+        return word;
+    }
+
+    // tables[k][b] is the state after byte b followed by k zero bytes.
+    static constexpr auto tables = [] {
+        constexpr auto polynomial = uint32_t{0x82f63b78};
+        auto result = std::array<std::array<uint32_t, 256>, 8>{};
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            auto state = byte;
+            for (int bit = 0; bit < 8; ++bit) {
+                state = state & 1 ? state >> 1 ^ polynomial : state >> 1;
+            }
+            result[0][byte] = state;
+        }
+        for (size_t k = 1; k < result.size(); ++k) {
+            for (size_t byte = 0; byte < 256; ++byte) {
+                result[k][byte] = result[0][result[k - 1][byte] & 0xff] ^ result[k - 1][byte] >> 8;
+            }
+        }
+        return result;
+    }();
+};
+
+#endif //CHECKSUM_HPP
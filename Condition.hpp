@@ -6,21 +6,30 @@
 #define CONDITION_HPP
 
 #include <iomanip>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <stdexcept>
 
+#include "Database.hpp"
+
 struct Comparator {
-    static const inline std::vector<std::string> valid_values{"EQ", "NEQ"};
+    enum class Kind { EQ, NEQ, LT, LTE, GT, GTE, BETWEEN, STARTS_WITH, CONTAINS };
+
+    static const inline std::vector<std::string> valid_values{
+        "EQ", "NEQ", "LT", "LTE", "GT", "GTE", "BETWEEN", "STARTS WITH", "CONTAINS"
+    };
 
     std::string value;
+    Kind kind{};
 
     explicit Comparator(const std::string_view value) {
         if (!is_valid(value)) {
             throw std::invalid_argument(std::format("Invalid comparator:{}", value));
         }
         this->value = value;
+        this->kind = static_cast<Kind>(std::ranges::find(valid_values, value) - valid_values.begin());
     }
 
     [[nodiscard]]
@@ -29,15 +38,68 @@ struct Comparator {
     }
 
     [[nodiscard]]
-    auto compare(const std::string_view left, const std::string_view right) const -> bool {
-        if (value == "EQ") {
-            return left == right;
-        }
-        if (value == "NEQ") {
-            return left != right;
+    auto is_range() const -> bool {
+        return kind != Kind::EQ && kind != Kind::NEQ && !is_text();
+    }
+
+    // STARTS WITH and CONTAINS only hold for string values and take the literal as text.
+    [[nodiscard]]
+    auto is_text() const -> bool {
+        return kind == Kind::STARTS_WITH || kind == Kind::CONTAINS;
+    }
+
+    // Comparators only hold between values of the same kind: numbers numerically, strings lexicographically.
+    // Condition::accepts also lets a quoted EQ or NEQ literal stand for the typed value it spells.
+    // left is a BasicValue or a BasicValueView read in place from a node.
+    template<typename Value>
+    [[nodiscard]]
+    auto compare(const Value &left, const BasicValue &right, const BasicValue *upper = nullptr) const -> bool {
+        switch (kind) {
+            case Kind::EQ:
+                return equals(left, right);
+            case Kind::NEQ:
+                return !equals(left, right);
+            case Kind::LT:
+                return left.is_comparable_with(right) && left < right;
+            case Kind::LTE:
+                return left.is_comparable_with(right) && left <= right;
+            case Kind::GT:
+                return left.is_comparable_with(right) && left > right;
+            case Kind::GTE:
+                return left.is_comparable_with(right) && left >= right;
+            case Kind::BETWEEN:
+                if (upper == nullptr) {
+                    throw std::logic_error("BETWEEN comparator requires an upper bound");
+                }
+                return left.is_comparable_with(right) && left.is_comparable_with(*upper) &&
+                       left >= right && left <= *upper;
+            case Kind::STARTS_WITH:
+                return text_of(left, right, [](const std::string_view text, const std::string_view pattern) {
+                    return text.starts_with(pattern);
+                });
+            case Kind::CONTAINS:
+                return text_of(left, right, [](const std::string_view text, const std::string_view pattern) {
+                    return text.find(pattern) != std::string_view::npos;
+                });
         }
         throw std::logic_error(std::format("Unsupported comparator:{}", value));
     }
+
+    template<typename Value>
+    [[nodiscard]]
+    static auto equals(const Value &left, const BasicValue &right) -> bool {
+        return left.is_comparable_with(right) && left == right;
+    }
+
+private:
+    template<typename Value, typename Test>
+    [[nodiscard]]
+    static auto text_of(const Value &left, const BasicValue &right, Test test) -> bool {
+        using Text = std::conditional_t<std::same_as<Value, BasicValue>, std::string, std::string_view>;
+        const auto *text = std::get_if<Text>(&left.data);
+        const auto *pattern = std::get_if<std::string>(&right.data);
+        return text != nullptr && pattern != nullptr && test(*text, *pattern);
+    }
 };
 
 struct LogicalOperator {
@@ -58,57 +120,197 @@ struct LogicalOperator {
     }
 
     [[nodiscard]]
-    auto apply(const bool left, const bool right) const -> bool {
-        if (value == "AND") {
-            return left && right;
-        }
-        if (value == "OR") {
-            return left || right;
-        }
-        throw std::logic_error(std::format("Unsupported logical operator: {}", value));
+    auto is_or() const -> bool {
+        return value == "OR";
     }
 };
 
 struct Condition {
     std::string field;
-    std::string value;
+    BasicValue value;
+    // Only set for BETWEEN, which is inclusive on both ends.
+    std::optional<BasicValue> upper;
+    // Typed value spelled by a quoted EQ or NEQ literal, e.g. 40 for "40". The literal equals both it and
+    // the string, so "age" EQ "40" finds 40 and "40", while "age" EQ 40 only finds numbers. Ordered indexes
+    // look up both keys, so they answer equality exactly as a scan does.
+    std::optional<BasicValue> spelled;
     Comparator comparator;
 
     Condition() : comparator("EQ") {
     }
 
-    Condition(std::string field, std::string value, Comparator comparator)
+    Condition(std::string field, BasicValue value, Comparator comparator)
         : field(std::move(field)), value(std::move(value)), comparator(std::move(comparator)) {
     }
+
+    [[nodiscard]]
+    auto matches(const Node &node) const -> bool {
+        const auto field_value = node.field_view(field);
+        if (!field_value) {
+            return false;
+        }
+        return accepts(*field_value);
+    }
+
+    template<typename Value>
+    [[nodiscard]]
+    auto accepts(const Value &field_value) const -> bool {
+        if (spelled) {
+            const auto equal = Comparator::equals(field_value, value) || Comparator::equals(field_value, *spelled);
+            return comparator.kind == Comparator::Kind::EQ ? equal : !equal;
+        }
+        return comparator.compare(field_value, value, upper ? &*upper : nullptr);
+    }
 };
 
+// AND binds tighter than OR, so the group is a disjunction of terms, each a run of conditions joined by AND.
+// Evaluation stops at the first failing condition of a term and at the first term that holds.
 struct ConditionGroup {
     std::vector<Condition> conditions;
     std::vector<LogicalOperator> operators;
+
+    [[nodiscard]]
+    auto matches(const Node &node) const -> bool {
+        size_t evaluated = 0;
+        return matches(node, evaluated);
+    }
+
+    // Adds the number of conditions actually evaluated to evaluated.
+    [[nodiscard]]
+    auto matches(const Node &node, size_t &evaluated) const -> bool {
+        bool term = true;
+        for (size_t i = 0; i < conditions.size(); ++i) {
+            if (i > 0 && operators[i - 1].is_or()) {
+                if (term) {
+                    return true;
+                }
+                term = true;
+            }
+            if (term) {
+                ++evaluated;
+                term = conditions[i].matches(node);
+            }
+        }
+        return term;
+    }
+
+    // Conditions of every term, in order.
+    [[nodiscard]]
+    auto terms() const -> std::vector<std::vector<Condition> > {
+        auto result = std::vector<std::vector<Condition> >(1);
+        for (size_t i = 0; i < conditions.size(); ++i) {
+            if (i > 0 && operators[i - 1].is_or()) {
+                result.emplace_back();
+            }
+            result.back().push_back(conditions[i]);
+        }
+        return result;
+    }
+
+    [[nodiscard]]
+    static auto from_terms(const std::vector<std::vector<Condition> > &terms) -> ConditionGroup {
+        auto group = ConditionGroup{};
+        for (const auto &term: terms) {
+            for (const auto &condition: term) {
+                if (!group.conditions.empty()) {
+                    group.operators.emplace_back(&condition == &term.front() ? "OR" : "AND");
+                }
+                group.conditions.push_back(condition);
+            }
+        }
+        return group;
+    }
+
+    [[nodiscard]]
+    auto is_conjunction() const -> bool {
+        return std::ranges::all_of(operators, [](const LogicalOperator &op) { return op.value == "AND"; });
+    }
 };
 
+// Unquoted literals are typed: true/false, integers and decimals. Anything quoted stays a string.
+inline auto parse_literal(const std::string &literal) -> BasicValue {
+    if (literal == "true" || literal == "false") {
+        return BasicValue(literal == "true");
+    }
+    try {
+        size_t end = 0;
+        if (const auto number = std::stoi(literal, &end); end == literal.size()) {
+            return BasicValue(number);
+        }
+        if (const auto number = std::stod(literal, &end); end == literal.size()) {
+            return BasicValue(number);
+        }
+    } catch (const std::logic_error &) {
+    }
+    return BasicValue(literal);
+}
+
+inline auto read_literal(std::istream &stream) -> BasicValue {
+    auto token = std::string{};
+    stream >> std::ws;
+    if (stream.peek() == '"') {
+        stream >> std::quoted(token);
+        return BasicValue(token);
+    }
+    stream >> token;
+    return parse_literal(token);
+}
+
+// Reads the comparator and literal(s) following a field name.
+inline auto read_condition(std::istream &stream, std::string field) -> Condition {
+    auto condition = Condition{};
+    condition.field = std::move(field);
+
+    auto token = std::string{};
+    stream >> token;
+    if (token == "STARTS") {
+        auto with = std::string{};
+        stream >> with;
+        token += " " + with;
+    }
+    condition.comparator = Comparator(token);
+
+    if (condition.comparator.is_text()) {
+        // Text patterns are never typed, CONTAINS 12 looks for the characters 12.
+        auto pattern = std::string{};
+        stream >> std::ws >> std::quoted(pattern);
+        condition.value = BasicValue(pattern);
+        return condition;
+    }
+    condition.value = read_literal(stream);
+    if (const auto *text = std::get_if<std::string>(&condition.value.data);
+        text != nullptr && (condition.comparator.kind == Comparator::Kind::EQ ||
+                            condition.comparator.kind == Comparator::Kind::NEQ)) {
+        if (auto typed = parse_literal(*text); !std::holds_alternative<std::string>(typed.data)) {
+            condition.spelled = std::move(typed);
+        }
+    }
+    if (condition.comparator.kind == Comparator::Kind::BETWEEN) {
+        if (!(stream >> token) || token != "AND") {
+            throw std::invalid_argument("BETWEEN expects bounds in form: BETWEEN [low] AND [high]");
+        }
+        condition.upper = read_literal(stream);
+    }
+    return condition;
+}
+
 inline auto parse_conditions(const std::string &condition_str) -> ConditionGroup {
     auto group = ConditionGroup{};
     auto stream = std::istringstream(condition_str);
     auto token = std::string{};
 
     while (stream >> std::quoted(token)) {
-        auto condition = Condition{};
-        condition.field = token;
-
-        stream >> token;
-        condition.comparator = Comparator(token);
-
-        stream >> std::quoted(token);
-        condition.value = token;
-
-        group.conditions.push_back(condition);
+        group.conditions.push_back(read_condition(stream, token));
 
         if (stream >> token) {
             group.operators.emplace_back(token);
         }
     }
 
+    if (group.conditions.empty()) {
+        throw std::invalid_argument("WHERE clause requires at least one condition");
+    }
+
     return group;
 }
 
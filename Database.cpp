@@ -4,15 +4,29 @@
 
 #include "Database.hpp"
 
+#include <cmath>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <ranges>
 #include <algorithm>
 #include <unordered_set>
+#include <fmt/ranges.h>
+#include <sys/stat.h>
 
+#include "Aggregation.hpp"
+#include "Analytics.hpp"
+#include "Checksum.hpp"
 #include "Condition.hpp"
 #include "Deserialization.hpp"
+#include "EdgeStore.hpp"
+#include "FileSync.hpp"
+#include "Pattern.hpp"
+#include "Profile.hpp"
+#include "Reordering.hpp"
+#include "ResultSink.hpp"
 #include "Serialization.hpp"
+#include "Traversal.hpp"
 #include "Utils.hpp"
 
 namespace rg = std::ranges;
@@ -21,137 +35,1676 @@ template<std::predicate<const Node &> Predicate>
 auto Graph::find_nodes_where(Predicate predicate) -> std::vector<std::reference_wrapper<Node> > {
     std::vector<std::reference_wrapper<Node> > result;
 
-    for (auto &node: nodes) {
-        if (predicate(node)) {
-            result.emplace_back(node);
+    for (size_t slot = 0; slot < nodes.size(); ++slot) {
+        if (!is_node_removed(slot) && predicate(nodes[slot])) {
+            result.emplace_back(nodes[slot]);
         }
     }
 
     return result;
 }
 
+template<std::predicate<const Node &> Predicate, std::predicate<const Node &> Consumer>
+auto Graph::for_each_node_where(Predicate predicate, Consumer consumer) const -> void {
+    for (size_t slot = 0; slot < nodes.size(); ++slot) {
+        if (!is_node_removed(slot) && predicate(nodes[slot]) && !consumer(nodes[slot])) {
+            return;
+        }
+    }
+}
+
+auto Graph::find_node(const int id) -> Node * {
+    const auto it = node_slots.find(id);
+    if (it == node_slots.end() || is_node_removed(it->second)) {
+        return nullptr;
+    }
+    return &nodes[it->second];
+}
+
+auto Graph::is_node_removed(const size_t slot) const -> bool {
+    return slot < removed_nodes.size() && removed_nodes[slot];
+}
+
+auto Graph::is_edge_removed(const size_t slot) const -> bool {
+    return slot < removed_edges.size() && removed_edges[slot];
+}
+
+auto Graph::is_edge_dangling(const size_t slot) const -> bool {
+    if (removed_nodes_count == 0) {
+        return false;
+    }
+    // Ids are handed out in increasing order and never reused, so a known id without a slot was removed.
+    // Edges may also name ids not inserted yet, those stay until the node arrives.
+    auto removed = [this](const int id) {
+        return id <= last_node_id && !node_slots.contains(id);
+    };
+    return removed(edges[slot].from) || removed(edges[slot].to);
+}
+
+auto Graph::add_node(const Node &node) -> void {
+    if (changes) {
+        changes->emplace_back(AddedNode{last_node_id});
+    }
+    node_slots[node.id] = nodes.size();
+    last_node_id = std::max(last_node_id, node.id);
+    nodes.push_back(node);
+    index_node(nodes.size() - 1);
+    if (adjacency_waiting_edges > 0) {
+        invalidate_adjacency();
+    } else if (auto overlay = adjacency_overlay()) {
+        overlay->add_slot();
+    }
+    dirty = true;
+}
+
+auto Graph::update_node(Node &node, Node::Data data) -> void {
+    const auto slot = static_cast<size_t>(&node - nodes.data());
+    unindex_node(slot);
+    if (changes) {
+        changes->emplace_back(UpdatedNode{slot, std::move(node.data)});
+    }
+    node.data = std::move(data);
+    index_node(slot);
+    dirty = true;
+}
+
+auto Graph::add_edge(const Edge &edge, const std::optional<float> weight) -> void {
+    // Weights are only materialized once an edge deviates from the default.
+    const auto materialize = weight && *weight != 1.0f && edge_weights.empty();
+    if (materialize) {
+        edge_weights.assign(edges.size(), 1.0f);
+    }
+    if (changes) {
+        changes->emplace_back(AddedEdge{materialize});
+    }
+    if (!edge_weights.empty()) {
+        edge_weights.push_back(weight.value_or(1.0f));
+    }
+    edges.push_back(edge);
+    if (edge_lookup) {
+        edge_lookup_pending.emplace(edge.from, edges.size() - 1);
+    }
+    if (auto overlay = adjacency_overlay()) {
+        const auto from = node_slots.find(edge.from);
+        const auto to = node_slots.find(edge.to);
+        if (from != node_slots.end() && to != node_slots.end()) {
+            overlay->add_edge(static_cast<uint32_t>(from->second), static_cast<uint32_t>(to->second),
+                              edge_weight(edges.size() - 1));
+        } else if (!is_edge_dangling(edges.size() - 1)) {
+            ++adjacency_waiting_edges;
+        }
+    }
+    dirty = true;
+}
+
+auto Graph::edge_weight(const size_t slot) const -> float {
+    return edge_weights.empty() ? 1.0f : edge_weights[slot];
+}
+
+auto Graph::set_node_field(const size_t slot, const std::string &field, const BasicValue &value) -> bool {
+    auto &node = nodes[slot];
+    if (!std::holds_alternative<UserDefinedValue>(node.data)) {
+        return false;
+    }
+    auto data = std::get<UserDefinedValue>(node.data);
+    data.set_field(field, value);
+    update_node(node, std::move(data));
+    return true;
+}
+
+auto Graph::remove_node(const int id) -> bool {
+    const auto it = node_slots.find(id);
+    if (it == node_slots.end() || is_node_removed(it->second)) {
+        return false;
+    }
+
+    if (removed_nodes.size() < nodes.size()) {
+        removed_nodes.resize(nodes.size());
+    }
+    removed_nodes[it->second] = true;
+    ++removed_nodes_count;
+    if (changes) {
+        changes->emplace_back(RemovedNode{it->second});
+    }
+    unindex_node(it->second);
+    if (auto overlay = adjacency_overlay()) {
+        overlay->remove_slot(static_cast<uint32_t>(it->second));
+    }
+    node_slots.erase(it);
+    // Its edges are left in place: without a slot they are out of the adjacency, and live_edges() and
+    // compaction skip them as dangling.
+    dirty = true;
+    return true;
+}
+
+auto Graph::remove_edges(const int from, const int to) -> size_t {
+    if (removed_edges.size() < edges.size()) {
+        removed_edges.resize(edges.size());
+    }
+
+    size_t removed = 0;
+    auto remove = [&](const size_t slot) {
+        if (!removed_edges[slot] && edges[slot].from == from && edges[slot].to == to && !is_edge_dangling(slot)) {
+            removed_edges[slot] = true;
+            ++removed;
+            if (changes) {
+                changes->emplace_back(RemovedEdge{slot});
+            }
+        }
+    };
+    // The mapped base is sorted by (from, to), edges in memory are found through edge_lookup.
+    const auto base = edges.base_segment();
+    const auto matches = rg::equal_range(base, std::pair(from, to), {}, [](const Edge &edge) {
+        return std::pair(edge.from, edge.to);
+    });
+    for (auto it = matches.begin(); it != matches.end(); ++it) {
+        remove(static_cast<size_t>(it - base.begin()));
+    }
+    for (const auto slot: edge_slots_from(from)) {
+        remove(slot);
+    }
+    removed_edges_count += removed;
+    if (removed > 0) {
+        const auto from_slot = node_slots.find(from);
+        const auto to_slot = node_slots.find(to);
+        auto overlay = adjacency_overlay();
+        if (overlay && from_slot != node_slots.end() && to_slot != node_slots.end()) {
+            overlay->remove_edges(static_cast<uint32_t>(from_slot->second),
+                                  static_cast<uint32_t>(to_slot->second));
+        }
+        dirty = true;
+    }
+    return removed;
+}
+
+auto Graph::live_node_count() const -> size_t {
+    return nodes.size() - removed_nodes_count;
+}
+
+auto Graph::live_edge_count() const -> size_t {
+    return edges.size() - removed_edges_count;
+}
+
+auto Graph::memory_usage() const -> size_t {
+    size_t bytes = nodes.capacity() * sizeof(Node) + edges.capacity() * sizeof(Edge)
+                   + edge_weights.capacity() * sizeof(float)
+                   + (removed_nodes.capacity() + removed_edges.capacity()) / 8;
+    for (const auto &node: nodes) {
+        if (const auto *value = std::get_if<UserDefinedValue>(&node.data)) {
+            bytes += value->encoded_size();
+        } else if (const auto *text = std::get_if<std::string>(&std::get<BasicValue>(node.data).data);
+            text != nullptr && text->capacity() > std::string().capacity()) {
+            bytes += text->capacity();
+        }
+    }
+    bytes += node_slots.size() * (sizeof(std::pair<const int, size_t>) + sizeof(void *))
+            + node_slots.bucket_count() * sizeof(void *);
+    for (const auto &index: ordered_indexes | std::views::values) {
+        bytes += index.memory_usage();
+    }
+    for (const auto &index: ngram_indexes | std::views::values) {
+        bytes += index.memory_usage();
+    }
+    for (const auto &index: bitmap_indexes | std::views::values) {
+        bytes += index.memory_usage();
+    }
+    for (const auto &statistics: field_statistics | std::views::values) {
+        bytes += statistics.memory_usage();
+    }
+    for (const auto &adjacency: adjacency_cache) {
+        if (adjacency) {
+            bytes += adjacency->memory_usage();
+        }
+    }
+    if (edge_lookup) {
+        bytes += edge_lookup->memory_usage() + edge_lookup_pending.size() * (sizeof(std::pair<const int, size_t>) +
+                                                                           2 * sizeof(void *));
+    }
+    return bytes;
+}
+
+auto Graph::tombstone_ratio() const -> double {
+    const auto total = nodes.size() + edges.size();
+    if (total == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(removed_nodes_count + removed_edges_count) / static_cast<double>(total);
+}
+
+auto Graph::compact() -> void {
+    // Single stable pass per vector, so the cost is linear in the graph size and the
+    // relative order of surviving nodes and edges is kept.
+    size_t write = 0;
+    for (size_t slot = 0; slot < nodes.size(); ++slot) {
+        if (!is_node_removed(slot)) {
+            if (write != slot) {
+                nodes[write] = std::move(nodes[slot]);
+            }
+            ++write;
+        }
+    }
+    nodes.resize(write);
+    removed_nodes.clear();
+
+    // removed_nodes_count stays set until the edges are rewritten, so dangling ones are recognized.
+    if (edge_store) {
+        // Mapped edges are read-only, dropping removed ones means writing the next store.
+        rebuild_indexes();
+        merge_edges();
+        removed_nodes_count = 0;
+        return;
+    }
+
+    write = 0;
+    for (size_t slot = 0; slot < edges.size(); ++slot) {
+        if (!is_edge_removed(slot) && !is_edge_dangling(slot)) {
+            if (!edge_weights.empty()) {
+                edge_weights.set(write, edge_weights[slot]);
+            }
+            edges.set(write++, edges[slot]);
+        }
+    }
+    edges.resize(write);
+    if (!edge_weights.empty()) {
+        edge_weights.resize(write);
+    }
+    removed_edges.clear();
+    removed_edges_count = 0;
+    removed_nodes_count = 0;
+
+    rebuild_indexes();
+}
+
+auto Graph::reorder(const std::vector<uint32_t> &order) -> void {
+    auto reordered = std::vector<Node>{};
+    reordered.reserve(nodes.size());
+    for (const auto slot: order) {
+        reordered.push_back(std::move(nodes[slot]));
+    }
+    nodes = std::move(reordered);
+    // Node slots, indexes and adjacency follow the new order. Mapped adjacency is stored by slot,
+    // so it is written again.
+    rebuild_indexes();
+    if (edge_store) {
+        merge_edges();
+    }
+    dirty = true;
+}
+
+auto Graph::merge_edges() -> void {
+    if (edge_store_shared) {
+        throw std::logic_error(std::format("Graph {} must not write edge stores of another process", name));
+    }
+    // The mapped base is sorted by (from, to) already, only edges added since are sorted here.
+    // Both runs are then merged while streaming into the new store, without copying the base.
+    const auto base_size = edges.base_size();
+    auto added = std::vector<size_t>{};
+    added.reserve(edges.delta_size());
+    for (auto slot = base_size; slot < edges.size(); ++slot) {
+        if (!is_edge_removed(slot) && !is_edge_dangling(slot)) {
+            added.push_back(slot);
+        }
+    }
+    auto edge_less = [this](const size_t left, const size_t right) {
+        const auto &[left_from, left_to] = edges[left];
+        const auto &[right_from, right_to] = edges[right];
+        return std::tie(left_from, left_to) < std::tie(right_from, right_to);
+    };
+    rg::stable_sort(added, edge_less);
+
+    auto for_each_edge = [&](auto visit) {
+        size_t base_slot = 0;
+        size_t next_added = 0;
+        while (true) {
+            while (base_slot < base_size && (is_edge_removed(base_slot) || is_edge_dangling(base_slot))) {
+                ++base_slot;
+            }
+            if (base_slot == base_size && next_added == added.size()) {
+                break;
+            }
+            const auto take_added = base_slot == base_size ||
+                                    (next_added < added.size() && edge_less(added[next_added], base_slot));
+            const auto slot = take_added ? added[next_added++] : base_slot++;
+            visit(edges[slot], edge_weight(slot));
+        }
+    };
+    auto slot_of = [this](const int id) -> std::optional<uint32_t> {
+        const auto it = node_slots.find(id);
+        return it == node_slots.end() ? std::nullopt : std::optional(static_cast<uint32_t>(it->second));
+    };
+
+    const auto generation = edge_store ? edge_store->generation() + 1 : 1;
+    const auto path = EdgeStore::path_for(name, generation);
+    EdgeStore::write(path, generation, nodes.size(), !edge_weights.empty(), for_each_edge, slot_of);
+
+    auto store = EdgeStore::open(path);
+    if (edge_store) {
+        retired_edge_stores.push_back(edge_store->path());
+    }
+    edge_store = std::move(store);
+    edges.map(edge_store->edges());
+    edge_weights.map(edge_store->weights());
+    removed_edges.clear();
+    removed_edges_count = 0;
+    invalidate_adjacency();
+    invalidate_edge_lookup();
+    dirty = true;
+}
+
+auto Graph::unmap_edges() -> void {
+    if (!edge_store) {
+        return;
+    }
+    edges.materialize();
+    edge_weights.materialize();
+    retired_edge_stores.push_back(edge_store->path());
+    edge_store.reset();
+    invalidate_adjacency();
+    invalidate_edge_lookup();
+    dirty = true;
+}
+
+auto Graph::edge_store_current() const -> bool {
+    return edge_store && edges.delta_size() == 0 && edge_weights.delta_size() == 0 && removed_edges_count == 0 &&
+           removed_nodes_count == 0 && nodes.size() == edge_store->node_count();
+}
+
+auto Graph::rebuild_indexes() -> void {
+    invalidate_adjacency();
+    invalidate_edge_lookup();
+    node_slots.clear();
+    node_slots.reserve(nodes.size());
+    for (size_t slot = 0; slot < nodes.size(); ++slot) {
+        if (!is_node_removed(slot)) {
+            node_slots[nodes[slot].id] = slot;
+        }
+    }
+
+    auto entries_of = [this](const std::string &field) {
+        std::vector<OrderedIndex::Entry> entries;
+        for (size_t slot = 0; slot < nodes.size(); ++slot) {
+            if (is_node_removed(slot)) {
+                continue;
+            }
+            if (const auto value = nodes[slot].field(field)) {
+                entries.emplace_back(*value, slot);
+            }
+        }
+        return entries;
+    };
+    for (auto &[field, index]: ordered_indexes) {
+        index.assign(entries_of(field));
+    }
+    for (auto &[field, index]: ngram_indexes) {
+        index.assign(entries_of(field));
+    }
+    for (auto &[field, index]: bitmap_indexes) {
+        index.assign(entries_of(field));
+    }
+    field_statistics.clear();
+    for (size_t slot = 0; slot < nodes.size(); ++slot) {
+        if (const auto *value = std::get_if<UserDefinedValue>(&nodes[slot].data); value && !is_node_removed(slot)) {
+            value->for_each_value([this](const uint32_t key, const BasicValue &field) {
+                field_statistics[key].add(field);
+            });
+        }
+    }
+}
+
+auto Graph::adjacency_patchable() const -> bool {
+    return edge_store && nodes.size() >= edge_store->node_count() &&
+           edge_weights.empty() != edge_store->weighted() &&
+           (nodes.size() == edge_store->node_count() || edge_store->adjacency_complete());
+}
+
+auto Graph::adjacency(const Direction direction) const -> const Adjacency & {
+    auto &cached = adjacency_cache[static_cast<size_t>(direction)];
+    if (!cached && adjacency_patchable()) {
+        // The views of the store, with what changed since it was written patched in. That takes tombstones
+        // and the in-memory edges, but not the edges of the store.
+        auto outgoing = EdgeStore::adjacency(edge_store, Direction::Outgoing);
+        auto incoming = EdgeStore::adjacency(edge_store, Direction::Incoming);
+        auto both = EdgeStore::adjacency(edge_store, Direction::Both);
+        auto overlay = AdjacencyOverlay(outgoing, incoming, both, !edge_weights.empty());
+        for (auto slot = edge_store->node_count(); slot < nodes.size(); ++slot) {
+            overlay.add_slot();
+        }
+        auto slot_of = [this](const int id) -> std::optional<uint32_t> {
+            const auto it = node_slots.find(id);
+            return it == node_slots.end() ? std::nullopt : std::optional(static_cast<uint32_t>(it->second));
+        };
+        const auto base_size = edges.base_size();
+        const auto removed_base_edges = removed_edges_count > 0 ? std::min(base_size, removed_edges.size()) : 0;
+        for (size_t slot = 0; slot < removed_base_edges; ++slot) {
+            if (!removed_edges[slot]) {
+                continue;
+            }
+            const auto from = slot_of(edges[slot].from);
+            const auto to = slot_of(edges[slot].to);
+            if (from && to) {
+                overlay.remove_edges(*from, *to);
+            }
+        }
+        const auto removed_base_nodes = removed_nodes_count > 0
+                                            ? std::min(removed_nodes.size(), edge_store->node_count())
+                                            : 0;
+        for (size_t slot = 0; slot < removed_base_nodes; ++slot) {
+            if (removed_nodes[slot]) {
+                overlay.remove_slot(static_cast<uint32_t>(slot));
+            }
+        }
+        adjacency_waiting_edges = 0;
+        for (auto slot = base_size; slot < edges.size(); ++slot) {
+            if (is_edge_removed(slot)) {
+                continue;
+            }
+            const auto from = slot_of(edges[slot].from);
+            const auto to = slot_of(edges[slot].to);
+            if (from && to) {
+                overlay.add_edge(*from, *to, edge_weight(slot));
+            } else if (!is_edge_dangling(slot)) {
+                ++adjacency_waiting_edges;
+            }
+        }
+        adjacency_cache[static_cast<size_t>(Direction::Outgoing)] = std::move(outgoing);
+        adjacency_cache[static_cast<size_t>(Direction::Incoming)] = std::move(incoming);
+        adjacency_cache[static_cast<size_t>(Direction::Both)] = std::move(both);
+    }
+    if (!cached) {
+        // Edges referencing nodes that do not exist (anymore) have no slot and are left out.
+        std::vector<std::pair<uint32_t, uint32_t> > slot_edges;
+        std::vector<float> slot_weights;
+        slot_edges.reserve(edges.size() - removed_edges_count);
+        slot_weights.reserve(edge_weights.empty() ? 0 : slot_edges.capacity());
+        for (size_t slot = 0; slot < edges.size(); ++slot) {
+            if (is_edge_removed(slot)) {
+                continue;
+            }
+            const auto from_slot = node_slots.find(edges[slot].from);
+            const auto to_slot = node_slots.find(edges[slot].to);
+            if (from_slot != node_slots.end() && to_slot != node_slots.end()) {
+                slot_edges.emplace_back(from_slot->second, to_slot->second);
+                if (!edge_weights.empty()) {
+                    slot_weights.push_back(edge_weights[slot]);
+                }
+            }
+        }
+        cached = Adjacency::build(nodes.size(), slot_edges, direction, slot_weights);
+    }
+    return *cached;
+}
+
+auto Graph::invalidate_adjacency() -> void {
+    for (auto &cached: adjacency_cache) {
+        cached.reset();
+    }
+    adjacency_waiting_edges = 0;
+}
+
+auto Graph::adjacency_overlay() -> std::optional<AdjacencyOverlay> {
+    auto &[outgoing, incoming, both] = adjacency_cache;
+    if (outgoing && outgoing->mapping && incoming && both && adjacency_patchable()) {
+        return AdjacencyOverlay(*outgoing, *incoming, *both, !edge_weights.empty());
+    }
+    invalidate_adjacency();
+    return std::nullopt;
+}
+
+auto Graph::edge_slots_from(const int from) const -> std::vector<size_t> {
+    const auto first = edges.base_size();
+    if (!edge_lookup || edge_lookup_pending.size() > 1024 + edge_lookup->edge_count() / 8) {
+        // Edges whose source has no slot yet can not be placed in the CSR and wait with the additions.
+        edge_lookup_pending.clear();
+        auto entries = std::vector<std::pair<uint32_t, uint32_t> >{};
+        entries.reserve(edges.size() - first);
+        for (auto slot = first; slot < edges.size(); ++slot) {
+            if (is_edge_removed(slot)) {
+                continue;
+            }
+            if (const auto it = node_slots.find(edges[slot].from); it != node_slots.end()) {
+                entries.emplace_back(it->second, static_cast<uint32_t>(slot - first));
+            } else {
+                edge_lookup_pending.emplace(edges[slot].from, slot);
+            }
+        }
+        edge_lookup = Adjacency::build(nodes.size(), entries, Direction::Outgoing);
+    }
+
+    auto slots = std::vector<size_t>{};
+    if (const auto it = node_slots.find(from); it != node_slots.end() && it->second < edge_lookup->node_count()) {
+        for (const auto offset: edge_lookup->neighbors(it->second)) {
+            slots.push_back(first + offset);
+        }
+    }
+    const auto [pending_first, pending_last] = edge_lookup_pending.equal_range(from);
+    for (auto it = pending_first; it != pending_last; ++it) {
+        slots.push_back(it->second);
+    }
+    return slots;
+}
+
+auto Graph::invalidate_edge_lookup() -> void {
+    edge_lookup.reset();
+    edge_lookup_pending.clear();
+}
+
+auto Graph::undo_changes() -> void {
+    // Taken out first, so the calls below are not recorded themselves.
+    auto recorded = std::exchange(changes, std::nullopt);
+    if (!recorded) {
+        return;
+    }
+    for (auto &change: *recorded | std::views::reverse) {
+        std::visit([this]<typename T0>(T0 &undo) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::is_same_v<T, AddedNode>) {
+                const auto slot = nodes.size() - 1;
+                unindex_node(slot);
+                node_slots.erase(nodes[slot].id);
+                nodes.pop_back();
+                last_node_id = undo.previous_last_node_id;
+            } else if constexpr (std::is_same_v<T, AddedEdge>) {
+                edges.resize(edges.size() - 1);
+                if (undo.materialized_weights) {
+                    edge_weights = std::vector<float>{};
+                } else if (!edge_weights.empty()) {
+                    edge_weights.resize(edges.size());
+                }
+            } else if constexpr (std::is_same_v<T, UpdatedNode>) {
+                update_node(nodes[undo.slot], std::move(undo.data));
+            } else if constexpr (std::is_same_v<T, RemovedNode>) {
+                removed_nodes[undo.slot] = false;
+                --removed_nodes_count;
+                node_slots[nodes[undo.slot].id] = undo.slot;
+                index_node(undo.slot);
+            } else if constexpr (std::is_same_v<T, RemovedEdge>) {
+                removed_edges[undo.slot] = false;
+                --removed_edges_count;
+            } else if constexpr (std::is_same_v<T, CreatedIndex>) {
+                switch (undo.kind) {
+                    case CreatedIndex::Kind::Ordered: ordered_indexes.erase(undo.field);
+                        break;
+                    case CreatedIndex::Kind::Ngram: ngram_indexes.erase(undo.field);
+                        break;
+                    case CreatedIndex::Kind::Bitmap: bitmap_indexes.erase(undo.field);
+                        break;
+                }
+            }
+        }, change);
+    }
+    removed_nodes.resize(std::min(removed_nodes.size(), nodes.size()));
+    removed_edges.resize(std::min(removed_edges.size(), edges.size()));
+    invalidate_adjacency();
+    invalidate_edge_lookup();
+}
+
+auto Graph::create_ordered_index(const std::string &field) -> bool {
+    if (!ordered_indexes.try_emplace(field).second) {
+        return false;
+    }
+    if (changes) {
+        changes->emplace_back(CreatedIndex{CreatedIndex::Kind::Ordered, field});
+    }
+    rebuild_indexes();
+    dirty = true;
+    return true;
+}
+
+auto Graph::create_ngram_index(const std::string &field) -> bool {
+    if (!ngram_indexes.try_emplace(field).second) {
+        return false;
+    }
+    if (changes) {
+        changes->emplace_back(CreatedIndex{CreatedIndex::Kind::Ngram, field});
+    }
+    rebuild_indexes();
+    dirty = true;
+    return true;
+}
+
+auto Graph::create_bitmap_index(const std::string &field) -> bool {
+    if (!bitmap_indexes.try_emplace(field).second) {
+        return false;
+    }
+    if (changes) {
+        changes->emplace_back(CreatedIndex{CreatedIndex::Kind::Bitmap, field});
+    }
+    rebuild_indexes();
+    dirty = true;
+    return true;
+}
+
+auto Graph::statistics_of(const std::string_view field) const -> const FieldStatistics * {
+    const auto key = FieldKeys::instance().lookup(field);
+    const auto it = key ? field_statistics.find(*key) : field_statistics.end();
+    return it == field_statistics.end() ? nullptr : &it->second;
+}
+
+auto Graph::index_node(const size_t slot) -> void {
+    if (const auto *value = std::get_if<UserDefinedValue>(&nodes[slot].data)) {
+        value->for_each_value([this](const uint32_t key, const BasicValue &field) {
+            field_statistics[key].add(field);
+        });
+    }
+    for (auto &[field, index]: ordered_indexes) {
+        if (const auto value = nodes[slot].field(field)) {
+            index.insert(*value, slot);
+        }
+    }
+    for (auto &[field, index]: ngram_indexes) {
+        if (const auto value = nodes[slot].field(field)) {
+            index.insert(*value, slot);
+        }
+    }
+    for (auto &[field, index]: bitmap_indexes) {
+        if (const auto value = nodes[slot].field(field)) {
+            index.insert(*value, slot);
+        }
+    }
+}
+
+auto Graph::unindex_node(const size_t slot) -> void {
+    if (const auto *value = std::get_if<UserDefinedValue>(&nodes[slot].data)) {
+        value->for_each_value([this](const uint32_t key, const BasicValue &) {
+            field_statistics[key].remove();
+        });
+    }
+    for (auto &[field, index]: ordered_indexes) {
+        if (const auto value = nodes[slot].field(field)) {
+            index.erase(*value, slot);
+        }
+    }
+    for (auto &[field, index]: ngram_indexes) {
+        if (const auto value = nodes[slot].field(field)) {
+            index.erase(*value, slot);
+        }
+    }
+    for (auto &[field, index]: bitmap_indexes) {
+        if (const auto value = nodes[slot].field(field)) {
+            index.erase(*value, slot);
+        }
+    }
+}
+
 auto Database::set_graph(Graph &graph) -> void {
+    load_graph(graph);
+    graph.last_used = ++use_clock;
     this->current_graph = &graph;
+    enforce_memory_budget();
 }
 
 auto Database::add_node(Node &node) const -> void {
     if (this->current_graph == nullptr) {
-        logger.error("To execute queries first specify graph with USE command");
+        report_error("To execute queries first specify graph with USE command");
         return;
     }
     logger.info(std::format("Adding node with id {} to the graph with name {}", node.id, this->current_graph->name));
-    this->current_graph->nodes.emplace_back(node);
+    this->current_graph->add_node(node);
+}
+
+auto Database::add_edge(Edge &edge, const std::optional<float> weight) const -> void {
+    if (this->current_graph == nullptr) {
+        report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    logger.info(std::format("Adding edge from {} to {}", edge.from, edge.to));
+    this->current_graph->add_edge(edge, weight);
+}
+
+auto Database::remove_node(const int id) const -> void {
+    if (this->current_graph == nullptr) {
+        report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    if (!this->current_graph->remove_node(id)) {
+        report_error(std::format("No node found with id {}", id));
+        return;
+    }
+    logger.info(std::format("Removed node with id {} from the graph with name {}", id, this->current_graph->name));
+}
+
+auto Database::remove_edge(const int from, const int to) const -> void {
+    if (this->current_graph == nullptr) {
+        report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    const auto removed = this->current_graph->remove_edges(from, to);
+    if (removed == 0) {
+        report_error(std::format("No edge found from {} to {}", from, to));
+        return;
+    }
+    logger.info(std::format("Removed {} edge(s) from {} to {}", removed, from, to));
+}
+
+// Inode of the snapshot file. The primary renames every new snapshot over the old one, so a change
+// tells a replica that its catalog offsets are stale.
+static auto snapshot_inode(const char *path) -> uint64_t {
+    struct stat status{};
+    return ::stat(path, &status) == 0 ? static_cast<uint64_t>(status.st_ino) : 0;
+}
+
+Database::Database(const DatabaseConfig config) : config(config) {
+    // Taken before reading, so a snapshot replaced meanwhile is restored again on the first catch-up.
+    if (config.replica) {
+        snapshot_identity = snapshot_inode(snapshot_path);
+    }
+    try {
+        restore_snapshot();
+    } catch (const std::exception &e) {
+        // Starting empty would overwrite the snapshot at the next synchronization.
+        throw std::runtime_error(std::format("Failed to restore {}: {}. Check it with --verify and restore a "
+                                             "backup, or move it away to start with an empty database.",
+                                             snapshot_path, e.what()));
+    }
+    if (config.replica) {
+        follow_log();
+        return;
+    }
+    try {
+        replay_log();
+    } catch (const std::runtime_error &e) {
+        // Resetting the log would drop every record past the damaged one.
+        throw std::runtime_error(std::format("Failed to replay {}: {}. Check it with --verify.", log_path,
+                                             e.what()));
+    }
 }
 
-auto Database::add_edge(Edge &edge) const -> void {
+// Catalog of a snapshot with every graph unloaded, nullopt for snapshots written without a catalog.
+// Throws when the header fails its checksum or the file is not as long as the catalog says.
+static auto read_snapshot_header(std::ifstream &file) -> std::optional<Snapshot> {
+    // The header grows with the number of graphs, read until it is complete.
+    static constexpr auto graphs_key = std::string_view(R"("graphs":[)");
+    auto header = std::string{};
+    for (size_t chunk = 64 * 1024;; chunk *= 2) {
+        const auto size = header.size();
+        header.resize(size + chunk);
+        file.read(header.data() + size, static_cast<std::streamsize>(chunk));
+        header.resize(size + static_cast<size_t>(file.gcount()));
+        if (const auto end = header.find(graphs_key); end != std::string::npos) {
+            header.resize(end + graphs_key.size());
+            break;
+        }
+        if (!file) {
+            break;
+        }
+    }
+
+    auto snapshot = Deserialization::parse_snapshot_header(header);
+    if (snapshot) {
+        // Graphs are only read on first USE, a truncated file has to be noticed now.
+        file.clear();
+        file.seekg(0, std::ios::end);
+        if (const auto size = static_cast<size_t>(file.tellg()); size != snapshot->expected_size) {
+            throw std::runtime_error(std::format("Snapshot has {} byte(s), its catalog describes {}", size,
+                                                 snapshot->expected_size));
+        }
+    }
+    return snapshot;
+}
+
+auto Database::restore_snapshot() -> void {
+    std::ifstream file(snapshot_path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "No snapshot file found. Starting with an empty database." << std::endl;
+        return;
+    }
+
+    if (auto snapshot = read_snapshot_header(file)) {
+        this->graphs = std::move(snapshot->graphs);
+        this->checkpoint = snapshot->checkpoint;
+        // Kept only once the catalog is taken, graphs of a catalog that failed must not read a newer file.
+        this->snapshot_file = std::move(file);
+        logger.info(std::format("Database catalog restored from file, {} graph(s) load on first USE",
+                                this->graphs.size()));
+        return;
+    }
+
+    file.clear();
+    file.seekg(0);
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    auto snapshot = Deserialization::parse_snapshot(buffer.str());
+    this->graphs = std::move(snapshot.graphs);
+    this->checkpoint = snapshot.checkpoint;
+    for (auto &graph: graphs) {
+        graph.edge_store_shared = config.replica;
+    }
+    logger.info("Database successfully restored from file.");
+}
+
+auto Database::verify_storage() -> bool {
+    const auto started = std::chrono::steady_clock::now();
+    size_t damaged = 0;
+    std::optional<uint32_t> snapshot_checkpoint;
+
+    if (std::ifstream file(snapshot_path, std::ios::binary); !file.is_open()) {
+        fmt::println("{}: missing", snapshot_path);
+    } else {
+        try {
+            if (const auto snapshot = read_snapshot_header(file)) {
+                snapshot_checkpoint = snapshot->checkpoint;
+                fmt::println("{}: checkpoint {}, {} graph(s), {} byte(s), catalog ok", snapshot_path,
+                             snapshot->checkpoint, snapshot->graphs.size(), snapshot->expected_size);
+                auto segment = std::string{};
+                for (const auto &graph: snapshot->graphs) {
+                    segment.resize(graph.snapshot_length);
+                    file.clear();
+                    file.seekg(static_cast<std::streamoff>(graph.snapshot_offset));
+                    file.read(segment.data(), static_cast<std::streamsize>(segment.size()));
+                    if (!graph.snapshot_checksum) {
+                        fmt::println("  graph {}: {} byte(s), written without a checksum", graph.name,
+                                     graph.snapshot_length);
+                    } else if (const auto crc = Crc32c::of(segment); crc != *graph.snapshot_checksum) {
+                        fmt::println("  graph {}: {} byte(s), DAMAGED, checksum {:08x} instead of {:08x}",
+                                     graph.name, graph.snapshot_length, crc, *graph.snapshot_checksum);
+                        ++damaged;
+                        continue;
+                    } else {
+                        fmt::println("  graph {}: {} byte(s) ok", graph.name, graph.snapshot_length);
+                    }
+                    // Mapped edges live in a store file of their own. Opening it only checks its header.
+                    try {
+                        size_t pos = 0;
+                        if (const auto loaded = Deserialization::parse_graph(segment, pos); loaded.edge_store) {
+                            const auto &store = *loaded.edge_store;
+                            store.verify();
+                            fmt::println("  {}: {} byte(s){}", store.path(), store.size_bytes(),
+                                         store.checksummed() ? " ok" : ", written without checksums, structure ok");
+                        }
+                    } catch (const std::exception &e) {
+                        fmt::println("  graph {}: DAMAGED, {}", graph.name, e.what());
+                        ++damaged;
+                    }
+                }
+            } else {
+                // Written before the catalog and checksums, only parsing can tell.
+                file.clear();
+                file.seekg(0);
+                std::ostringstream buffer;
+                buffer << file.rdbuf();
+                const auto legacy = Deserialization::parse_snapshot(buffer.str());
+                snapshot_checkpoint = legacy.checkpoint;
+                fmt::println("{}: checkpoint {}, {} graph(s), written without checksums, parsed ok", snapshot_path,
+                             legacy.checkpoint, legacy.graphs.size());
+            }
+        } catch (const std::exception &e) {
+            fmt::println("{}: DAMAGED, {}", snapshot_path, e.what());
+            ++damaged;
+        }
+    }
+
+    try {
+        if (const auto log = MutationLog(log_path).inspect(); !log) {
+            fmt::println("{}: missing or empty", log_path);
+        } else {
+            fmt::println("{}: extends checkpoint {}{}, {} record(s){}", log_path, log->checkpoint,
+                         snapshot_checkpoint == log->checkpoint ? "" : " (not the snapshot's, ignored on startup)",
+                         log->records.size(),
+                         !log->checksummed       ? " written without checksums"
+                         : !log->lengths_checked ? " ok, written without length checksums"
+                                                 : " ok");
+            if (log->offset < log->size) {
+                fmt::println("  {} byte(s) after the last record are incomplete, dropped on replay",
+                             log->size - log->offset);
+            }
+        }
+    } catch (const std::exception &e) {
+        fmt::println("{}: DAMAGED, {}", log_path, e.what());
+        ++damaged;
+    }
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started);
+    fmt::println("Verified with CRC32C ({}) in {:.1f} ms, {} damaged part(s)", Crc32c::implementation(),
+                 elapsed.count(), damaged);
+    return damaged == 0;
+}
+
+auto Database::load_graph(Graph &graph) const -> void {
+    if (graph.resident) {
+        return;
+    }
+    auto json = std::string(graph.snapshot_length, '\0');
+    snapshot_file.clear();
+    snapshot_file.seekg(static_cast<std::streamoff>(graph.snapshot_offset));
+    if (!snapshot_file.read(json.data(), static_cast<std::streamsize>(json.size()))) {
+        throw std::runtime_error(std::format("Failed to read graph {} from snapshot", graph.name));
+    }
+    if (graph.snapshot_checksum && Crc32c::of(json) != *graph.snapshot_checksum) {
+        throw std::runtime_error(std::format("Graph {} fails its snapshot checksum", graph.name));
+    }
+
+    size_t pos = 0;
+    auto loaded = Deserialization::parse_graph(json, pos);
+    if (loaded.name != graph.name) {
+        throw std::runtime_error(std::format("Snapshot catalog points at graph {} instead of {}", loaded.name,
+                                             graph.name));
+    }
+    loaded.snapshot_offset = graph.snapshot_offset;
+    loaded.snapshot_length = graph.snapshot_length;
+    loaded.snapshot_checksum = graph.snapshot_checksum;
+    loaded.last_used = graph.last_used;
+    loaded.edge_store_shared = config.replica;
+    loaded.dirty = false;
+    graph = std::move(loaded);
+    logger.info(std::format("Loaded graph {} from snapshot, {} node(s)", graph.name, graph.live_node_count()));
+}
+
+auto Database::enforce_memory_budget() -> void {
+    if (config.memory_budget == 0) {
+        return;
+    }
+
+    auto usage = std::vector<std::pair<size_t, Graph *> >{};
+    size_t total = 0;
+    for (auto &graph: graphs) {
+        if (graph.resident) {
+            usage.emplace_back(graph.memory_usage(), &graph);
+            total += usage.back().first;
+        }
+    }
+    // Least recently used first. The current graph is never evicted.
+    rg::sort(usage, {}, [](const auto &entry) { return entry.second->last_used; });
+
+    bool synchronized = false;
+    for (size_t i = 0; i < usage.size() && total > config.memory_budget;) {
+        auto &[bytes, graph] = usage[i];
+        if (graph == current_graph || !graph->resident) {
+            ++i;
+            continue;
+        }
+        if (graph->dirty || graph->snapshot_length == 0) {
+            // Changes must reach the snapshot before the graph can be read back from it, which a
+            // replica can not do.
+            if (synchronized || config.replica) {
+                ++i;
+                continue;
+            }
+            sync_with_storage();
+            synchronized = true;
+            i = 0;
+            continue;
+        }
+        logger.info(std::format("Evicting graph {} (~{:.1f} MiB) to stay within the memory budget", graph->name,
+                                static_cast<double>(bytes) / (1024.0 * 1024.0)));
+        auto stub = Graph{};
+        stub.name = std::move(graph->name);
+        stub.snapshot_offset = graph->snapshot_offset;
+        stub.snapshot_length = graph->snapshot_length;
+        stub.snapshot_checksum = graph->snapshot_checksum;
+        stub.last_used = graph->last_used;
+        stub.dirty = false;
+        stub.resident = false;
+        *graph = std::move(stub);
+        total -= bytes;
+        ++i;
+    }
+}
+
+auto Database::replay_log() -> void {
+    const auto records = mutation_log.read(checkpoint);
+    if (records.empty()) {
+        mutation_log.reset(checkpoint);
+        return;
+    }
+
+    size_t replayed = 0;
+    for (const auto &record: records) {
+        replayed += apply_record(record);
+    }
+    current_graph = nullptr;
+    current_id = 0;
+    logger.info(std::format("Replayed {} statement(s) from the mutation log", replayed));
+    // Folding the replayed statements into a new snapshot also resets the log. Records that changed
+    // nothing, such as failures logged by earlier versions, would otherwise be replayed on every start.
+    if (has_unsynchronized_changes()) {
+        synchronize();
+    } else {
+        mutation_log.reset(checkpoint);
+    }
+}
+
+auto Database::apply_record(const LogRecord &record) -> size_t {
+    const auto it = rg::find(graphs, record.graph, &Graph::name);
+    if (it != graphs.end()) {
+        load_graph(*it);
+    }
+    current_graph = it == graphs.end() ? nullptr : &*it;
+    current_id = record.current_id;
+    // Statements the primary ran are replayed as they went there, failures included. They must not fail
+    // the read that made a replica catch up.
+    const auto failed = statement_failed;
+    for (const auto &statement: record.statements) {
+        try {
+            const auto query = Query::from_string(statement);
+            // Edge stores are files of the primary, a replica keeps its edges in memory and its own layout.
+            if (!query || (config.replica && (query->get_commands().front().keyword == "SET STORAGE" ||
+                                              query->get_commands().front().keyword == "REORDER GRAPH"))) {
+                continue;
+            }
+            query->handle(*this);
+        } catch (const std::exception &e) {
+            std::cerr << std::format("Failed to replay statement {}: {}", statement, e.what()) << std::endl;
+        }
+    }
+    statement_failed = failed;
+    return record.statements.size();
+}
+
+auto Database::follow_log() -> void {
+    const auto now = std::chrono::steady_clock::now();
+    if (caught_up_at != std::chrono::steady_clock::time_point{} && now - caught_up_at < config.max_staleness) {
+        return;
+    }
+    // Statements of the log run against the graph they were logged for, the session's graph is selected
+    // again afterwards. Graphs are looked up by name since the list may grow or be restored.
+    const auto selected = current_graph == nullptr ? std::string{} : current_graph->name;
+    const auto selected_id = current_id;
+
+    if (const auto identity = snapshot_inode(snapshot_path); identity != snapshot_identity) {
+        // A new snapshot holds every record of the log it replaced, so following starts over from it.
+        current_graph = nullptr;
+        try {
+            restore_snapshot();
+        } catch (const std::exception &e) {
+            std::cerr << std::format("Replica failed to restore the new snapshot: {}", e.what()) << std::endl;
+            return;
+        }
+        logger.info(std::format("Replica restored snapshot at checkpoint {}", checkpoint));
+        snapshot_identity = identity;
+        log_offset = 0;
+    }
+
+    auto log = std::optional<LogTail>{};
+    try {
+        log = mutation_log.tail(checkpoint, log_offset);
+    } catch (const std::runtime_error &e) {
+        std::cerr << std::format("Replica stopped following the log: {}", e.what()) << std::endl;
+        return;
+    }
+    if (log) {
+        for (const auto &record: log->records) {
+            apply_record(record);
+        }
+        replicated_records += log->records.size();
+        log_offset = log->offset;
+        if (!log->records.empty()) {
+            logger.debug(std::format("Replica applied {} record(s), log offset {}", log->records.size(),
+                                     log_offset));
+        }
+    }
+    caught_up_at = now;
+
+    const auto it = rg::find(graphs, selected, &Graph::name);
+    current_graph = nullptr;
+    if (it != graphs.end()) {
+        try {
+            load_graph(*it);
+            current_graph = &*it;
+        } catch (const std::runtime_error &e) {
+            std::cerr << std::format("Failed to load graph {}: {}", it->name, e.what()) << std::endl;
+        }
+    }
+    current_id = selected_id;
+}
+
+auto Database::flush_log() -> void {
+    try {
+        mutation_log.flush(false);
+    } catch (const std::runtime_error &e) {
+        std::cerr << std::format("Failed to write mutation log: {}", e.what()) << std::endl;
+    }
+}
+
+auto Database::has_graph() const -> bool {
+    return this->current_graph != nullptr;
+}
+
+auto Database::get_graph() const -> Graph & {
+    return *this->current_graph;
+}
+
+auto Database::get_graphs() -> std::vector<Graph> & {
+    return this->graphs;
+}
+
+auto Database::add_graph(Graph &graph) -> void {
+    auto const graph_already_exists = std::ranges::find_if(this->graphs, [&graph](const Graph &g) {
+        return g.name == graph.name;
+    }) != this->graphs.end();
+    if (graph_already_exists) {
+        report_error(std::format("Graph {} already exists.", graph.name));
+    } else {
+        logger.info(std::format("Created new graph with name {}", graph.name));
+        // push_back may reallocate, so the current graph is found again by its position.
+        const auto current = this->current_graph == nullptr ? -1 : this->current_graph - this->graphs.data();
+        this->graphs.push_back(graph);
+        if (current >= 0) {
+            this->current_graph = &this->graphs[static_cast<size_t>(current)];
+        }
+        this->catalog_dirty = true;
+    }
+}
+
+auto Database::has_unsynchronized_changes() const -> bool {
+    return catalog_dirty || rg::any_of(graphs, &Graph::dirty);
+}
+
+auto Database::sync_with_storage() -> void {
+    if (!has_unsynchronized_changes()) {
+        logger.debug("Nothing changed since last synchronization, skipping");
+        unsynchronized_queries_count = 0;
+        return;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    try {
+        // Mapped graphs reference their edge store from the snapshot, so pending edge changes are merged
+        // into it first. Removed nodes are compacted away as well, since reloading renumbers node slots.
+        for (auto &graph: graphs) {
+            if (!graph.resident || !graph.edge_store) {
+                continue;
+            }
+            if (graph.removed_nodes_count > 0) {
+                graph.compact();
+            } else if (!graph.edge_store_current()) {
+                graph.merge_edges();
+            }
+        }
+
+        // Graphs that did not change are copied as raw bytes from the previous snapshot.
+        std::ifstream previous(snapshot_path, std::ios::binary);
+
+        // Graphs are assembled first, the catalog in front of them needs their byte ranges.
+        std::string snapshot;
+        auto ranges = std::vector<std::pair<size_t, size_t> >{};
+        auto checksums = std::vector<uint32_t>{};
+        size_t serialized = 0;
+        for (const auto &graph: graphs) {
+            if (&graph != &graphs.front()) {
+                snapshot += ",";
+            }
+            const auto offset = snapshot.size();
+            if (!graph.resident && !previous.is_open()) {
+                throw std::runtime_error(std::format("Graph {} is not loaded and the previous snapshot is missing",
+                                                     graph.name));
+            }
+            if (graph.dirty || graph.snapshot_length == 0 || !previous.is_open()) {
+                snapshot += Serialization::serialize_graph(graph);
+                checksums.push_back(Crc32c::of(std::string_view(snapshot).substr(offset)));
+                ++serialized;
+            } else {
+                snapshot.resize(offset + graph.snapshot_length);
+                previous.seekg(static_cast<std::streamoff>(graph.snapshot_offset));
+                if (!previous.read(snapshot.data() + offset, static_cast<std::streamsize>(graph.snapshot_length))) {
+                    throw std::runtime_error(std::format("Failed to copy graph {} from previous snapshot", graph.name));
+                }
+                // Copied bytes keep their checksum, so a graph damaged on disk is not certified as intact.
+                checksums.push_back(graph.snapshot_checksum ? *graph.snapshot_checksum
+                                                            : Crc32c::of(std::string_view(snapshot).substr(offset)));
+            }
+            ranges.emplace_back(offset, snapshot.size() - offset);
+        }
+        snapshot += "]}";
+        previous.close();
+
+        auto header = std::format("{{\"checkpoint\":{},\"catalog\":[", checkpoint + 1);
+        for (size_t i = 0; i < graphs.size(); ++i) {
+            header += std::format("{}{{\"name\":\"{}\",\"offset\":{},\"length\":{},\"crc\":{}}}",
+                                  i == 0 ? "" : ",", graphs[i].name, ranges[i].first, ranges[i].second, checksums[i]);
+        }
+        header += "],";
+        // Covers the header up to here, the graphs have their own checksums in the catalog.
+        header += std::format("\"checksum\":{},\"graphs\":[", Crc32c::of(header));
+
+        // Written next to the snapshot and renamed over it, so a failed write never leaves half a file. Both
+        // are synced before the log is reset: the reset must not reach the disk without the snapshot.
+        const auto temporary_path = std::string(snapshot_path) + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open file for writing");
+            }
+            file << header << snapshot;
+            if (!file.flush()) {
+                throw std::runtime_error("Failed to write snapshot");
+            }
+        }
+        FileSync::file(temporary_path);
+        std::filesystem::rename(temporary_path, snapshot_path);
+        FileSync::directory_of(std::string(snapshot_path));
+        // The offsets set below point into the new file.
+        snapshot_file = std::ifstream(snapshot_path, std::ios::binary);
+        // Statements logged so far are part of the snapshot now. A crash before the reset is harmless,
+        // the old log names the previous checkpoint and is ignored on startup.
+        checkpoint += 1;
+        mutation_log.reset(checkpoint);
+
+        for (size_t i = 0; i < graphs.size(); ++i) {
+            graphs[i].snapshot_offset = header.size() + ranges[i].first;
+            graphs[i].snapshot_length = ranges[i].second;
+            graphs[i].snapshot_checksum = checksums[i];
+            graphs[i].dirty = false;
+            // No snapshot references replaced edge stores anymore.
+            for (const auto &path: graphs[i].retired_edge_stores) {
+                std::error_code error;
+                std::filesystem::remove(path, error);
+            }
+            graphs[i].retired_edge_stores.clear();
+        }
+        catalog_dirty = false;
+        unsynchronized_queries_count = 0;
+        Metrics::record_sync(std::chrono::steady_clock::now() - started);
+        logger.info(std::format("Snapshot written, {} of {} graph(s) serialized", serialized, graphs.size()));
+    } catch (const std::exception &e) {
+        throw std::runtime_error(std::format("Error:{}", e.what()));
+    }
+}
+
+auto Database::synchronize() -> void {
+    // The snapshot belongs to the primary, a replica only reads it.
+    if (config.replica || !has_unsynchronized_changes()) {
+        return;
+    }
+    try {
+        sync_with_storage();
+        this->unsynchronized_queries_count = 0;
+        logger.info("Database synchronized successfully");
+        // Graphs that were dirty can be evicted now that the snapshot holds them.
+        enforce_memory_budget();
+    } catch (const std::runtime_error &e) {
+        std::cerr << std::format("Failed to synchronize storage. Error: {}", e.what());
+    }
+}
+
+Database::~Database() {
+    if (transaction) {
+        logger.warning(std::format("Rolling back open transaction with {} statement(s)", transaction->size()));
+    }
+    if (!config.replica && has_unsynchronized_changes()) {
+        logger.info("Attempting to synchronize database before closing");
+        synchronize();
+    }
+    if (config.metrics_path) {
+        write_metrics();
+    }
+}
+
+auto Database::graph_gauges() const -> std::vector<Metrics::GraphGauges> {
+    auto gauges = std::vector<Metrics::GraphGauges>{};
+    for (const auto &graph: graphs) {
+        if (graph.resident) {
+            gauges.push_back({graph.name, true, graph.live_node_count(), graph.live_edge_count(),
+                              graph.memory_usage(), graph.edge_store ? graph.edge_store->size_bytes() : 0});
+        } else {
+            gauges.push_back({graph.name, false});
+        }
+    }
+    return gauges;
+}
+
+auto Database::write_metrics() -> void {
+    metrics_written_at = std::chrono::steady_clock::now();
+    const auto temporary_path = *config.metrics_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file << Metrics::to_prometheus(Metrics::snapshot(), graph_gauges());
+        if (!file.flush()) {
+            std::cerr << std::format("Failed to write metrics to {}", *config.metrics_path) << std::endl;
+            return;
+        }
+    }
+    // Renamed into place so a scraper never reads a partial file.
+    std::error_code error;
+    std::filesystem::rename(temporary_path, *config.metrics_path, error);
+    if (error) {
+        std::cerr << std::format("Failed to write metrics to {}: {}", *config.metrics_path, error.message())
+                << std::endl;
+    }
+}
+
+auto Database::print_stats() const -> void {
+    constexpr auto microseconds = [](const uint64_t nanoseconds) {
+        return static_cast<double>(nanoseconds) / 1e3;
+    };
+    const auto snapshot = Metrics::snapshot();
+
+    fmt::println("{:<24} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}", "Command", "Count", "Parse p50", "p50", "p90",
+                 "p99", "Max");
+    for (const auto &opcode: snapshot.opcodes) {
+        if (opcode.execute.count == 0) {
+            continue;
+        }
+        fmt::println("{:<24} {:>10} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}", opcode.name,
+                     opcode.execute.count, microseconds(opcode.parse.percentile(0.5)),
+                     microseconds(opcode.execute.percentile(0.5)), microseconds(opcode.execute.percentile(0.9)),
+                     microseconds(opcode.execute.percentile(0.99)), microseconds(opcode.execute.max));
+    }
+    fmt::println("Latencies in microseconds.");
+    if (snapshot.sync.count > 0) {
+        fmt::println("Snapshot writes: {}, p50 {:.1f} ms, p99 {:.1f} ms, max {:.1f} ms", snapshot.sync.count,
+                     microseconds(snapshot.sync.percentile(0.5)) / 1e3,
+                     microseconds(snapshot.sync.percentile(0.99)) / 1e3, microseconds(snapshot.sync.max) / 1e3);
+    }
+    for (const auto &gauges: graph_gauges()) {
+        if (!gauges.resident) {
+            fmt::println("Graph {}: not loaded", gauges.name);
+            continue;
+        }
+        fmt::println("Graph {}: {} node(s), {} edge(s), ~{:.1f} MiB{}", gauges.name, gauges.nodes, gauges.edges,
+                     static_cast<double>(gauges.memory_bytes) / (1024.0 * 1024.0),
+                     gauges.mapped_bytes == 0
+                         ? std::string{}
+                         : std::format(", {:.1f} MiB mapped",
+                                       static_cast<double>(gauges.mapped_bytes) / (1024.0 * 1024.0)));
+    }
+    if (config.memory_budget > 0) {
+        fmt::println("Memory budget: {:.1f} MiB", static_cast<double>(config.memory_budget) / (1024.0 * 1024.0));
+    }
+    if (config.replica) {
+        // Measured against the log as it is now, records may have arrived since the last catch-up.
+        std::error_code error;
+        const auto log_size = static_cast<size_t>(std::filesystem::file_size(log_path, error));
+        const auto since = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - caught_up_at);
+        fmt::println("Replica at checkpoint {}: {} record(s) applied, {} log byte(s) behind, caught up {:.0f} ms ago",
+                     checkpoint, replicated_records, error || log_size < log_offset ? 0 : log_size - log_offset,
+                     since.count());
+    }
+}
+
+auto Database::create_index(const std::string &kind, const std::string &field) const -> void {
     if (this->current_graph == nullptr) {
-        // TODO: replace all std:cerr with logger.error
-        std::cerr << "To execute queries first specify graph with USE command" << std::endl;
+        report_error("To execute queries first specify graph with USE command");
         return;
     }
-    logger.info(std::format("Adding edge from {} to {}", edge.from, edge.to));
-    this->current_graph->edges.emplace_back(edge);
-}
+    auto &graph = *this->current_graph;
+    auto created = false;
+    if (kind == "ORDERED") {
+        created = graph.create_ordered_index(field);
+    } else if (kind == "NGRAM") {
+        created = graph.create_ngram_index(field);
+    } else if (kind == "BITMAP") {
+        created = graph.create_bitmap_index(field);
+    } else {
+        report_error(std::format("Unsupported index kind {}", kind));
+        return;
+    }
+    if (!created) {
+        report_error(std::format("Index on field {} already exists", field));
+        return;
+    }
+    logger.info(std::format("Created {} index on field {} in the graph with name {}", kind, field,
+                            this->current_graph->name));
+}
+
+auto Database::set_storage(const bool mapped) const -> void {
+    if (this->current_graph == nullptr) {
+        report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    auto &graph = *this->current_graph;
+    if (mapped == static_cast<bool>(graph.edge_store)) {
+        logger.info(std::format("Graph {} already uses {} storage", graph.name, mapped ? "mapped" : "memory"));
+        return;
+    }
+    if (mapped) {
+        graph.merge_edges();
+        logger.info(std::format("Graph {} now keeps its edges in {}", graph.name, graph.edge_store->path()));
+    } else {
+        graph.unmap_edges();
+        logger.info(std::format("Graph {} now keeps its edges in memory", graph.name));
+    }
+}
+
+auto Database::reorder_graph(const std::string &strategy) const -> void {
+    if (this->current_graph == nullptr) {
+        report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    auto &graph = *this->current_graph;
+    // Removed slots would be placed like live ones.
+    if (graph.removed_nodes_count > 0) {
+        graph.compact();
+    }
+    const auto order = Reordering::order(graph.adjacency(Direction::Both), *Reordering::parse(strategy));
+    graph.reorder(order);
+    logger.info(std::format("Reordered {} node(s) of graph {} in {} order", order.size(), graph.name, strategy));
+}
+
+auto Database::record_for(std::vector<std::string> statements) const -> LogRecord {
+    return {current_graph == nullptr ? std::string{} : current_graph->name, current_id, std::move(statements)};
+}
+
+auto Database::handle_transaction(const std::string &keyword) -> void {
+    if (keyword == "BEGIN") {
+        if (transaction) {
+            report_error("A transaction is already in progress");
+            return;
+        }
+        transaction.emplace();
+        logger.info("Transaction started");
+        return;
+    }
+    if (!transaction) {
+        report_error(std::format("{} without BEGIN", keyword));
+        return;
+    }
+
+    auto queries = std::move(*transaction);
+    transaction.reset();
+    if (keyword == "ROLLBACK") {
+        logger.info(std::format("Transaction rolled back, {} statement(s) discarded", queries.size()));
+        return;
+    }
+    if (queries.empty()) {
+        return;
+    }
+
+    // The record is taken before applying, since replay starts from the ids the transaction started from.
+    const auto record = record_for(queries | rg::views::transform(&Query::get_text)
+                                   | rg::to<std::vector<std::string> >());
+
+    // Statements are applied before the record is appended, while the graph they change records how to
+    // reverse every change, so a failing statement or a record that can not be written leaves nothing
+    // applied. USE, SET STORAGE and REORDER GRAPH are refused inside a transaction, so only the current
+    // graph and new graphs change. Compaction and edge merges only run after the commit.
+    const auto graph_count = graphs.size();
+    const auto position = current_graph == nullptr ? std::optional<size_t>{}
+                                                   : std::optional<size_t>(current_graph - graphs.data());
+    const auto saved_dirty = current_graph != nullptr && current_graph->dirty;
+    const auto saved_id = current_id;
+    const auto saved_catalog_dirty = catalog_dirty;
+    if (current_graph != nullptr) {
+        current_graph->changes.emplace();
+    }
+    const auto undo = [&] {
+        graphs.erase(graphs.begin() + static_cast<std::ptrdiff_t>(graph_count), graphs.end());
+        current_graph = position ? &graphs[*position] : nullptr;
+        if (current_graph != nullptr) {
+            current_graph->undo_changes();
+            current_graph->dirty = saved_dirty;
+        }
+        current_id = saved_id;
+        catalog_dirty = saved_catalog_dirty;
+    };
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        try {
+            queries[i].handle(*this);
+        } catch (const std::exception &e) {
+            report_error(e.what());
+        }
+        if (statement_failed) {
+            undo();
+            report_error(std::format("Transaction aborted, statement {} failed: {}. No statement was applied",
+                                     i + 1, queries[i].get_text()));
+            return;
+        }
+    }
 
-Database::Database(const DatabaseConfig config) : config(config) {
+    // One log record and one fsync for the whole transaction. Replay applies a record entirely
+    // or, if it was torn by a crash, not at all.
     try {
-        if (std::ifstream file("database_snapshot.json"); file.is_open()) {
-            std::ostringstream buffer;
-            buffer << file.rdbuf();
-            std::string json = buffer.str();
-
-            // TODO: remove all spaces except those inside strings
-            this->graphs = std::move(Deserialization::parse_graphs(json));
-            // cout with logger too
-            std::cout << "Database successfully restored from file." << std::endl;
-        } else {
-            std::cerr << "No snapshot file found. Starting with an empty database." << std::endl;
-        }
-    } catch (const std::exception &e) {
-        std::cerr << "Error during database restoration: " << e.what() << std::endl;
-        std::cerr << "Starting with an empty database." << std::endl;
+        mutation_log.append(record, true);
+    } catch (const std::runtime_error &e) {
+        undo();
+        report_error(std::format("Transaction aborted, failed to write mutation log: {}", e.what()));
+        return;
     }
+    if (current_graph != nullptr) {
+        current_graph->changes.reset();
+    }
+    logger.info(std::format("Transaction committed, {} statement(s) applied", queries.size()));
+    after_mutations(static_cast<int>(queries.size()));
 }
 
-auto Database::get_graph() const -> Graph & {
-    return *this->current_graph;
+auto Database::execute_query(const Query &query) -> bool {
+    // PROFILE runs its statement through here too, so a failure inside it fails the PROFILE.
+    const auto outer_failed = std::exchange(statement_failed, false);
+    const auto started = std::chrono::steady_clock::now();
+    execute_statement(query);
+    const auto finished = std::chrono::steady_clock::now();
+    Metrics::record(Metrics::opcode_of(query.get_commands().front().keyword), Metrics::Phase::Execute,
+                    finished - started);
+
+    if (config.metrics_path && finished - metrics_written_at >= config.metrics_interval) {
+        write_metrics();
+    }
+    const auto failed = statement_failed;
+    statement_failed = outer_failed || failed;
+    return !failed;
 }
 
-auto Database::get_graphs() -> std::vector<Graph> & {
-    return this->graphs;
+auto Database::report_error(const std::string &message) const -> void {
+    std::cerr << message << std::endl;
+    statement_failed = true;
 }
 
-auto Database::add_graph(Graph &graph) -> void {
-    auto const graph_already_exists = std::ranges::find_if(this->graphs, [&graph](const Graph &g) {
-        return g.name == graph.name;
-    }) != this->graphs.end();
-    if (graph_already_exists) {
-        std::cerr << "Graph " << graph.name << " already exists." << std::endl;
-    } else {
-        logger.info(std::format("Created new graph with name {}", graph.name));
-        this->graphs.push_back(graph);
+auto Database::execute_statement(const Query &query) -> void {
+    const auto &keyword = query.get_commands().front().keyword;
+    if (config.replica) {
+        follow_log();
+        if (query.is_mutation() || keyword == "BEGIN" || keyword == "COMMIT" || keyword == "ROLLBACK") {
+            report_error(std::format("This is a read replica, run {} on the primary", keyword));
+            return;
+        }
+    }
+    if (keyword == "BEGIN" || keyword == "COMMIT" || keyword == "ROLLBACK") {
+        return handle_transaction(keyword);
     }
-}
 
-auto Database::sync_with_storage() -> void {
-    try {
-        std::ofstream file("database_snapshot.json");
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file for writing");
+    if (transaction) {
+        if (keyword == "USE") {
+            report_error("USE is not allowed inside a transaction");
+            return;
+        }
+        // Both may rewrite the edge store on disk, which a failed COMMIT could not take back.
+        if (keyword == "SET STORAGE" || keyword == "REORDER GRAPH") {
+            report_error(std::format("{} is not allowed inside a transaction", keyword));
+            return;
+        }
+        // Reads inside a transaction see the committed state only.
+        if (query.is_mutation()) {
+            transaction->push_back(query);
+            return;
         }
-
-        file << Serialization::serialize_database(*this);
-        unsynchronized_queries_count = 0;
-    } catch (const std::exception &e) {
-        throw std::runtime_error(std::format("Error:{}", e.what()));
     }
-}
 
-Database::~Database() {
-    logger.info("Attempting to synchronize database before closing");
+    // Reads are neither logged nor counted towards a sync, so a read-only workload does not touch the disk.
+    if (!query.is_mutation()) {
+        query.handle(*this);
+        return;
+    }
+    // The record is taken before the statement runs, which may change the ids replay has to start from, and
+    // only appended once it succeeded, so replay never repeats a failure.
+    const auto record = record_for({query.get_text()});
+    query.handle(*this);
+    if (statement_failed) {
+        return;
+    }
     try {
-        sync_with_storage();
-        this->unsynchronized_queries_count = 0;
-        logger.info("Database synchronized successfully");
+        mutation_log.append(record, false);
     } catch (const std::runtime_error &e) {
-        std::cerr << std::format("Failed to synchronize storage. Error: {}", e.what());
+        report_error(std::format("Failed to write mutation log, the statement is applied but only the next "
+                                 "snapshot will hold it: {}", e.what()));
     }
+    after_mutations(1);
 }
 
-auto Database::execute_query(const Query &query) -> void {
-    query.handle(*this);
+auto Database::after_mutations(const int count) -> void {
+    if (this->current_graph != nullptr &&
+        this->current_graph->tombstone_ratio() >= this->config.compaction_threshold &&
+        this->current_graph->removed_nodes_count + this->current_graph->removed_edges_count > 0) {
+        logger.info(std::format("Compacting graph with name {}", this->current_graph->name));
+        this->current_graph->compact();
+    }
+    // Edges added to a mapped graph are merged into its store once the delta reaches the limit or an
+    // eighth of the store, which keeps merges amortized as the store grows.
+    if (this->current_graph != nullptr && this->current_graph->edge_store &&
+        this->current_graph->edges.delta_size() >=
+        std::max(this->config.edge_delta_limit, this->current_graph->edges.base_size() / 8)) {
+        logger.info(std::format("Merging edges of graph {} into its edge store", this->current_graph->name));
+        this->current_graph->merge_edges();
+    }
 
-    this->unsynchronized_queries_count += 1;
+    this->unsynchronized_queries_count += count;
     if (this->unsynchronized_queries_count >= this->config.unsynced_queries_limit) {
-        try {
-            sync_with_storage();
-            this->unsynchronized_queries_count = 0;
-            logger.info("Database synchronized successfully");
-        } catch (const std::runtime_error &e) {
-            std::cerr << std::format("Failed to synchronize storage. Error: {}", e.what());
-        }
+        synchronize();
     }
 }
 
 Query::Query(std::vector<Command> commands) : commands(std::move(commands)) {
 }
 
+auto Query::from_string(const std::string &query) -> std::optional<Query> {
+    const auto started = std::chrono::steady_clock::now();
+    auto parsed = std::optional<Query>{};
+    if (query == "BEGIN" || query == "COMMIT" || query == "ROLLBACK" || query == "STATS") {
+        parsed = Query({Command(query, "")});
+    } else if (query.starts_with("MATCH ")) {
+        parsed = Query({Command("MATCH", query.substr(6))});
+    } else if (query.starts_with("EXPLAIN ") || query.starts_with("PROFILE ")) {
+        // The wrapped statement is parsed again when it is explained or profiled.
+        const auto separator = query.find(' ');
+        parsed = Query({Command(query.substr(0, separator), query.substr(separator + 1))});
+    } else {
+        parsed = parse(query);
+    }
+    if (parsed) {
+        parsed->text = query;
+    }
+    Metrics::record(Metrics::opcode_of(parsed ? std::string_view(parsed->commands.front().keyword) : "OTHER"),
+                    Metrics::Phase::Parse, std::chrono::steady_clock::now() - started);
+    return parsed;
+}
+
 // !IMPORTANT!
 // Please don't read this function if you do not want yours eyes to bleed.
-auto Query::from_string(const std::string &query) -> std::optional<Query> {
+auto Query::parse(const std::string &query) -> std::optional<Query> {
     const auto words = query | std::views::split(' ') | std::ranges::to<std::vector<std::string> >();
 
     if (words.size() < 2) {
         throw std::invalid_argument("Query can not be empty");
     }
 
+    if (words[0] == "SELECT" && words[1] != "NODE") {
+        return parse_aggregate_query(words);
+    }
+
     std::vector<Command> commands{};
     if (words.size() == 2) {
         if (words[0] == "USE") {
             commands.emplace_back(words[0], words[1]);
             return Query(std::move(commands));
         }
-        std::cerr << "Only USE command can have a single argument";
+        if (words[0] == "ANALYZE") {
+            commands.emplace_back("ANALYZE", words[1]);
+            return Query(std::move(commands));
+        }
+        if (words[0] == "REORDER" && words[1] == "GRAPH") {
+            commands.emplace_back("REORDER GRAPH", "BFS");
+            return Query(std::move(commands));
+        }
+        std::cerr << "Only USE, ANALYZE and REORDER GRAPH commands can have a single argument";
         return std::nullopt;
     }
 
@@ -160,8 +1713,9 @@ auto Query::from_string(const std::string &query) -> std::optional<Query> {
         return Query(std::move(commands));
     }
 
-    if (words.size() == 6 && words[0] == "IS" && words[2] == "CONNECTED" && words[3] == "TO" && words[4] ==
-        "DIRECTLY") {
+    // The documented form is IS a CONNECTED DIRECTLY TO b, the swapped one is kept for old scripts.
+    if (words.size() == 6 && words[0] == "IS" && words[2] == "CONNECTED" &&
+        ((words[3] == "DIRECTLY" && words[4] == "TO") || (words[3] == "TO" && words[4] == "DIRECTLY"))) {
         commands.emplace_back("IS CONNECTED DIRECTLY", words[1] + " " + words[5]);
         return Query(std::move(commands));
     }
@@ -196,7 +1750,29 @@ auto Query::from_string(const std::string &query) -> std::optional<Query> {
             }
             throw std::invalid_argument("SELECT command support only NODE");
         }
-        throw std::invalid_argument("Only CREATE, UPDATE, SELECT can consist of two arguments");
+        if (words[0] == "DELETE") {
+            if (words[1] == "NODE") {
+                commands.emplace_back("DELETE NODE", words[2]);
+                return Query(std::move(commands));
+            }
+            throw std::invalid_argument("DELETE command with single argument support only NODE");
+        }
+        if (words[0] == "SET") {
+            if (words[1] == "STORAGE" && (words[2] == "MAPPED" || words[2] == "MEMORY")) {
+                commands.emplace_back("SET STORAGE", words[2]);
+                return Query(std::move(commands));
+            }
+            throw std::invalid_argument("SET command support only STORAGE MAPPED or STORAGE MEMORY");
+        }
+        if (words[0] == "REORDER") {
+            if (words[1] == "GRAPH" && Reordering::parse(words[2])) {
+                commands.emplace_back("REORDER GRAPH", words[2]);
+                return Query(std::move(commands));
+            }
+            throw std::invalid_argument("REORDER command support only GRAPH BFS, GRAPH DEGREE or GRAPH RCM");
+        }
+        throw std::invalid_argument(
+            "Only CREATE, UPDATE, SELECT, DELETE, SET, REORDER can consist of two arguments");
     }
 
     if (words.size() >= 4) {
@@ -205,9 +1781,20 @@ auto Query::from_string(const std::string &query) -> std::optional<Query> {
             commands.emplace_back("INSERT NODE COMPLEX", Utils::minify_json(rest));
             return Query(std::move(commands));
         }
-        if (words.size() == 6 && words[0] == "INSERT" && words[1] == "EDGE" && words[2] == "FROM" && words[4] == "TO") {
+        if ((words.size() == 6 || words.size() == 8) && words[0] == "INSERT" && words[1] == "EDGE" &&
+            words[2] == "FROM" && words[4] == "TO") {
+            if (words.size() == 8 && words[6] != "WEIGHT") {
+                throw std::invalid_argument("INSERT EDGE FROM TO can only be followed by WEIGHT");
+            }
             auto val = words[3] + " " + words[5];
             commands.emplace_back("INSERT EDGE FROM TO", val);
+            if (words.size() == 8) {
+                commands.emplace_back("WEIGHT", words[7]);
+            }
+            return Query(std::move(commands));
+        }
+        if (words.size() == 6 && words[0] == "DELETE" && words[1] == "EDGE" && words[2] == "FROM" && words[4] == "TO") {
+            commands.emplace_back("DELETE EDGE FROM TO", words[3] + " " + words[5]);
             return Query(std::move(commands));
         }
         if (words.size() == 5 && words[0] == "UPDATE" && words[1] == "NODE" && words[3] == "TO") {
@@ -223,18 +1810,64 @@ auto Query::from_string(const std::string &query) -> std::optional<Query> {
         }
 
 
-        std::ostringstream conditions_stream;
-        for (size_t i = 3; i < words.size(); ++i) {
-            if (words[i] == "AND" || words[i] == "OR" || words[i].starts_with("\"")) {
-                conditions_stream << words[i] << " ";
-            } else if (words[i] == "EQ" || words[i] == "NEQ") {
-                conditions_stream << words[i] << " ";
+        if (words.size() == 4 && words[0] == "ANALYZE" && words[2] == "INTO") {
+            auto field = std::string{};
+            std::istringstream(words[3]) >> std::quoted(field);
+            commands.emplace_back("ANALYZE", words[1]);
+            commands.emplace_back("INTO", field);
+            return Query(std::move(commands));
+        }
+        if ((words.size() == 5 || words.size() == 6) && words[0] == "NEIGHBORS" && words[1] == "OF" &&
+            words[3] == "WITHIN") {
+            if (words.size() == 6 && words[5] != "DIRECTED") {
+                throw std::invalid_argument("NEIGHBORS OF can only be followed by DIRECTED");
+            }
+            commands.emplace_back(words.size() == 6 ? "NEIGHBORS DIRECTED" : "NEIGHBORS", words[2] + " " + words[4]);
+            return Query(std::move(commands));
+        }
+        if ((words.size() == 6 || words.size() == 7) && words[0] == "WEIGHTED" && words[1] == "PATH" &&
+            words[2] == "FROM" && words[4] == "TO") {
+            if (words.size() == 7 && words[6] != "DIRECTED") {
+                throw std::invalid_argument("WEIGHTED PATH can only be followed by DIRECTED");
+            }
+            commands.emplace_back(words.size() == 7 ? "WEIGHTED PATH DIRECTED" : "WEIGHTED PATH",
+                                  words[3] + " " + words[5]);
+            return Query(std::move(commands));
+        }
+        if (words.size() == 5 && words[0] == "CREATE" && words[2] == "INDEX" && words[3] == "ON") {
+            auto field = std::string{};
+            std::istringstream(words[4]) >> std::quoted(field);
+            commands.emplace_back("CREATE INDEX", words[1] + " " + field);
+            return Query(std::move(commands));
+        }
+
+        if (words[0] != "SELECT" || words[1] != "NODE" || words[2] != "WHERE") {
+            throw std::invalid_argument("Unknown query");
+        }
+
+        // Trailing LIMIT, OFFSET and FORMAT clauses become additional commands of the query.
+        auto conditions_end = words.size();
+        std::vector<Command> modifiers{};
+        while (conditions_end >= 6) {
+            const auto &keyword = words[conditions_end - 2];
+            const auto &argument = words[conditions_end - 1];
+            if (keyword == "LIMIT" || keyword == "OFFSET") {
+                if (std::stoi(argument) < 0) {
+                    throw std::invalid_argument(std::format("{} can not be negative", keyword));
+                }
+            } else if (keyword == "FORMAT") {
+                if (!parse_output_format(argument).has_value()) {
+                    throw std::invalid_argument("FORMAT supports only TEXT, JSONL and BINARY");
+                }
             } else {
-                throw std::invalid_argument("Unexpected token in SELECT NODE WHERE query");
+                break;
             }
+            modifiers.emplace_back(keyword, argument);
+            conditions_end -= 2;
         }
 
-        commands.emplace_back("SELECT NODE WHERE", Utils::trim(conditions_stream.str()));
+        commands.emplace_back("SELECT NODE WHERE", join_condition_words(words, 3, conditions_end));
+        commands.insert(commands.end(), modifiers.rbegin(), modifiers.rend());
         return Query(std::move(commands));
     }
 
@@ -242,6 +1875,72 @@ auto Query::from_string(const std::string &query) -> std::optional<Query> {
     return Query(std::move(commands));
 }
 
+auto Query::join_condition_words(const std::vector<std::string> &words, const size_t begin,
+                                 const size_t end) -> std::string {
+    std::ostringstream conditions_stream;
+    auto in_literal = false;
+    for (size_t i = begin; i < end; ++i) {
+        // A quoted literal split at its spaces continues up to the word closing the quote.
+        if (in_literal) {
+            conditions_stream << words[i] << " ";
+            in_literal = !words[i].ends_with('"');
+            continue;
+        }
+        // STARTS WITH is the only comparator spanning two words.
+        const auto starts_with = (words[i] == "STARTS" && i + 1 < end && words[i + 1] == "WITH") ||
+                                 (words[i] == "WITH" && i > begin && words[i - 1] == "STARTS");
+        const auto follows_comparator = i > begin && (Comparator::is_valid(words[i - 1]) ||
+                                                      (words[i - 1] == "WITH" && i >= begin + 2 &&
+                                                       words[i - 2] == "STARTS") ||
+                                                      (i >= begin + 3 && words[i - 1] == "AND" &&
+                                                       words[i - 3] == "BETWEEN"));
+        if (LogicalOperator::is_valid(words[i]) || Comparator::is_valid(words[i]) || starts_with ||
+            words[i].starts_with("\"") || follows_comparator) {
+            conditions_stream << words[i] << " ";
+            in_literal = words[i].starts_with('"') && (words[i].size() == 1 || !words[i].ends_with('"'));
+        } else {
+            throw std::invalid_argument("Unexpected token in WHERE clause");
+        }
+    }
+    return Utils::trim(conditions_stream.str());
+}
+
+// SELECT [aggregate, ...] [WHERE conditions] [GROUP BY field]
+auto Query::parse_aggregate_query(const std::vector<std::string> &words) -> Query {
+    std::vector<Command> commands{};
+
+    size_t position = 1;
+    std::string aggregates;
+    for (; position < words.size() && words[position] != "WHERE" && words[position] != "GROUP"; ++position) {
+        for (const auto token: words[position] | std::views::split(',')) {
+            if (const auto aggregate = std::string_view(token); !aggregate.empty()) {
+                Aggregate::parse(aggregate);
+                aggregates += aggregates.empty() ? "" : " ";
+                aggregates += aggregate;
+            }
+        }
+    }
+    if (aggregates.empty()) {
+        throw std::invalid_argument("SELECT requires NODE or at least one aggregate");
+    }
+    commands.emplace_back("SELECT AGGREGATE", aggregates);
+
+    const auto group_at = std::ranges::find(words.begin() + static_cast<std::ptrdiff_t>(position), words.end(),
+                                            "GROUP") - words.begin();
+    if (position < words.size() && words[position] == "WHERE") {
+        commands.emplace_back("WHERE", join_condition_words(words, position + 1, group_at));
+    }
+    if (static_cast<size_t>(group_at) < words.size()) {
+        if (static_cast<size_t>(group_at) + 3 != words.size() || words[group_at + 1] != "BY") {
+            throw std::invalid_argument("GROUP BY expects a single field");
+        }
+        auto field = std::string{};
+        std::istringstream(words[group_at + 2]) >> std::quoted(field);
+        commands.emplace_back("GROUP BY", field);
+    }
+    return Query(std::move(commands));
+}
+
 auto Query::handle_use(Database &db) const -> void {
     logger.debug("USE started");
     auto &graphs = db.get_graphs();
@@ -251,77 +1950,740 @@ auto Query::handle_use(Database &db) const -> void {
         throw std::runtime_error("Query has no commands.");
     }
 
-    const auto &command_value = this->get_commands().front().value;
-    logger.debug(std::format("Searching for graph with name: {}", command_value));
+    const auto &command_value = this->get_commands().front().value;
+    logger.debug(std::format("Searching for graph with name: {}", command_value));
+
+    const auto it = std::ranges::find_if(graphs, [&command_value](const auto &graph) {
+        return graph.name == command_value;
+    });
+
+    if (it != graphs.end()) {
+        logger.debug(std::format("Graph found: {}", it->name));
+        try {
+            db.set_graph(*it);
+        } catch (const std::runtime_error &e) {
+            db.report_error(std::format("Failed to load graph {}: {}", it->name, e.what()));
+            return;
+        }
+        // Ids of deleted nodes must not be handed out again, so continue from the highest one.
+        db.current_id = it->last_node_id;
+    } else {
+        logger.error("Graph not found.");
+        db.report_error("Graph not found. If you want to create it, use CREATE GRAPH command");
+    }
+}
+
+static const auto logger_for_matches = Logger("Planner");
+
+static auto index_can_answer(const Condition &condition) -> bool {
+    // Substrings are spread over the whole order, only the n-gram index finds them.
+    return condition.comparator.kind != Comparator::Kind::NEQ && condition.comparator.kind != Comparator::Kind::CONTAINS;
+}
+
+// Entries an EQ condition accepts, under both keys of a quoted literal that spells a typed value.
+static auto count_equal(const OrderedIndex &index, const Condition &condition) -> size_t {
+    return index.count_equal(condition.value) + (condition.spelled ? index.count_equal(*condition.spelled) : 0);
+}
+
+static auto ordered_index_can_answer(const Graph &graph, const Condition &condition) -> bool {
+    return graph.ordered_indexes.contains(condition.field) && index_can_answer(condition);
+}
+
+// Patterns shorter than a trigram have no posting list to narrow them.
+static auto ngram_index_can_answer(const Graph &graph, const Condition &condition) -> bool {
+    return condition.comparator.is_text() && graph.ngram_indexes.contains(condition.field) &&
+           NgramIndex::can_answer(condition.value.toString());
+}
+
+// Share of live nodes satisfying the condition. Equality on an ordered index and anything on a bitmap
+// index are counted exactly, every other condition is estimated from the field statistics: the share
+// of nodes holding the field times the share of sampled values the comparator accepts. A value the
+// sample missed is taken to be as frequent as an average distinct value.
+static auto selectivity(const Graph &graph, const Condition &condition) -> double {
+    const auto live = static_cast<double>(graph.live_node_count());
+    if (live == 0) {
+        return 0;
+    }
+    const auto ordered = graph.ordered_indexes.find(condition.field);
+    if (condition.comparator.kind == Comparator::Kind::EQ && ordered != graph.ordered_indexes.end() &&
+        index_can_answer(condition)) {
+        return static_cast<double>(count_equal(ordered->second, condition)) / live;
+    }
+    if (const auto bitmaps = graph.bitmap_indexes.find(condition.field); bitmaps != graph.bitmap_indexes.end()) {
+        // A node holds one value per field, so the bitmaps of distinct values never overlap.
+        size_t matched = 0;
+        bitmaps->second.for_each_value([&](const BasicValue &value, const Bitmap &slots) {
+            matched += condition.accepts(value) ? slots.cardinality() : 0;
+        });
+        return static_cast<double>(matched) / live;
+    }
+
+    const auto *statistics = graph.statistics_of(condition.field);
+    if (statistics == nullptr || statistics->present_count() == 0) {
+        return 0;
+    }
+    auto share = statistics->sampled_share([&](const BasicValue &value) {
+        return condition.accepts(value);
+    }).value_or(0);
+    if (share == 0) {
+        share = 1 / std::max({1.0, statistics->distinct(), static_cast<double>(statistics->sampled_count())});
+    }
+    return std::min(1.0, static_cast<double>(statistics->present_count()) / live) * share;
+}
+
+// Relative cost of evaluating a condition on one node. Finding the field dominates, text patterns
+// also walk the string.
+static auto evaluation_cost(const Condition &condition) -> double {
+    switch (condition.comparator.kind) {
+        case Comparator::Kind::CONTAINS:
+            return 3;
+        case Comparator::Kind::STARTS_WITH:
+            return 1.5;
+        default:
+            return 1;
+    }
+}
+
+// Conditions and terms of the group reordered to minimize the expected evaluation cost per node,
+// assuming independent conditions. Within a term, a condition of selectivity s and cost c is ranked
+// by c / (1 - s), so cheap conditions that usually fail go first. Terms are ranked by expected cost
+// over selectivity, so cheap terms that usually hold go first. The result matches the same nodes.
+static auto plan_filter(const Graph &graph, const ConditionGroup &group) -> ConditionGroup {
+    constexpr auto never = std::numeric_limits<double>::infinity();
+    struct Ranked {
+        std::vector<Condition> conditions;
+        double rank = 0;
+    };
+    auto terms = std::vector<Ranked>{};
+    for (auto &term: group.terms()) {
+        auto ranked = std::vector<std::pair<double, Condition> >{};
+        for (auto &condition: term) {
+            const auto share = selectivity(graph, condition);
+            ranked.emplace_back(share, std::move(condition));
+        }
+        rg::stable_sort(ranked, {}, [](const auto &entry) {
+            return entry.first < 1 ? evaluation_cost(entry.second) / (1 - entry.first) : never;
+        });
+        auto term_share = 1.0;
+        auto term_cost = 0.0;
+        auto conditions = std::vector<Condition>{};
+        for (auto &[share, condition]: ranked) {
+            term_cost += term_share * evaluation_cost(condition);
+            term_share *= share;
+            conditions.push_back(std::move(condition));
+        }
+        terms.push_back({std::move(conditions), term_share > 0 ? term_cost / term_share : never});
+    }
+    rg::stable_sort(terms, {}, &Ranked::rank);
+    return ConditionGroup::from_terms(terms | std::views::transform(&Ranked::conditions)
+                                      | rg::to<std::vector<std::vector<Condition> > >());
+}
+
+// Share of live nodes above which candidates from an ordered or n-gram index are not worth it: they
+// are sorted and read in slot order, while a scan reads every node sequentially anyway.
+constexpr auto index_scan_share = 0.3;
+
+// Estimated number of node slots an index lookup for the condition yields.
+static auto estimate_candidates(const Graph &graph, const Condition &condition) -> double {
+    if (!ordered_index_can_answer(graph, condition)) {
+        return static_cast<double>(graph.ngram_indexes.at(condition.field).estimate(condition.value.toString()));
+    }
+    return selectivity(graph, condition) * static_cast<double>(graph.live_node_count());
+}
+
+// Condition of the group with the fewest estimated index candidates, regardless of whether scanning
+// would be cheaper. Only conjunctions are narrowed this way: with OR any node may match through
+// another term.
+static auto best_index_condition(const Graph &graph, const ConditionGroup &group) -> const Condition * {
+    if (!group.is_conjunction()) {
+        return nullptr;
+    }
+    const Condition *best = nullptr;
+    auto fewest = std::numeric_limits<double>::infinity();
+    for (const auto &condition: group.conditions) {
+        if (ordered_index_can_answer(graph, condition) || ngram_index_can_answer(graph, condition)) {
+            if (const auto candidates = estimate_candidates(graph, condition); candidates < fewest) {
+                best = &condition;
+                fewest = candidates;
+            }
+        }
+    }
+    return best;
+}
+
+// Condition whose index narrows the scan, nullptr when a full scan is expected to be cheaper.
+static auto choose_index_condition(const Graph &graph, const ConditionGroup &group) -> const Condition * {
+    const auto *condition = best_index_condition(graph, group);
+    if (condition == nullptr ||
+        estimate_candidates(graph, *condition) > index_scan_share * static_cast<double>(graph.live_node_count())) {
+        return nullptr;
+    }
+    return condition;
+}
+
+// Smallest string above every string starting with prefix, nullopt when only the end of the order is.
+static auto prefix_successor(std::string prefix) -> std::optional<std::string> {
+    while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xff) {
+        prefix.pop_back();
+    }
+    if (prefix.empty()) {
+        return std::nullopt;
+    }
+    prefix.back() = static_cast<char>(static_cast<unsigned char>(prefix.back()) + 1);
+    return prefix;
+}
+
+// Slots of nodes that may satisfy the group, found through an index on one of its conditions.
+// Ordered indexes are preferred, the n-gram index only answers text patterns they can not.
+static auto find_index_candidates(const Graph &graph,
+                                  const ConditionGroup &group) -> std::optional<std::vector<size_t> > {
+    const auto *condition = choose_index_condition(graph, group);
+    if (condition == nullptr) {
+        return std::nullopt;
+    }
+    auto timer = QueryProfile::Timer("index lookup");
+
+    if (!ordered_index_can_answer(graph, *condition)) {
+        auto slots = graph.ngram_indexes.at(condition->field).candidates(condition->value.toString());
+        if (auto *profile = QueryProfile::active()) {
+            profile->index_entries += slots.size();
+        }
+        return slots;
+    }
+
+    std::optional<IndexBound> lower;
+    std::optional<IndexBound> upper;
+    switch (condition->comparator.kind) {
+        case Comparator::Kind::EQ:
+            lower = upper = IndexBound{condition->value, true};
+            break;
+        case Comparator::Kind::LT:
+            upper = IndexBound{condition->value, false};
+            break;
+        case Comparator::Kind::LTE:
+            upper = IndexBound{condition->value, true};
+            break;
+        case Comparator::Kind::GT:
+            lower = IndexBound{condition->value, false};
+            break;
+        case Comparator::Kind::GTE:
+            lower = IndexBound{condition->value, true};
+            break;
+        case Comparator::Kind::BETWEEN:
+            lower = IndexBound{condition->value, true};
+            upper = IndexBound{*condition->upper, true};
+            break;
+        case Comparator::Kind::STARTS_WITH:
+            // Strings with the prefix form one run of the order, ending before its successor.
+            lower = IndexBound{condition->value, true};
+            if (auto successor = prefix_successor(condition->value.toString())) {
+                upper = IndexBound{BasicValue(std::move(*successor)), false};
+            }
+            break;
+        case Comparator::Kind::NEQ:
+        case Comparator::Kind::CONTAINS:
+            break;
+    }
+
+    std::vector<size_t> slots;
+    const auto &index = graph.ordered_indexes.at(condition->field);
+    index.for_each_in_range(lower, upper, [&slots](const size_t slot) {
+        slots.push_back(slot);
+    });
+    if (condition->comparator.kind == Comparator::Kind::EQ && condition->spelled) {
+        const auto spelled = IndexBound{*condition->spelled, true};
+        index.for_each_in_range(spelled, spelled, [&slots](const size_t slot) {
+            slots.push_back(slot);
+        });
+    }
+    // Keep the insertion order a full scan would produce.
+    rg::sort(slots);
+    if (auto *profile = QueryProfile::active()) {
+        profile->index_entries += slots.size();
+    }
+    return slots;
+}
+
+// Slots whose field satisfies the condition, the union of the bitmaps of all matching values.
+static auto bitmap_of(const BitmapIndex &index, const Condition &condition) -> Bitmap {
+    auto result = Bitmap{};
+    index.for_each_value([&](const BasicValue &value, const Bitmap &slots) {
+        if (condition.accepts(value)) {
+            result = Bitmap::unite(result, slots);
+        }
+    });
+    return result;
+}
+
+struct BitmapMatches {
+    Bitmap slots;
+    // Set when every condition was answered by a bitmap, so slots are exactly the matches.
+    bool exact = false;
+};
+
+// Evaluates the group on bitmap indexes. When every condition has one, terms are intersected and their
+// results united as in ConditionGroup::matches and no node is read. A conjunction with only some indexed
+// conditions yields candidates that still have to be checked.
+static auto bitmap_matches(const Graph &graph, const ConditionGroup &group) -> std::optional<BitmapMatches> {
+    auto index_of = [&graph](const Condition &condition) -> const BitmapIndex * {
+        const auto it = graph.bitmap_indexes.find(condition.field);
+        return it == graph.bitmap_indexes.end() ? nullptr : &it->second;
+    };
+    const auto indexed = rg::count_if(group.conditions, [&](const Condition &condition) {
+        return index_of(condition) != nullptr;
+    });
+    if (indexed == 0 || (!group.is_conjunction() && static_cast<size_t>(indexed) < group.conditions.size())) {
+        return std::nullopt;
+    }
+    auto timer = QueryProfile::Timer("index lookup");
+
+    if (static_cast<size_t>(indexed) == group.conditions.size()) {
+        auto slots = Bitmap{};
+        for (const auto &term: group.terms()) {
+            auto term_slots = bitmap_of(*index_of(term.front()), term.front());
+            for (const auto &condition: term | std::views::drop(1)) {
+                if (term_slots.empty()) {
+                    break;
+                }
+                term_slots = Bitmap::intersect(term_slots, bitmap_of(*index_of(condition), condition));
+            }
+            slots = Bitmap::unite(slots, term_slots);
+        }
+        return BitmapMatches{std::move(slots), true};
+    }
+    auto slots = std::optional<Bitmap>{};
+    for (const auto &condition: group.conditions) {
+        if (const auto *index = index_of(condition)) {
+            auto next = bitmap_of(*index, condition);
+            slots = slots ? Bitmap::intersect(*slots, next) : std::move(next);
+        }
+    }
+    return BitmapMatches{std::move(*slots), false};
+}
+
+// Calls consumer for every live node matching the group, until it returns false.
+template<std::predicate<const Node &> Consumer>
+static auto for_each_match(const Graph &graph, const ConditionGroup &group, Consumer consumer) -> void {
+    // Conditions are evaluated in planned order and only until the result is known.
+    auto matches = [filter = plan_filter(graph, group), profile = QueryProfile::active()](const Node &node) {
+        if (profile == nullptr) {
+            return filter.matches(node);
+        }
+        ++profile->rows_examined;
+        return filter.matches(node, profile->conditions_evaluated);
+    };
+
+    if (auto bitmap = bitmap_matches(graph, group)) {
+        logger_for_matches.debug(std::format("Using bitmap {}: {}", bitmap->exact ? "matches" : "candidates",
+                                             bitmap->slots.cardinality()));
+        if (auto *profile = QueryProfile::active()) {
+            profile->index_entries += bitmap->slots.cardinality();
+        }
+        auto timer = QueryProfile::Timer("scan");
+        bitmap->slots.for_each([&](const uint32_t slot) {
+            if (bitmap->exact) {
+                return consumer(graph.nodes[slot]);
+            }
+            return !matches(graph.nodes[slot]) || consumer(graph.nodes[slot]);
+        });
+        return;
+    }
+    if (auto candidates = find_index_candidates(graph, group); candidates.has_value()) {
+        logger_for_matches.debug(std::format("Using index candidates: {}", candidates->size()));
+        auto timer = QueryProfile::Timer("scan");
+        for (const auto slot: *candidates) {
+            if (matches(graph.nodes[slot]) && !consumer(graph.nodes[slot])) {
+                return;
+            }
+        }
+        return;
+    }
+    auto timer = QueryProfile::Timer("scan");
+    graph.for_each_node_where(matches, consumer);
+}
+
+auto Query::handle_select_where(const Database &db) const -> void {
+    logger.debug("SELECT NODE WHERE started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    if (commands.empty()) {
+        logger.error("Query commands are empty.");
+        throw std::runtime_error("Query has no commands.");
+    }
+
+    const auto condition_str = this->commands.front().value;
+
+    try {
+        auto plan_timer = QueryProfile::Timer("plan");
+        auto condition_group = parse_conditions(condition_str);
+        auto &graph = db.get_graph();
+
+        const auto *offset_command = find_command("OFFSET");
+        const auto *limit_command = find_command("LIMIT");
+        const auto *format_command = find_command("FORMAT");
+        const size_t offset = offset_command != nullptr ? std::stoul(offset_command->value) : 0;
+        const size_t limit = limit_command != nullptr
+                                 ? std::stoul(limit_command->value)
+                                 : std::numeric_limits<size_t>::max();
+        const auto format = format_command != nullptr
+                                ? parse_output_format(format_command->value).value()
+                                : OutputFormat::Text;
+
+        // Matches are written to the sink while scanning and the scan stops once LIMIT is reached.
+        const auto sink = ResultSink::create(format);
+        plan_timer.stop();
+        size_t matched = 0;
+        auto emit = [&](const Node &node) {
+            if (matched++ >= offset) {
+                auto timer = QueryProfile::Timer("output");
+                sink->write(node);
+            }
+            return sink->count() < limit;
+        };
+
+        if (limit > 0) {
+            for_each_match(graph, condition_group, emit);
+        }
+        auto output_timer = QueryProfile::Timer("output");
+        sink->finish();
+        if (auto *profile = QueryProfile::active()) {
+            profile->rows_returned = sink->count();
+        }
+    } catch (const std::exception &e) {
+        db.report_error(std::format("Failed to process SELECT query: {}", e.what()));
+    }
+}
+
+// Estimated number of live nodes satisfying the group, all live nodes when there are no conditions.
+// Conditions are assumed independent.
+static auto estimate_matches(const Graph &graph, const std::optional<ConditionGroup> &group) -> double {
+    const auto live = static_cast<double>(graph.live_node_count());
+    if (!group) {
+        return live;
+    }
+    auto none = 1.0;
+    for (const auto &term: group->terms()) {
+        auto term_share = 1.0;
+        for (const auto &condition: term) {
+            term_share *= selectivity(graph, condition);
+        }
+        none *= 1 - term_share;
+    }
+    return live * (1 - none);
+}
+
+static auto reversed(const Direction direction) -> Direction {
+    switch (direction) {
+        case Direction::Outgoing:
+            return Direction::Incoming;
+        case Direction::Incoming:
+            return Direction::Outgoing;
+        default:
+            return Direction::Both;
+    }
+}
+
+// One variable of a MATCH plan. The first step finds its nodes by scan or index, every later one
+// expands a variable bound by an earlier step over the adjacency in the given direction.
+struct MatchStep {
+    size_t variable{};
+    std::optional<size_t> from;
+    Direction direction = Direction::Both;
+    double estimated_rows = 0;
+};
+
+// Orders the pattern variables into a start and a chain of expansions. Every variable is tried as the
+// start and the path always grows towards the neighbour that yields fewer rows; the plan producing
+// the fewest rows over all steps wins, so expansion starts from the most selective predicate.
+static auto plan_match(const Graph &graph, const MatchPattern &pattern) -> std::vector<MatchStep> {
+    const auto live_nodes = std::max(1.0, static_cast<double>(graph.live_node_count()));
+    const auto average_degree = static_cast<double>(graph.live_edge_count()) / live_nodes;
+    const auto estimates = pattern.conditions | std::views::transform([&graph](const auto &group) {
+        return estimate_matches(graph, group);
+    }) | std::ranges::to<std::vector<double> >();
+    const auto count = pattern.variables.size();
+
+    auto best = std::vector<MatchStep>{};
+    auto best_cost = std::numeric_limits<double>::infinity();
+    for (size_t start = 0; start < count; ++start) {
+        auto steps = std::vector{MatchStep{start, std::nullopt, Direction::Both, estimates[start]}};
+        auto rows = estimates[start];
+        auto cost = rows;
+        // The bound variables always form the contiguous range [first, last] of the path.
+        auto first = start;
+        auto last = start;
+        auto expand = [&](const size_t variable, const size_t from, const Direction direction) {
+            const auto degree = direction == Direction::Both ? 2 * average_degree : average_degree;
+            return MatchStep{variable, from, direction, rows * degree * estimates[variable] / live_nodes};
+        };
+        while (last - first + 1 < count) {
+            auto next = std::optional<MatchStep>{};
+            if (first > 0) {
+                next = expand(first - 1, first, reversed(pattern.edges[first - 1]));
+            }
+            if (last + 1 < count) {
+                const auto forward = expand(last + 1, last, pattern.edges[last]);
+                if (!next || forward.estimated_rows < next->estimated_rows) {
+                    next = forward;
+                }
+            }
+            rows = next->estimated_rows;
+            cost += rows;
+            (next->variable < first ? first : last) = next->variable;
+            steps.push_back(*next);
+        }
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = std::move(steps);
+        }
+    }
+    return best;
+}
+
+// Runs the plan as nested iterators: every row of a step is extended by the next step right away, so
+// no intermediate results are kept and a consumer returning false stops the whole pipeline. Every
+// variable binds a distinct node; consumer gets the bound slot of each variable.
+template<typename Consumer>
+static auto run_match(const Graph &graph, const MatchPattern &pattern, const std::vector<MatchStep> &plan,
+                      Consumer consumer) -> void {
+    auto adjacencies = std::vector<const Adjacency *>(plan.size(), nullptr);
+    {
+        auto timer = QueryProfile::Timer("adjacency");
+        for (size_t step = 1; step < plan.size(); ++step) {
+            adjacencies[step] = &graph.adjacency(plan[step].direction);
+        }
+    }
 
-    const auto it = std::ranges::find_if(graphs, [&command_value](const auto &graph) {
-        return graph.name == command_value;
-    });
+    auto *profile = QueryProfile::active();
+    const auto filters = pattern.conditions | std::views::transform([&graph](const auto &group) {
+        return group ? std::optional(plan_filter(graph, *group)) : std::nullopt;
+    }) | rg::to<std::vector<std::optional<ConditionGroup> > >();
+    auto bindings = std::vector<size_t>(pattern.variables.size());
+    auto is_bound = [&](const size_t step, const size_t slot) {
+        return rg::any_of(plan | std::views::take(step), [&](const MatchStep &bound) {
+            return bindings[bound.variable] == slot;
+        });
+    };
+    auto extend = [&](auto &self, const size_t step) -> bool {
+        if (step == plan.size()) {
+            return consumer(std::as_const(bindings));
+        }
+        const auto &[variable, from, direction, estimated_rows] = plan[step];
+        for (const auto neighbor: adjacencies[step]->neighbors(bindings[*from])) {
+            if (profile != nullptr) {
+                ++profile->edges_visited;
+            }
+            if (is_bound(step, neighbor)) {
+                continue;
+            }
+            if (const auto &filter = filters[variable]) {
+                auto matched = false;
+                if (profile != nullptr) {
+                    ++profile->rows_examined;
+                    matched = filter->matches(graph.nodes[neighbor], profile->conditions_evaluated);
+                } else {
+                    matched = filter->matches(graph.nodes[neighbor]);
+                }
+                if (!matched) {
+                    continue;
+                }
+            }
+            if (profile != nullptr) {
+                ++profile->nodes_visited;
+            }
+            bindings[variable] = neighbor;
+            if (!self(self, step + 1)) {
+                return false;
+            }
+        }
+        return true;
+    };
 
-    if (it != graphs.end()) {
-        logger.debug(std::format("Graph found: {}", it->name));
-        db.current_id = static_cast<int>(it->nodes.size());
-        db.set_graph(*it);
+    const auto start = plan.front().variable;
+    auto bind_start = [&](const Node &node) {
+        if (profile != nullptr) {
+            ++profile->nodes_visited;
+        }
+        bindings[start] = static_cast<size_t>(&node - graph.nodes.data());
+        auto timer = QueryProfile::Timer("expand");
+        return extend(extend, 1);
+    };
+    if (const auto &group = pattern.conditions[start]) {
+        for_each_match(graph, *group, bind_start);
     } else {
-        logger.error("Graph not found.");
-        std::cerr << "Graph not found. If you want to create it, use CREATE GRAPH command" << std::endl;
+        auto timer = QueryProfile::Timer("scan");
+        graph.for_each_node_where([profile](const Node &) {
+            if (profile != nullptr) {
+                ++profile->rows_examined;
+            }
+            return true;
+        }, bind_start);
     }
 }
 
-auto Query::handle_select_where(const Database &db) const -> void {
-    logger.debug("SELECT NODE WHERE started");
-    if (commands.empty()) {
-        logger.error("Query commands are empty.");
-        throw std::runtime_error("Query has no commands.");
+auto Query::handle_match(const Database &db) const -> void {
+    logger.debug("MATCH started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
     }
-
-    const auto condition_str = this->commands.front().value;
-
     try {
-        auto condition_group = parse_conditions(condition_str);
+        auto plan_timer = QueryProfile::Timer("plan");
+        const auto pattern = MatchPattern::parse(commands.front().value);
         auto &graph = db.get_graph();
-
-        auto matches_conditions = [&condition_group](const Node &node) {
-            auto evaluate_condition = [&node](const Condition &condition) {
-                if (!std::holds_alternative<UserDefinedValue>(node.data)) {
-                    return false;
+        const auto plan = plan_match(graph, pattern);
+        const auto limit = pattern.limit.value_or(std::numeric_limits<size_t>::max());
+        plan_timer.stop();
+
+        size_t matched = 0;
+        auto emit = [&](const std::vector<size_t> &bindings) {
+            auto timer = QueryProfile::Timer("output");
+            auto line = std::string{};
+            for (size_t variable = 0; variable < bindings.size(); ++variable) {
+                if (variable > 0) {
+                    line += ", ";
                 }
-                const auto &user_data = std::get<UserDefinedValue>(node.data);
-                const auto &fields = user_data.get_data();
-
-                const auto it = std::ranges::find_if(fields, [&condition](const auto &field) {
-                    return field.first == condition.field;
-                });
+                line += pattern.variables[variable];
+                line += ": ";
+                graph.nodes[bindings[variable]].append_to(line);
+            }
+            fmt::println("{}", line);
+            return ++matched < limit;
+        };
+        if (limit > 0) {
+            run_match(graph, pattern, plan, emit);
+        }
+        fmt::println("{} match(es).", matched);
+        if (auto *profile = QueryProfile::active()) {
+            profile->rows_returned = matched;
+        }
+    } catch (const std::exception &e) {
+        db.report_error(std::format("Failed to process MATCH query: {}", e.what()));
+    }
+}
 
-                if (it == fields.end()) return false;
+// COUNT(*) queries that running counters can answer without touching nodes.
+static auto count_from_counters(const Graph &graph, GroupedAggregation &aggregation,
+                                const std::vector<Aggregate> &aggregates,
+                                const std::optional<ConditionGroup> &conditions,
+                                const Command *group_by) -> bool {
+    const auto only_count_all = rg::all_of(aggregates, [](const Aggregate &aggregate) {
+        return aggregate.kind == Aggregate::Kind::Count && aggregate.field.empty();
+    });
+    if (!only_count_all) {
+        return false;
+    }
 
-                const auto &field_value = std::get<BasicValue>(it->second).toString();
-                return condition.comparator.compare(field_value, condition.value);
-            };
+    if (!conditions && group_by == nullptr) {
+        aggregation.add_count(std::nullopt, graph.live_node_count());
+        return true;
+    }
+    if (!conditions) {
+        const auto index = graph.ordered_indexes.find(group_by->value);
+        if (index == graph.ordered_indexes.end()) {
+            return false;
+        }
+        size_t grouped = 0;
+        for (const auto &[value, count]: index->second.value_counts()) {
+            aggregation.add_count(value, count);
+            grouped += count;
+        }
+        if (grouped < graph.live_node_count()) {
+            aggregation.add_count(std::nullopt, graph.live_node_count() - grouped);
+        }
+        return true;
+    }
+    if (group_by == nullptr && conditions->conditions.size() == 1) {
+        const auto &condition = conditions->conditions.front();
+        const auto index = graph.ordered_indexes.find(condition.field);
+        if (index == graph.ordered_indexes.end() || condition.comparator.kind != Comparator::Kind::EQ ||
+            !index_can_answer(condition)) {
+            return false;
+        }
+        aggregation.add_count(std::nullopt, count_equal(index->second, condition));
+        return true;
+    }
 
-            bool result = evaluate_condition(condition_group.conditions.front());
-            for (size_t i = 0; i < condition_group.operators.size(); ++i) {
-                const auto &logical_operator = condition_group.operators[i];
-                const auto &condition = condition_group.conditions[i + 1];
+    // Exact bitmap matches are counted as they are, or per value of a bitmap indexed grouping field.
+    const auto bitmap = bitmap_matches(graph, *conditions);
+    if (!bitmap || !bitmap->exact) {
+        return false;
+    }
+    const auto matched = bitmap->slots.cardinality();
+    if (group_by == nullptr) {
+        aggregation.add_count(std::nullopt, matched);
+        return true;
+    }
+    const auto grouping = graph.bitmap_indexes.find(group_by->value);
+    if (grouping == graph.bitmap_indexes.end()) {
+        return false;
+    }
+    size_t grouped = 0;
+    grouping->second.for_each_value([&](const BasicValue &value, const Bitmap &slots) {
+        if (const auto count = Bitmap::intersect(bitmap->slots, slots).cardinality(); count > 0) {
+            aggregation.add_count(value.data, count);
+            grouped += count;
+        }
+    });
+    if (grouped < matched) {
+        aggregation.add_count(std::nullopt, matched - grouped);
+    }
+    return true;
+}
 
-                result = logical_operator.apply(result, evaluate_condition(condition));
-            }
+auto Query::handle_select_aggregate(const Database &db) const -> void {
+    logger.debug("SELECT AGGREGATE started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    try {
+        auto aggregates = std::vector<Aggregate>{};
+        for (const auto token: this->commands.front().value | std::views::split(' ')) {
+            aggregates.push_back(Aggregate::parse(std::string_view(token)));
+        }
 
-            return result;
-        };
+        auto plan_timer = QueryProfile::Timer("plan");
+        const auto *where = find_command("WHERE");
+        const auto *group_by = find_command("GROUP BY");
+        const auto conditions = where != nullptr
+                                    ? std::optional(parse_conditions(where->value))
+                                    : std::nullopt;
+        auto &graph = db.get_graph();
 
-        auto matching_nodes = graph.find_nodes_where(matches_conditions);
+        auto aggregation = GroupedAggregation(
+            aggregates, group_by != nullptr ? std::optional(group_by->value) : std::nullopt);
 
-        if (matching_nodes.empty()) {
-            std::cout << "No nodes matched the given conditions.\n";
+        plan_timer.stop();
+        if (count_from_counters(graph, aggregation, aggregates, conditions, group_by)) {
+            logger.debug("Aggregate answered from counters");
         } else {
-            std::cout << "Matching nodes:\n";
-            for (const auto &node_ref: matching_nodes) {
-                std::cout << node_ref.get().toString() << "\n";
+            // Single pass, each match is folded into its group right away.
+            auto consume = [&aggregation](const Node &node) {
+                aggregation.add(node);
+                return true;
+            };
+            if (conditions) {
+                for_each_match(graph, *conditions, consume);
+            } else {
+                auto timer = QueryProfile::Timer("scan");
+                graph.for_each_node_where([profile = QueryProfile::active()](const Node &) {
+                    if (profile != nullptr) {
+                        ++profile->rows_examined;
+                    }
+                    return true;
+                }, consume);
             }
         }
+        auto output_timer = QueryProfile::Timer("output");
+        aggregation.print();
+        if (auto *profile = QueryProfile::active()) {
+            profile->rows_returned = aggregation.row_count();
+        }
     } catch (const std::exception &e) {
-        std::cerr << "Failed to process SELECT query: " << e.what() << "\n";
+        db.report_error(std::format("Failed to process SELECT query: {}", e.what()));
     }
 }
 
@@ -347,7 +2709,7 @@ auto Query::handle_insert_complex_node(Database &db) const -> void {
         Node node = {++db.current_id, value};
         db.add_node(node);
     } catch (std::runtime_error &e) {
-        std::cerr << "Failed to parse query. Value is not a proper JSON" << std::endl;
+        db.report_error("Failed to parse query. Value is not a proper JSON");
     }
 }
 
@@ -358,45 +2720,58 @@ auto Query::handle_insert_edge(const Database &db) const -> void {
     try {
         const auto from_id = std::stoi(node_ids[0]);
         const auto to_id = std::stoi(node_ids[1]);
+        auto weight = std::optional<float>{};
+        if (const auto *weight_command = find_command("WEIGHT")) {
+            try {
+                weight = std::stof(weight_command->value);
+            } catch (std::logic_error &) {
+                db.report_error("Failed to insert edge. Weight is not a valid number");
+                return;
+            }
+            if (!std::isfinite(*weight) || *weight < 0) {
+                db.report_error("Failed to insert edge. Weight must be a finite non-negative number");
+                return;
+            }
+        }
         Edge edge = {from_id, to_id};
-        db.add_edge(edge);
+        db.add_edge(edge, weight);
     } catch (std::invalid_argument &e) {
-        std::cerr << "Failed to insert edge. Node id is not valid integer" << std::endl;
+        db.report_error("Failed to insert edge. Node id is not valid integer");
     }
 }
 
 auto Query::handle_select(const Database &db) const -> void {
     logger.debug("SELECT NODE started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
     const auto command = this->commands.front().value;
     try {
         auto id = std::stoi(command);
-        const auto nodes = db.get_graph().find_nodes_where([&](const auto &node) {
-            return node.id == id;
-        });
-        if (nodes.empty()) {
-            std::cerr << std::format("No node found with id {}", id) << std::endl;
+        if (auto *node = db.get_graph().find_node(id); node == nullptr) {
+            db.report_error(std::format("No node found with id {}", id));
         } else {
-            fmt::println("Found node with id {}\n{}", nodes.size(), nodes.front().get().toString());
+            fmt::println("Found node with id {}\n{}", id, node->toString());
         }
     } catch (std::invalid_argument &e) {
-        std::cerr << "Failed to select node. Node id is not valid integer" << std::endl;
+        db.report_error("Failed to select node. Node id is not valid integer");
     }
 }
 
 auto Query::handle_update_node(Database &db, bool isComplex) const -> void {
     logger.debug("UPDATE NODE started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
     auto value = this->commands.front().value;
     // TODO: move to separte func
     auto parts = value | std::views::split(' ') | std::ranges::to<std::vector<std::string> >();
     auto new_value = Utils::get_rest_of_space_separated_string(parts, 1);
     try {
         const auto node_id = std::stoi(parts[0]);
-        Node *matched_node = nullptr;
-        for (auto &node: db.get_graph().nodes) {
-            if (node_id == node.id) {
-                matched_node = &node;
-            }
-        }
+        Node *matched_node = db.get_graph().find_node(node_id);
         if (matched_node != nullptr) {
             size_t pos = 0;
             std::variant<BasicValue, UserDefinedValue> value;
@@ -406,18 +2781,22 @@ auto Query::handle_update_node(Database &db, bool isComplex) const -> void {
             } else {
                 value = Deserialization::parse_value(new_value, pos);
             }
-            matched_node->data = value;
+            db.get_graph().update_node(*matched_node, value);
             logger.info(std::format("Successfully updated node with id {}", node_id));
         } else {
-            std::cerr << "Update failed. No node found with given id" << std::endl;
+            db.report_error("Update failed. No node found with given id");
         }
     } catch (std::invalid_argument &e) {
-        std::cerr << "Failed to update node. Node id is not valid integer" << std::endl;
+        db.report_error("Failed to update node. Node id is not valid integer");
     }
 }
 
 auto Query::handle_is_connected(const Database &db, const bool direct) const -> void {
     logger.debug("IS CONNECTED started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
     const auto command = this->commands.front().value;
     const auto node_ids = command | std::views::split(' ') | std::ranges::to<std::vector<std::string> >();
 
@@ -426,12 +2805,18 @@ auto Query::handle_is_connected(const Database &db, const bool direct) const ->
         const auto node2_id = std::stoi(node_ids[1]);
 
         auto &graph = db.get_graph();
+        auto *profile = QueryProfile::active();
+        auto timer = QueryProfile::Timer("traversal");
 
         if (direct) {
-            const bool connected = std::ranges::any_of(graph.edges, [&](const Edge &edge) {
+            const bool connected = std::ranges::any_of(graph.live_edges(), [&](const Edge &edge) {
+                if (profile != nullptr) {
+                    ++profile->edges_visited;
+                }
                 return (edge.from == node1_id && edge.to == node2_id) ||
                        (edge.from == node2_id && edge.to == node1_id);
             });
+            timer.stop();
 
             fmt::print("Nodes {} and {} are {}directly connected.\n",
                        node1_id, node2_id, connected ? "" : "not ");
@@ -455,7 +2840,10 @@ auto Query::handle_is_connected(const Database &db, const bool direct) const ->
                 }
 
                 visited.insert(current);
-                for (const auto &[from, to]: graph.edges) {
+                if (profile != nullptr) {
+                    profile->edges_visited += graph.edges.size() - graph.removed_edges_count;
+                }
+                for (const auto &[from, to]: graph.live_edges()) {
                     if (from == current && !visited.contains(to)) {
                         to_visit.push(to);
                     }
@@ -465,14 +2853,298 @@ auto Query::handle_is_connected(const Database &db, const bool direct) const ->
                 }
             }
 
+            timer.stop();
+            if (profile != nullptr) {
+                profile->nodes_visited = visited.size();
+            }
+
             fmt::print("Nodes {} and {} are {}connected.\n",
                        node1_id, node2_id, connected ? "" : "not ");
         }
     } catch (std::invalid_argument &) {
-        std::cerr << "Failed to parse node IDs. Ensure they are valid integers.\n";
+        db.report_error("Failed to parse node IDs. Ensure they are valid integers.");
+    }
+}
+
+auto Query::handle_neighbors(const Database &db, const bool directed) const -> void {
+    logger.debug("NEIGHBORS started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    const auto command = this->commands.front().value;
+    const auto arguments = command | std::views::split(' ') | std::ranges::to<std::vector<std::string> >();
+
+    try {
+        const auto node_id = std::stoi(arguments[0]);
+        const auto depth = std::stoi(arguments[1]);
+        if (depth < 0) {
+            db.report_error("Depth of NEIGHBORS query can not be negative");
+            return;
+        }
+
+        auto &graph = db.get_graph();
+        const auto slot = graph.node_slots.find(node_id);
+        if (slot == graph.node_slots.end()) {
+            db.report_error(std::format("No node found with id {}", node_id));
+            return;
+        }
+
+        auto adjacency_timer = QueryProfile::Timer("adjacency");
+        const auto &forward = graph.adjacency(directed ? Direction::Outgoing : Direction::Both);
+        const auto &backward = graph.adjacency(directed ? Direction::Incoming : Direction::Both);
+        adjacency_timer.stop();
+
+        auto traversal_timer = QueryProfile::Timer("traversal");
+        auto stats = TraversalStats{};
+        const auto levels = Traversal::levels_within(forward, backward, static_cast<uint32_t>(slot->second), depth,
+                                                     &stats);
+        traversal_timer.stop();
+
+        auto output_timer = QueryProfile::Timer("output");
+        size_t reached = 0;
+        for (size_t level = 1; level < levels.size(); ++level) {
+            auto ids = levels[level] | std::views::transform([&graph](const uint32_t neighbor) {
+                return graph.nodes[neighbor].id;
+            }) | std::ranges::to<std::vector<int> >();
+            rg::sort(ids);
+            fmt::println("Level {}: {}", level, fmt::join(ids, ", "));
+            reached += ids.size();
+        }
+        fmt::println("{} node(s) within {} hop(s) of node {}.", reached, depth, node_id);
+        if (auto *profile = QueryProfile::active()) {
+            profile->nodes_visited = reached + 1;
+            profile->edges_visited = stats.edges_examined;
+            profile->rows_returned = reached;
+        }
+    } catch (std::invalid_argument &) {
+        db.report_error("Failed to parse NEIGHBORS query. Ensure node id and depth are valid integers.");
+    }
+}
+
+auto Query::handle_weighted_path(const Database &db, const bool directed) const -> void {
+    logger.debug("WEIGHTED PATH started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    const auto command = this->commands.front().value;
+    const auto node_ids = command | std::views::split(' ') | std::ranges::to<std::vector<std::string> >();
+
+    try {
+        const auto from_id = std::stoi(node_ids[0]);
+        const auto to_id = std::stoi(node_ids[1]);
+
+        auto &graph = db.get_graph();
+        const auto from_slot = graph.node_slots.find(from_id);
+        const auto to_slot = graph.node_slots.find(to_id);
+        for (const auto &[id, slot]: {std::pair{from_id, from_slot}, std::pair{to_id, to_slot}}) {
+            if (slot == graph.node_slots.end()) {
+                db.report_error(std::format("No node found with id {}", id));
+                return;
+            }
+        }
+
+        auto adjacency_timer = QueryProfile::Timer("adjacency");
+        const auto &adjacency = graph.adjacency(directed ? Direction::Outgoing : Direction::Both);
+        adjacency_timer.stop();
+
+        auto traversal_timer = QueryProfile::Timer("traversal");
+        auto stats = TraversalStats{};
+        const auto path = Traversal::shortest_path(adjacency, static_cast<uint32_t>(from_slot->second),
+                                                   static_cast<uint32_t>(to_slot->second), &stats);
+        traversal_timer.stop();
+
+        auto output_timer = QueryProfile::Timer("output");
+        if (!path) {
+            fmt::println("No path from {} to {}.", from_id, to_id);
+        } else {
+            const auto ids = path->slots | std::views::transform([&graph](const uint32_t slot) {
+                return graph.nodes[slot].id;
+            }) | std::ranges::to<std::vector<int> >();
+            fmt::println("Shortest path from {} to {} costs {:g} over {} edge(s): {}", from_id, to_id, path->cost,
+                         ids.size() - 1, fmt::join(ids, " -> "));
+        }
+        if (auto *profile = QueryProfile::active()) {
+            profile->nodes_visited = stats.nodes_settled;
+            profile->edges_visited = stats.edges_examined;
+            profile->rows_returned = path ? path->slots.size() : 0;
+        }
+    } catch (std::invalid_argument &) {
+        db.report_error("Failed to parse WEIGHTED PATH query. Ensure node ids are valid integers.");
+    }
+}
+
+auto Query::handle_analyze(const Database &db) const -> void {
+    logger.debug("ANALYZE started");
+    if (!db.has_graph()) {
+        db.report_error("To execute queries first specify graph with USE command");
+        return;
+    }
+    const auto &algorithm = this->commands.front().value;
+    const auto *into = find_command("INTO");
+    auto &graph = db.get_graph();
+
+    // Triangles ignore edge directions and only need the undirected adjacency.
+    const auto undirected = algorithm == "TRIANGLES" || algorithm == "CLUSTERING";
+    const auto *outgoing = &graph.adjacency(undirected ? Direction::Both : Direction::Outgoing);
+    const auto *incoming = &graph.adjacency(undirected ? Direction::Both : Direction::Incoming);
+
+    // Removed slots would count as isolated nodes. Instead of compacting, which would write a mapped graph's
+    // edge store, the CSR is then restricted to live nodes, numbered in slot order; slots[n] is node n's slot.
+    auto slots = std::vector<uint32_t>{};
+    auto restricted = std::array<std::optional<Adjacency>, 2>{};
+    if (graph.removed_nodes_count > 0) {
+        slots.reserve(graph.live_node_count());
+        for (uint32_t slot = 0; slot < graph.nodes.size(); ++slot) {
+            if (!graph.is_node_removed(slot)) {
+                slots.push_back(slot);
+            }
+        }
+        restricted[0] = outgoing->restricted_to(slots);
+        outgoing = &*restricted[0];
+        if (!undirected) {
+            restricted[1] = incoming->restricted_to(slots);
+        }
+        incoming = undirected ? outgoing : &*restricted[1];
+    }
+    auto node_of = [&](const size_t number) -> const Node & {
+        return graph.nodes[slots.empty() ? number : slots[number]];
+    };
+    auto slot_of = [&](const size_t number) -> size_t {
+        return slots.empty() ? number : slots[number];
+    };
+    const auto live_numbers = std::views::iota(size_t{0}, outgoing->node_count());
+
+    auto results = std::vector<std::pair<size_t, BasicValue> >{};
+    if (undirected) {
+        const auto counts = Analytics::triangles(*outgoing);
+        double clustering_sum = 0;
+        for (const auto node: live_numbers) {
+            clustering_sum += counts.clustering(node);
+            if (algorithm == "CLUSTERING") {
+                results.emplace_back(slot_of(node), BasicValue(counts.clustering(node)));
+            } else if (counts.triangles[node] <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+                results.emplace_back(slot_of(node), BasicValue(static_cast<int>(counts.triangles[node])));
+            } else {
+                results.emplace_back(slot_of(node), BasicValue(static_cast<double>(counts.triangles[node])));
+            }
+        }
+
+        fmt::println("Found {} triangle(s). Average clustering coefficient {:.6f}, transitivity {:.6f}.",
+                     counts.total,
+                     live_numbers.empty() ? 0.0 : clustering_sum / static_cast<double>(live_numbers.size()),
+                     counts.transitivity());
+        auto top = live_numbers | std::ranges::to<std::vector<size_t> >();
+        const auto shown = std::min<size_t>(10, top.size());
+        // Ties go to the lower node id, so the listing does not depend on the slot order.
+        rg::partial_sort(top, top.begin() + static_cast<std::ptrdiff_t>(shown), [&](const auto left, const auto right) {
+            if (counts.triangles[left] != counts.triangles[right]) {
+                return counts.triangles[left] > counts.triangles[right];
+            }
+            return node_of(left).id < node_of(right).id;
+        });
+        fmt::println("Top {} node(s) by triangles:", shown);
+        for (const auto node: top | std::views::take(shown)) {
+            fmt::println("Node {}: {} triangle(s), clustering {:.6f}", node_of(node).id, counts.triangles[node],
+                         counts.clustering(node));
+        }
+    } else if (algorithm == "PAGERANK") {
+        const auto [ranks, iterations] = Analytics::pagerank(*outgoing, *incoming);
+        for (const auto node: live_numbers) {
+            results.emplace_back(slot_of(node), BasicValue(static_cast<double>(ranks[node])));
+        }
+
+        auto top = results;
+        const auto shown = std::min<size_t>(10, top.size());
+        rg::partial_sort(top, top.begin() + static_cast<std::ptrdiff_t>(shown), [](const auto &left, const auto &right) {
+            return left.second.as_number() > right.second.as_number();
+        });
+        fmt::println("PageRank converged after {} iteration(s). Top {} node(s):", iterations, shown);
+        for (const auto &[slot, rank]: top | std::views::take(shown)) {
+            fmt::println("Node {}: {:.6f}", graph.nodes[slot].id, rank.as_number());
+        }
+    } else if (algorithm == "DEGREES") {
+        const auto [outgoing_degrees, incoming_degrees] = Analytics::degree_distribution(*outgoing, *incoming);
+        for (const auto node: live_numbers) {
+            results.emplace_back(slot_of(node),
+                                 BasicValue(static_cast<int>(outgoing->degree(node) + incoming->degree(node))));
+        }
+
+        fmt::println("Out-degree | Nodes");
+        for (const auto &[degree, count]: outgoing_degrees) {
+            fmt::println("{} | {}", degree, count);
+        }
+        fmt::println("In-degree | Nodes");
+        for (const auto &[degree, count]: incoming_degrees) {
+            fmt::println("{} | {}", degree, count);
+        }
+    } else if (algorithm == "SCC") {
+        const auto component = Analytics::strongly_connected_components(*outgoing, *incoming);
+        auto sizes = std::unordered_map<uint32_t, size_t>{};
+        for (const auto node: live_numbers) {
+            ++sizes[component[node]];
+            results.emplace_back(slot_of(node), BasicValue(node_of(component[node]).id));
+        }
+
+        const auto largest = rg::max_element(sizes, {}, &std::pair<const uint32_t, size_t>::second);
+        fmt::println("Found {} strongly connected component(s).", sizes.size());
+        if (largest != sizes.end()) {
+            fmt::println("Largest component has {} node(s) and contains node {}.", largest->second,
+                         node_of(largest->first).id);
+        }
+    } else {
+        db.report_error("ANALYZE supports only PAGERANK, DEGREES, SCC, TRIANGLES and CLUSTERING");
+        return;
+    }
+
+    if (into != nullptr) {
+        size_t written = 0;
+        for (const auto &[slot, value]: results) {
+            written += graph.set_node_field(slot, into->value, value) ? 1 : 0;
+        }
+        logger.info(std::format("Stored {} result in field {} of {} node(s)", algorithm, into->value, written));
+    }
+}
+
+auto Query::handle_delete_node(const Database &db) const -> void {
+    logger.debug("DELETE NODE started");
+    const auto command = this->commands.front().value;
+    try {
+        db.remove_node(std::stoi(command));
+    } catch (std::invalid_argument &e) {
+        db.report_error("Failed to delete node. Node id is not valid integer");
+    }
+}
+
+auto Query::handle_delete_edge(const Database &db) const -> void {
+    logger.debug("DELETE EDGE started");
+    const auto command = this->commands.front().value;
+    const auto node_ids = command | std::views::split(' ') | std::ranges::to<std::vector<std::string> >();
+    try {
+        db.remove_edge(std::stoi(node_ids[0]), std::stoi(node_ids[1]));
+    } catch (std::invalid_argument &e) {
+        db.report_error("Failed to delete edge. Node id is not valid integer");
     }
 }
 
+auto Query::handle_create_index(const Database &db) const -> void {
+    logger.debug("CREATE INDEX started");
+    const auto command = this->commands.front().value;
+    const auto separator = command.find(' ');
+    db.create_index(command.substr(0, separator), command.substr(separator + 1));
+}
+
+auto Query::handle_set_storage(const Database &db) const -> void {
+    logger.debug("SET STORAGE started");
+    db.set_storage(this->commands.front().value == "MAPPED");
+}
+
+auto Query::handle_reorder_graph(const Database &db) const -> void {
+    logger.debug("REORDER GRAPH started");
+    db.reorder_graph(this->commands.front().value);
+}
+
 auto Query::handle(Database &db) const -> void {
     const auto &first_command = commands.front();
     logger.debug(std::format("Started attempt to handle query with first command: {}", first_command.keyword));
@@ -512,9 +3184,373 @@ auto Query::handle(Database &db) const -> void {
     if (first_command.keyword == "IS CONNECTED DIRECTLY") {
         return handle_is_connected(db, true);
     }
-    std::cerr << "Unknown command";
+    if (first_command.keyword == "SELECT AGGREGATE") {
+        return handle_select_aggregate(db);
+    }
+    if (first_command.keyword == "CREATE INDEX") {
+        return handle_create_index(db);
+    }
+    if (first_command.keyword == "SET STORAGE") {
+        return handle_set_storage(db);
+    }
+    if (first_command.keyword == "REORDER GRAPH") {
+        return handle_reorder_graph(db);
+    }
+    if (first_command.keyword == "ANALYZE") {
+        return handle_analyze(db);
+    }
+    if (first_command.keyword == "NEIGHBORS") {
+        return handle_neighbors(db, false);
+    }
+    if (first_command.keyword == "NEIGHBORS DIRECTED") {
+        return handle_neighbors(db, true);
+    }
+    if (first_command.keyword == "WEIGHTED PATH") {
+        return handle_weighted_path(db, false);
+    }
+    if (first_command.keyword == "WEIGHTED PATH DIRECTED") {
+        return handle_weighted_path(db, true);
+    }
+    if (first_command.keyword == "MATCH") {
+        return handle_match(db);
+    }
+    if (first_command.keyword == "DELETE NODE") {
+        return handle_delete_node(db);
+    }
+    if (first_command.keyword == "DELETE EDGE FROM TO") {
+        return handle_delete_edge(db);
+    }
+    if (first_command.keyword == "STATS") {
+        return handle_stats(db);
+    }
+    if (first_command.keyword == "EXPLAIN") {
+        return handle_explain(db);
+    }
+    if (first_command.keyword == "PROFILE") {
+        return handle_profile(db);
+    }
+    db.report_error("Unknown command");
+}
+
+auto Query::handle_stats(const Database &db) -> void {
+    db.print_stats();
+}
+
+static auto describe_adjacency(const Graph &graph, const Direction direction) -> std::string {
+    const auto &cached = graph.adjacency_cache[static_cast<size_t>(direction)];
+    auto source = std::string("built from live edges on first use");
+    if (cached && cached->mapping) {
+        source = cached->patches.empty()
+                     ? "mapped from the edge store"
+                     : std::format("mapped from the edge store, {} changed slot(s) patched in memory",
+                                   cached->patches.size());
+    } else if (cached) {
+        source = "cached";
+    } else if (graph.edge_store_current()) {
+        source = "mapped from the edge store on first use";
+    } else if (graph.adjacency_patchable()) {
+        source = "mapped from the edge store on first use, changes since patched in memory";
+    }
+    return std::format("{} adjacency in CSR form, {}", direction == Direction::Both ? "Undirected" : "Outgoing",
+                       source);
+}
+
+static auto describe_literal(const BasicValue &value) -> std::string {
+    return std::holds_alternative<std::string>(value.data) ? std::format("\"{}\"", value.toString()) : value.toString();
+}
+
+static auto describe_condition(const Condition &condition) -> std::string {
+    auto description = std::format("\"{}\" {} {}", condition.field, condition.comparator.value,
+                                   describe_literal(condition.value));
+    if (condition.upper) {
+        description += std::format(" AND {}", describe_literal(*condition.upper));
+    }
+    return description;
+}
+
+static auto describe_conditions(const ConditionGroup &group) -> std::string {
+    auto description = describe_condition(group.conditions.front());
+    for (size_t i = 0; i < group.operators.size(); ++i) {
+        description += std::format(" {} {}", group.operators[i].value, describe_condition(group.conditions[i + 1]));
+    }
+    return description;
+}
+
+// Conditions in the order plan_filter evaluates them, each with its estimated share of live nodes.
+static auto describe_filter(const Graph &graph, const ConditionGroup &group) -> std::string {
+    const auto filter = plan_filter(graph, group);
+    auto description = std::string{};
+    for (size_t i = 0; i < filter.conditions.size(); ++i) {
+        if (i > 0) {
+            description += std::format(" {} ", filter.operators[i - 1].value);
+        }
+        description += std::format("{} [~{:.1f}%]", describe_condition(filter.conditions[i]),
+                                   100 * selectivity(graph, filter.conditions[i]));
+    }
+    return description;
+}
+
+// How nodes matching the group are found, as chosen by for_each_match.
+static auto describe_access(const Graph &graph, const ConditionGroup &group) -> std::string {
+    const auto bitmap_indexed = static_cast<size_t>(rg::count_if(group.conditions, [&graph](const Condition &condition) {
+        return graph.bitmap_indexes.contains(condition.field);
+    }));
+    if (bitmap_indexed == group.conditions.size()) {
+        return std::format("Bitmap index evaluation of {} condition(s), AND and OR combine compressed slot sets and "
+                           "nodes are only read for output", bitmap_indexed);
+    }
+    if (bitmap_indexed > 0 && group.is_conjunction()) {
+        return std::format("Bitmap index intersection of {} condition(s), candidates are checked against the rest",
+                           bitmap_indexed);
+    }
+    if (const auto *condition = choose_index_condition(graph, group)) {
+        if (!ordered_index_can_answer(graph, *condition)) {
+            const auto &ngrams = graph.ngram_indexes.at(condition->field);
+            return std::format("N-gram index lookup on \"{}\" for {}, intersects posting lists of up to {} "
+                               "candidate(s)", condition->field, describe_condition(*condition),
+                               ngrams.estimate(condition->value.toString()));
+        }
+        const auto &index = graph.ordered_indexes.at(condition->field);
+        if (condition->comparator.kind == Comparator::Kind::EQ) {
+            return std::format("Ordered index lookup on \"{}\" for {}, {} candidate(s)", condition->field,
+                               describe_condition(*condition), count_equal(index, *condition));
+        }
+        return std::format("Ordered index range scan on \"{}\" for {}, index holds {} entries", condition->field,
+                           describe_condition(*condition), index.size());
+    }
+    auto reason = std::string{};
+    if (const auto *condition = best_index_condition(graph, group)) {
+        reason = std::format(", the index on \"{}\" would yield ~{:.0f} candidate(s), over {:.0f}% of live nodes",
+                             condition->field, std::ceil(estimate_candidates(graph, *condition)),
+                             index_scan_share * 100);
+    } else if (!group.is_conjunction() && rg::any_of(group.conditions, [&graph](const Condition &condition) {
+        return graph.ordered_indexes.contains(condition.field) || graph.ngram_indexes.contains(condition.field);
+    })) {
+        reason = ", indexes are not used with OR unless every condition has a bitmap index";
+    } else if (rg::any_of(group.conditions, [&graph](const Condition &condition) {
+        return condition.comparator.is_text() && graph.ngram_indexes.contains(condition.field);
+    })) {
+        reason = std::format(", n-gram indexes need patterns of at least {} characters", NgramIndex::gram_size);
+    }
+    return std::format("Full scan over {} node slot(s), {} live{}", graph.nodes.size(), graph.live_node_count(),
+                       reason);
+}
+
+auto Query::explain(const Database &db) const -> std::vector<std::string> {
+    const auto &keyword = commands.front().keyword;
+    auto plan = std::vector<std::string>{};
+    if (is_mutation()) {
+        plan.push_back("Mutation, applied to the current graph and appended to the mutation log if it succeeds");
+    }
+    if (keyword == "BEGIN" || keyword == "COMMIT" || keyword == "ROLLBACK" || keyword == "USE" ||
+        keyword == "CREATE GRAPH" || keyword == "STATS") {
+        plan.push_back(std::format("{} has no plan, it runs directly", keyword));
+        return plan;
+    }
+    if (!db.has_graph()) {
+        plan.push_back("No graph selected, specify graph with USE command to see the plan");
+        return plan;
+    }
+
+    const auto &graph = db.get_graph();
+    if (keyword == "SELECT NODE WHERE") {
+        const auto group = parse_conditions(commands.front().value);
+        plan.push_back(describe_access(graph, group));
+        if (rg::all_of(group.conditions, [&graph](const Condition &condition) {
+            return graph.bitmap_indexes.contains(condition.field);
+        })) {
+            plan.push_back(std::format("Filter: {}, answered by the bitmaps", describe_conditions(group)));
+        } else {
+            plan.push_back(std::format("Filter: {}, ordered by selectivity and cost, stops once the result is known",
+                                       describe_filter(graph, group)));
+        }
+        const auto *limit = find_command("LIMIT");
+        const auto *offset = find_command("OFFSET");
+        if (limit != nullptr || offset != nullptr) {
+            plan.push_back(std::format("Skip {} match(es), stop after {}", offset != nullptr ? offset->value : "0",
+                                       limit != nullptr ? limit->value + " row(s)" : "the last match"));
+        }
+        const auto *format = find_command("FORMAT");
+        plan.push_back(std::format("Output: {} rows streamed while scanning",
+                                   format != nullptr ? format->value : "TEXT"));
+    } else if (keyword == "SELECT AGGREGATE") {
+        const auto *where = find_command("WHERE");
+        const auto *group_by = find_command("GROUP BY");
+        const auto conditions = where != nullptr ? std::optional(parse_conditions(where->value)) : std::nullopt;
+        auto aggregates = std::vector<Aggregate>{};
+        for (const auto token: commands.front().value | std::views::split(' ')) {
+            aggregates.push_back(Aggregate::parse(std::string_view(token)));
+        }
+        // Probed on a scratch aggregation, the counters are cheap to read.
+        auto probe = GroupedAggregation(aggregates, group_by != nullptr ? std::optional(group_by->value) : std::nullopt);
+        if (count_from_counters(graph, probe, aggregates, conditions, group_by)) {
+            plan.push_back("Answered from live node and index value counters, no nodes are read");
+        } else if (conditions) {
+            plan.push_back(describe_access(graph, *conditions));
+            plan.push_back(std::format("Filter: {}", describe_filter(graph, *conditions)));
+        } else {
+            plan.push_back(std::format("Full scan over {} node slot(s), {} live", graph.nodes.size(),
+                                       graph.live_node_count()));
+        }
+        if (!plan.back().starts_with("Answered")) {
+            plan.push_back(group_by != nullptr
+                               ? std::format("Hash aggregation of {} aggregate(s) grouped by \"{}\" in one pass",
+                                             aggregates.size(), group_by->value)
+                               : std::format("Single pass over matches for {} aggregate(s)", aggregates.size()));
+        }
+    } else if (keyword == "SELECT NODE") {
+        plan.push_back("Hash lookup of the node id in the slot map");
+    } else if (keyword == "IS CONNECTED DIRECTLY") {
+        plan.push_back(std::format("Linear scan over {} live edge(s), stops at the first connecting edge",
+                                   graph.edges.size() - graph.removed_edges_count));
+    } else if (keyword == "IS CONNECTED") {
+        plan.push_back("Breadth-first search in both directions from the first node, stops when the second is reached");
+        plan.push_back(std::format("Every visited node scans all {} live edge(s), up to {} edge checks in total",
+                                   graph.edges.size() - graph.removed_edges_count,
+                                   graph.live_node_count() * (graph.edges.size() - graph.removed_edges_count)));
+    } else if (keyword == "NEIGHBORS" || keyword == "NEIGHBORS DIRECTED") {
+        const auto direction = keyword == "NEIGHBORS" ? Direction::Both : Direction::Outgoing;
+        plan.push_back(describe_adjacency(graph, direction));
+        plan.push_back(std::format("Direction-optimizing breadth-first search, switches to bottom-up steps once the "
+                                   "frontier touches more than 1/{} of unexplored edges", Traversal::alpha));
+    } else if (keyword == "WEIGHTED PATH" || keyword == "WEIGHTED PATH DIRECTED") {
+        const auto direction = keyword == "WEIGHTED PATH" ? Direction::Both : Direction::Outgoing;
+        plan.push_back(describe_adjacency(graph, direction));
+        plan.push_back(graph.edge_weights.empty()
+                           ? "Dijkstra with a 4-ary heap, every edge weighs 1, stops when the target is settled"
+                           : "Dijkstra with a 4-ary heap over edge weights, stops when the target is settled");
+    } else if (keyword == "MATCH") {
+        const auto pattern = MatchPattern::parse(commands.front().value);
+        const auto steps = plan_match(graph, pattern);
+        const auto &start = steps.front();
+        const auto &start_group = pattern.conditions[start.variable];
+        plan.push_back(std::format("Start at ({}): {}, ~{:.0f} row(s)", pattern.variables[start.variable],
+                                   start_group ? describe_access(graph, *start_group)
+                                               : std::format("Full scan over {} node slot(s), {} live",
+                                                             graph.nodes.size(), graph.live_node_count()),
+                                   std::ceil(start.estimated_rows)));
+        if (start_group) {
+            plan.push_back(std::format("Filter ({}): {}", pattern.variables[start.variable],
+                                       describe_filter(graph, *start_group)));
+        }
+        for (const auto &step: steps | std::views::drop(1)) {
+            const auto &group = pattern.conditions[step.variable];
+            plan.push_back(std::format("Expand ({}) to ({}) over {} adjacency{}, ~{:.0f} row(s)",
+                                       pattern.variables[*step.from], pattern.variables[step.variable],
+                                       step.direction == Direction::Both
+                                           ? "undirected"
+                                           : step.direction == Direction::Outgoing ? "outgoing" : "incoming",
+                                       group ? std::format(", keep {}", describe_filter(graph, *group)) : "",
+                                       std::ceil(step.estimated_rows)));
+        }
+        plan.push_back(std::format("Pipelined: each row is extended as soon as it is found, {}",
+                                   pattern.limit ? std::format("stops after {} row(s)", *pattern.limit)
+                                                 : "no intermediate results are kept"));
+    } else if (keyword == "ANALYZE") {
+        const auto &algorithm = commands.front().value;
+        const auto undirected = algorithm == "TRIANGLES" || algorithm == "CLUSTERING";
+        plan.push_back(std::format("Whole-graph {} over {} CSR adjacency{}", algorithm,
+                                   undirected ? "undirected" : "outgoing and incoming",
+                                   graph.removed_nodes_count > 0 ? ", restricted to live nodes" : ""));
+        if (undirected) {
+            plan.push_back("Neighbour lists sorted and oriented from lower to higher (degree, slot) rank, every "
+                           "triangle is found once by intersecting two sorted lists");
+        }
+    } else if (keyword == "SET STORAGE") {
+        plan.push_back(commands.front().value == "MAPPED"
+                           ? std::format("Writes {} live edge(s) and their CSR adjacency to a new edge store file",
+                                         graph.live_edge_count())
+                           : std::format("Reads {} edge(s) from the edge store into memory", graph.edges.size()));
+    } else if (keyword == "REORDER GRAPH") {
+        plan.push_back(std::format("Orders {} live node(s) by {} over the undirected adjacency, then rebuilds "
+                                   "the indexes and adjacency in the new slot order",
+                                   graph.live_node_count(), commands.front().value));
+    } else if (keyword == "CREATE INDEX") {
+        plan.push_back(std::format("Builds the index from {} live node(s) in one sort", graph.live_node_count()));
+    } else if (keyword == "INSERT NODE" || keyword == "INSERT NODE COMPLEX") {
+        plan.push_back(std::format("Appends one node slot and updates {} index(es)",
+                                   graph.ordered_indexes.size() + graph.ngram_indexes.size() +
+                                   graph.bitmap_indexes.size()));
+    } else if (keyword == "UPDATE NODE TO" || keyword == "UPDATE NODE TO COMPLEX") {
+        plan.push_back(std::format("Hash lookup of the node id, then rewrites {} index(es)",
+                                   graph.ordered_indexes.size() + graph.ngram_indexes.size() +
+                                   graph.bitmap_indexes.size()));
+    } else if (keyword == "DELETE NODE") {
+        plan.push_back("Hash lookup of the node id and tombstones the node, its edges are purged by compaction");
+    } else if (keyword == "INSERT EDGE" || keyword == "INSERT EDGE FROM TO") {
+        // Mirrors Graph::add_edge: only a CSR mapped from the edge store is patched in place.
+        const auto &cached = graph.adjacency_cache[static_cast<size_t>(Direction::Outgoing)];
+        plan.push_back(cached && cached->mapping && graph.adjacency_patchable()
+                           ? "Appends one edge, then hash lookups of both node slots patch it into the overlay "
+                             "over the mapped CSR"
+                           : "Appends one edge, cached adjacency is dropped and rebuilt on next use");
+    } else if (keyword == "DELETE EDGE FROM TO") {
+        plan.push_back(graph.edge_store ? "Binary search in the sorted edge store and CSR lookup of the source among "
+                                          "edges added since, tombstones matches"
+                                        : "CSR lookup of the source node's outgoing edges, tombstones matches");
+    }
+    return plan;
+}
+
+auto Query::handle_explain(const Database &db) const -> void {
+    const auto &statement = commands.front().value;
+    const auto query = from_string(statement);
+    if (!query) {
+        db.report_error(std::format("Failed to parse statement to explain: {}", statement));
+        return;
+    }
+    fmt::println("Plan for {}:", query->commands.front().keyword);
+    for (const auto &step: query->explain(db)) {
+        fmt::println("  - {}", step);
+    }
+}
+
+auto Query::handle_profile(Database &db) const -> void {
+    const auto &statement = commands.front().value;
+    auto profile = QueryProfile();
+    std::optional<Query> query;
+    {
+        auto timer = QueryProfile::Timer("parse");
+        query = from_string(statement);
+    }
+    if (!query) {
+        db.report_error(std::format("Failed to parse statement to profile: {}", statement));
+        return;
+    }
+    const auto &keyword = query->commands.front().keyword;
+    if (keyword == "EXPLAIN" || keyword == "PROFILE") {
+        db.report_error(std::format("{} can not be profiled", keyword));
+        return;
+    }
+    {
+        // Time not claimed by an instrumented stage, e.g. logging and handlers without stages.
+        auto timer = QueryProfile::Timer("execute");
+        db.execute_query(*query);
+    }
+    profile.print(keyword);
 }
 
 auto Query::get_commands() const -> const std::vector<Command> & {
     return commands;
 }
+
+auto Query::get_text() const -> const std::string & {
+    return text;
+}
+
+auto Query::is_mutation() const -> bool {
+    static const auto mutating_keywords = std::unordered_set<std::string>{
+        "CREATE GRAPH", "CREATE INDEX", "INSERT NODE", "INSERT NODE COMPLEX", "INSERT EDGE", "INSERT EDGE FROM TO",
+        "UPDATE NODE TO", "UPDATE NODE TO COMPLEX", "DELETE NODE", "DELETE EDGE FROM TO", "SET STORAGE",
+        "REORDER GRAPH",
+    };
+    const auto &keyword = commands.front().keyword;
+    return mutating_keywords.contains(keyword) || (keyword == "ANALYZE" && find_command("INTO") != nullptr);
+}
+
+auto Query::find_command(const std::string_view keyword) const -> const Command * {
+    const auto it = rg::find_if(commands, [&keyword](const Command &command) {
+        return command.keyword == keyword;
+    });
+    return it == commands.end() ? nullptr : &*it;
+}
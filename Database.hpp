@@ -4,131 +4,92 @@
 #ifndef DATABASE_HPP
 #define DATABASE_HPP
 
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
 #include <ranges>
 #include <sstream>
+#include <unordered_map>
 #include "fmt/core.h"
 
+#include "Adjacency.hpp"
+#include "Index.hpp"
 #include "Logger.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "MutationLog.hpp"
+#include "Statistics.hpp"
+#include "Value.hpp"
 
 class Database;
+class EdgeStore;
 
 namespace rg = std::ranges;
 
 
-struct BasicValue {
-    using Data = std::variant<int, double, bool, std::string>;
+struct Node {
+    int id{};
+    using Data = std::variant<BasicValue, UserDefinedValue>;
     Data data;
 
+    // Top level field of a complex node, if it holds a primitive value.
     [[nodiscard]]
-    auto toString() const -> std::string {
-        return std::visit([]<typename T0>(const T0 &arg) -> std::string {
-            using T = std::decay_t<T0>;
-            if constexpr (std::same_as<T, bool>) {
-                return arg ? "true" : "false";
-            } else if constexpr (std::same_as<T, std::string>) {
-                return arg;
-            } else {
-                return std::to_string(arg);
-            }
-        }, this->data);
-    }
-};
-
-struct UserDefinedValue {
-    using Data = std::vector<std::pair<std::string, std::variant<BasicValue, UserDefinedValue> > >;
-
-private:
-    Data data;
-
-    static auto validate_data(const Data &data) -> void {
-        const auto contains_name = std::ranges::find_if(data, [](const auto &pair) {
-            return pair.first == "name";
-        }) != data.end();
-        if (!contains_name) {
-            throw std::runtime_error("UserDefinedValue must have name specified");
+    auto field(const std::string_view key) const -> std::optional<BasicValue> {
+        if (!std::holds_alternative<UserDefinedValue>(data)) {
+            return std::nullopt;
         }
+        return std::get<UserDefinedValue>(data).find_value(key);
     }
 
-public:
-    UserDefinedValue() = default;
-
-    ~UserDefinedValue() = default;
-
-    explicit UserDefinedValue(Data data) {
-        set_data(std::move(data));
-    }
-
-    auto set_data(Data data) -> void {
-        validate_data(data);
-        this->data = std::move(data);
-    }
-
+    // Same as field, with strings viewed in place. Only valid while the node is unchanged.
     [[nodiscard]]
-    auto get_data() const -> Data const & {
-        return data;
+    auto field_view(const std::string_view key) const -> std::optional<BasicValueView> {
+        if (!std::holds_alternative<UserDefinedValue>(data)) {
+            return std::nullopt;
+        }
+        return std::get<UserDefinedValue>(data).find_view(key);
     }
 
     [[nodiscard]]
     auto toString() const -> std::string {
-        std::ostringstream oss;
-        oss << "{ ";
-        for (size_t i = 0; i < data.size(); ++i) {
-            const auto &[key, value] = data[i];
-            oss << "\"" << key << "\": ";
-            std::visit(
-                [&oss](const auto &v) {
-                    oss << v.toString();
-                },
-                value
-            );
-            if (i + 1 < data.size()) {
-                oss << ", ";
-            }
-        }
-        oss << " }";
-        return oss.str();
+        std::string result;
+        append_to(result);
+        return result;
     }
-};
-
 
-struct Node {
-    int id{};
-    using Data = std::variant<BasicValue, UserDefinedValue>;
-    Data data;
-
-    [[nodiscard]]
-    auto toString() -> std::string {
-        std::ostringstream oss;
-        oss << "Node { id: " << id << ", data: ";
+    auto append_to(std::string &out) const -> void {
+        out += "Node { id: ";
+        out += std::to_string(id);
+        out += ", data: ";
 
         std::visit(
-            [&oss]<typename T0>(const T0 &value) {
+            [&out]<typename T0>(const T0 &value) {
                 using T = std::decay_t<T0>;
                 if constexpr (std::is_same_v<T, BasicValue>) {
-                    oss << value.toString();
+                    value.append_to(out);
                 } else if constexpr (std::is_same_v<T, UserDefinedValue>) {
-                    oss << "{ ";
-                    for (const auto &[key, sub_value]: value.get_data()) {
-                        oss << key << ": ";
-                        std::visit(
-                            [&oss](const auto &sub) {
-                                oss << sub.toString();
-                            },
-                            sub_value
-                        );
-                        oss << ", ";
-                    }
-                    oss << "}";
+                    out += "{ ";
+                    auto any = false;
+                    value.append_fields_to(out, [&](const std::string &key) {
+                        if (any) {
+                            out += ", ";
+                        }
+                        any = true;
+                        out += key;
+                        out += ": ";
+                    });
+                    out += any ? ", }" : "}";
                 }
             },
             data
         );
 
-        oss << " }";
-        return oss.str();
+        out += " }";
     }
 };
 
@@ -141,18 +102,239 @@ struct Graph {
     std::string name;
 
     std::vector<Node> nodes;
-    std::vector<Edge> edges;
+    // In mapped storage the first edges are read from edge_store and only later ones live in memory.
+    SegmentedVector<Edge> edges;
+    // Weight of edges[i], parallel to edges. Empty while every edge has the default weight of 1.
+    SegmentedVector<float> edge_weights;
+
+    // Set while the graph uses mapped storage. Changes since the store was written stay in memory until
+    // merge_edges() writes the next generation of the store.
+    std::shared_ptr<const EdgeStore> edge_store;
+    // Stores replaced by a merge. The last snapshot may still reference them, so they are deleted
+    // only after the next one is written.
+    std::vector<std::string> retired_edge_stores;
+    // Set on read replicas, whose edge stores are files of the primary. Such graphs are never compacted or
+    // merged, changes replayed from the log stay in memory.
+    bool edge_store_shared = false;
+
+    // Deleted entries are only marked here, so removal is O(1). The vectors are rewritten
+    // densely by compact() once the ratio of dead entries gets high enough. Edges of a removed node
+    // are not marked, they are skipped as dangling until compaction purges them.
+    std::vector<bool> removed_nodes;
+    std::vector<bool> removed_edges;
+    size_t removed_nodes_count = 0;
+    size_t removed_edges_count = 0;
+
+    // Node id -> position in nodes. Rebuilt together with other indexes after compaction.
+    std::unordered_map<int, size_t> node_slots;
+    // Highest node id ever added. Persisted, since compaction drops deleted nodes whose ids must not be
+    // handed out again.
+    int last_node_id = 0;
+
+    // Opt-in secondary indexes keyed by field name. They reference node slots as well.
+    std::unordered_map<std::string, OrderedIndex> ordered_indexes;
+    std::unordered_map<std::string, NgramIndex> ngram_indexes;
+    std::unordered_map<std::string, BitmapIndex> bitmap_indexes;
+    // Planner statistics of every top level field of complex nodes, keyed by FieldKeys id. Not persisted,
+    // rebuilt together with the indexes.
+    std::unordered_map<uint32_t, FieldStatistics> field_statistics;
+
+    // Set by every change of persisted content. Clean graphs are copied from their byte range in the
+    // previous snapshot instead of being serialized again.
+    bool dirty = true;
+    size_t snapshot_offset = 0;
+    size_t snapshot_length = 0;
+    // CRC32C of the byte range, checked when the graph is read. Snapshots written before checksums have none.
+    std::optional<uint32_t> snapshot_checksum;
+
+    // Graphs listed in the snapshot catalog are only read on first USE, and clean ones may be
+    // evicted again under a memory budget. A non-resident graph holds just its name and byte range.
+    bool resident = true;
+    // Value of Database::use_clock when the graph was last selected, for least-recently-used eviction.
+    uint64_t last_used = 0;
+
+    // CSR views over live edges, built on first use. In memory they are dropped by any structural change,
+    // over an edge store all three directions are patched as the graph changes, see AdjacencyOverlay.
+    mutable std::array<std::optional<Adjacency>, 3> adjacency_cache;
+    // Live edges left out of the patched adjacency because a node they name is not inserted yet.
+    mutable size_t adjacency_waiting_edges = 0;
+    // Finds the in-memory edges DELETE EDGE removes without scanning them: an outgoing CSR over node
+    // slots whose targets are edge slots past the mapped base, plus edges added since by source id.
+    // Tombstones leave it valid, slot changes drop it and it is rebuilt once the additions pile up.
+    mutable std::optional<Adjacency> edge_lookup;
+    mutable std::unordered_multimap<int, size_t> edge_lookup_pending;
+
+    // What it takes to reverse one change, recorded while a transaction applies its statements so a failing
+    // statement can take back the ones before it without a copy of the graph. See undo_changes().
+    struct AddedNode {
+        int previous_last_node_id;
+    };
+    struct AddedEdge {
+        // The edge was the first to weigh other than 1, which materialized edge_weights.
+        bool materialized_weights;
+    };
+    struct UpdatedNode {
+        size_t slot;
+        Node::Data data;
+    };
+    struct RemovedNode {
+        size_t slot;
+    };
+    struct RemovedEdge {
+        size_t slot;
+    };
+    struct CreatedIndex {
+        enum class Kind { Ordered, Ngram, Bitmap };
+        Kind kind;
+        std::string field;
+    };
+    using Change = std::variant<AddedNode, AddedEdge, UpdatedNode, RemovedNode, RemovedEdge, CreatedIndex>;
+    // Set while changes are recorded.
+    std::optional<std::vector<Change> > changes;
 
     template<std::predicate<const Node &> Predicate>
     [[nodiscard]]
     auto find_nodes_where(Predicate predicate) -> std::vector<std::reference_wrapper<Node> >;
+
+    // Calls consumer for each live node accepted by predicate, until consumer returns false.
+    template<std::predicate<const Node &> Predicate, std::predicate<const Node &> Consumer>
+    auto for_each_node_where(Predicate predicate, Consumer consumer) const -> void;
+
+    [[nodiscard]]
+    auto find_node(int id) -> Node *;
+
+    [[nodiscard]]
+    auto is_node_removed(size_t slot) const -> bool;
+
+    [[nodiscard]]
+    auto is_edge_removed(size_t slot) const -> bool;
+
+    // Whether an endpoint of the edge was removed since the last compaction.
+    [[nodiscard]]
+    auto is_edge_dangling(size_t slot) const -> bool;
+
+    auto add_node(const Node &node) -> void;
+
+    auto add_edge(const Edge &edge, std::optional<float> weight = std::nullopt) -> void;
+
+    [[nodiscard]]
+    auto edge_weight(size_t slot) const -> float;
+
+    auto update_node(Node &node, Node::Data data) -> void;
+
+    // Sets a field of a complex node in place. Nodes holding a primitive value can not have fields.
+    auto set_node_field(size_t slot, const std::string &field, const BasicValue &value) -> bool;
+
+    auto remove_node(int id) -> bool;
+
+    auto remove_edges(int from, int to) -> size_t;
+
+    [[nodiscard]]
+    auto live_node_count() const -> size_t;
+
+    // Still counts dangling edges, until compaction purges them.
+    [[nodiscard]]
+    auto live_edge_count() const -> size_t;
+
+    // Approximate heap bytes held by the graph, including indexes and cached adjacency.
+    [[nodiscard]]
+    auto memory_usage() const -> size_t;
+
+    [[nodiscard]]
+    auto tombstone_ratio() const -> double;
+
+    auto compact() -> void;
+
+    // Moves node order[i] to slot i, keeping node ids. Slots must be dense, i.e. the graph compacted.
+    auto reorder(const std::vector<uint32_t> &order) -> void;
+
+    // Writes live edges to a new generation of the edge store and maps it, switching the graph
+    // to mapped storage if it was not using it yet.
+    auto merge_edges() -> void;
+
+    // Reads the mapped edges back into memory and stops using the edge store.
+    auto unmap_edges() -> void;
+
+    // Whether the edge store reflects all edges and the current node slots, so its adjacency can be used.
+    [[nodiscard]]
+    auto edge_store_current() const -> bool;
+
+    // Whether the adjacency of the edge store with the changes since patched on top describes the graph:
+    // nodes were only appended, weights did not appear, and no stored edge waits for an appended node.
+    [[nodiscard]]
+    auto adjacency_patchable() const -> bool;
+
+    auto rebuild_indexes() -> void;
+
+    [[nodiscard]]
+    auto adjacency(Direction direction) const -> const Adjacency &;
+
+    auto invalidate_adjacency() -> void;
+
+    // Editor of the cached adjacency when it is patched over the edge store. Otherwise drops the cached
+    // adjacency, which is then built again on next use, and returns nothing.
+    auto adjacency_overlay() -> std::optional<AdjacencyOverlay>;
+
+    // In-memory slots of edges leaving node id from, tombstoned ones included.
+    [[nodiscard]]
+    auto edge_slots_from(int from) const -> std::vector<size_t>;
+
+    auto invalidate_edge_lookup() -> void;
+
+    // Reverses the recorded changes, latest first, and stops recording. Cached adjacency and the edge lookup
+    // are dropped rather than patched back, this only runs when a transaction fails.
+    auto undo_changes() -> void;
+
+    auto create_ordered_index(const std::string &field) -> bool;
+
+    auto create_ngram_index(const std::string &field) -> bool;
+
+    auto create_bitmap_index(const std::string &field) -> bool;
+
+    [[nodiscard]]
+    auto statistics_of(std::string_view field) const -> const FieldStatistics *;
+
+    auto index_node(size_t slot) -> void;
+
+    auto unindex_node(size_t slot) -> void;
+
+    [[nodiscard]]
+    auto live_nodes() const {
+        return std::views::iota(size_t{0}, nodes.size())
+               | std::views::filter([this](const size_t slot) { return !is_node_removed(slot); })
+               | std::views::transform([this](const size_t slot) -> const Node & { return nodes[slot]; });
+    }
+
+    [[nodiscard]]
+    auto live_edges() const {
+        return std::views::iota(size_t{0}, edges.size())
+               | std::views::filter([this](const size_t slot) {
+                   return !is_edge_removed(slot) && !is_edge_dangling(slot);
+               })
+               | std::views::transform([this](const size_t slot) -> const Edge & { return edges[slot]; });
+    }
 };
 
 struct DatabaseConfig {
     int unsynced_queries_limit{};
-
-    explicit DatabaseConfig(const int unsynced_queries_limit = 10) : unsynced_queries_limit(
-        unsynced_queries_limit) {
+    // Share of tombstoned nodes and edges after which the current graph gets compacted.
+    double compaction_threshold{};
+    // When set, metrics are written there in Prometheus text format every metrics_interval and on exit.
+    std::optional<std::string> metrics_path;
+    std::chrono::seconds metrics_interval{10};
+    // Heap bytes resident graphs may take before clean, least recently used ones are evicted. 0 means unlimited.
+    size_t memory_budget = 0;
+    // Edges a mapped graph keeps in memory before they are merged into its edge store.
+    size_t edge_delta_limit = 1 << 20;
+    // Read replica: follows the mutation log of a primary running in the same directory instead of
+    // writing the log and snapshot, and rejects mutations.
+    bool replica = false;
+    // How old the replica's view may get before a statement catches up with the log again. 0 means
+    // every statement does.
+    std::chrono::milliseconds max_staleness{0};
+
+    explicit DatabaseConfig(const int unsynced_queries_limit = 10, const double compaction_threshold = 0.25)
+        : unsynced_queries_limit(unsynced_queries_limit), compaction_threshold(compaction_threshold) {
     }
 };
 
@@ -166,6 +348,8 @@ struct Command {
 
 class Query {
     std::vector<Command> commands{};
+    // Statement as entered, written to the mutation log and parsed again on replay.
+    std::string text;
 
     inline static auto logger = Logger("Query");
 
@@ -189,11 +373,54 @@ class Query {
 
     auto handle_is_connected(const Database &db, bool direct) const -> void;
 
+    auto handle_delete_node(const Database &db) const -> void;
+
+    auto handle_delete_edge(const Database &db) const -> void;
+
+    auto handle_create_index(const Database &db) const -> void;
+
+    auto handle_set_storage(const Database &db) const -> void;
+
+    auto handle_reorder_graph(const Database &db) const -> void;
+
+    auto handle_select_aggregate(const Database &db) const -> void;
+
+    auto handle_neighbors(const Database &db, bool directed) const -> void;
+
+    auto handle_weighted_path(const Database &db, bool directed) const -> void;
+
+    auto handle_match(const Database &db) const -> void;
+
+    auto handle_analyze(const Database &db) const -> void;
+
+    static auto handle_stats(const Database &db) -> void;
+
+    auto handle_explain(const Database &db) const -> void;
+
+    auto handle_profile(Database &db) const -> void;
+
+    // Steps the statement would take on the current graph, without running it.
+    [[nodiscard]]
+    auto explain(const Database &db) const -> std::vector<std::string>;
+
+    static auto join_condition_words(const std::vector<std::string> &words, size_t begin,
+                                     size_t end) -> std::string;
+
+    static auto parse_aggregate_query(const std::vector<std::string> &words) -> Query;
+
+    static auto parse(const std::string &query) -> std::optional<Query>;
+
 public:
     auto handle(Database &db) const -> void;
 
     [[nodiscard]] auto get_commands() const -> const std::vector<Command> &;
 
+    [[nodiscard]] auto is_mutation() const -> bool;
+
+    [[nodiscard]] auto find_command(std::string_view keyword) const -> const Command *;
+
+    [[nodiscard]] auto get_text() const -> const std::string &;
+
     static auto from_string(const std::string &query) -> std::optional<Query>;
 };
 
@@ -206,17 +433,97 @@ class Database {
     static inline auto logger = Logger("Database");
 
     int unsynchronized_queries_count = 0;
+    // Set when the list of graphs changes.
+    bool catalog_dirty = false;
+
+    static constexpr auto snapshot_path = "database_snapshot.json";
+    static constexpr auto log_path = "database_mutations.log";
+
+    uint32_t checkpoint = 0;
+    MutationLog mutation_log{log_path};
+    // Mutations queued between BEGIN and COMMIT.
+    std::optional<std::vector<Query> > transaction;
+
+    std::chrono::steady_clock::time_point metrics_written_at = std::chrono::steady_clock::now();
+
+    uint64_t use_clock = 0;
+
+    // The snapshot the catalog offsets of unloaded graphs point into, held open for their lazy loads. The
+    // file at snapshot_path may be replaced meanwhile, by the primary if this is a replica.
+    mutable std::ifstream snapshot_file;
+
+    // Replica position: the snapshot file it restored from, identified by inode, and the log offset
+    // applied so far.
+    uint64_t snapshot_identity = 0;
+    size_t log_offset = 0;
+    size_t replicated_records = 0;
+    std::chrono::steady_clock::time_point caught_up_at{};
+
+    // Set by report_error while a statement runs, read back by execute_query. Handlers only get a const
+    // Database when they do not change it, and still have to report failures.
+    mutable bool statement_failed = false;
+
+    // Reads the catalog only, or the whole snapshot if it was written without one.
+    auto restore_snapshot() -> void;
+
+    auto enforce_memory_budget() -> void;
+
+    auto execute_statement(const Query &query) -> void;
+
+    [[nodiscard]]
+    auto graph_gauges() const -> std::vector<Metrics::GraphGauges>;
+
+    auto write_metrics() -> void;
+
+    auto handle_transaction(const std::string &keyword) -> void;
+
+    auto replay_log() -> void;
+
+    // Applies the statements of one record as the primary ran them. Returns the number applied.
+    auto apply_record(const LogRecord &record) -> size_t;
+
+    // Catches a replica up with the primary's log, restoring from the snapshot again if the primary
+    // wrote a new one.
+    auto follow_log() -> void;
+
+    auto record_for(std::vector<std::string> statements) const -> LogRecord;
+
+    // Counts applied mutations towards the next sync and compacts the current graph if needed.
+    auto after_mutations(int count) -> void;
+
+    [[nodiscard]]
+    auto has_unsynchronized_changes() const -> bool;
 
     auto sync_with_storage() -> void;
 
 public:
     int current_id = 0;
 
+    // Throws when the snapshot or the mutation log is damaged, rather than starting without their contents.
     explicit Database(DatabaseConfig config);
 
     ~Database();
 
-    auto execute_query(const Query &query) -> void;
+    // Returns false when the statement failed, after its handler printed why.
+    auto execute_query(const Query &query) -> bool;
+
+    // Prints why the running statement failed and marks it as failed.
+    auto report_error(const std::string &message) const -> void;
+
+    // Writes pending changes to the snapshot now instead of waiting for unsynced_queries_limit.
+    auto synchronize() -> void;
+
+    // Writes buffered log records, so replicas see them before the primary waits for input.
+    auto flush_log() -> void;
+
+    auto print_stats() const -> void;
+
+    // Checks the snapshot and the mutation log against their checksums without applying them, for --verify.
+    // Prints one line per part and returns false if any is damaged.
+    static auto verify_storage() -> bool;
+
+    [[nodiscard]]
+    auto has_graph() const -> bool;
 
     [[nodiscard]]
     auto get_graph() const -> Graph &;
@@ -227,9 +534,23 @@ public:
 
     auto set_graph(Graph &graph) -> void;
 
+    // Reads a graph listed in the catalog from its byte range in the snapshot, if it is not resident yet.
+    auto load_graph(Graph &graph) const -> void;
+
     auto add_node(Node &node) const -> void;
 
-    auto add_edge(Edge &edge) const -> void;
+    auto add_edge(Edge &edge, std::optional<float> weight = std::nullopt) const -> void;
+
+    auto remove_node(int id) const -> void;
+
+    auto remove_edge(int from, int to) const -> void;
+
+    auto create_index(const std::string &kind, const std::string &field) const -> void;
+
+    auto set_storage(bool mapped) const -> void;
+
+    // Relabels node slots of the current graph in a locality-improving order, see Reordering.
+    auto reorder_graph(const std::string &strategy) const -> void;
 };
 
 #endif //DATABASE_HPP
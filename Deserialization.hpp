@@ -5,63 +5,143 @@
 #ifndef DESERIALIZATION_HPP
 #define DESERIALIZATION_HPP
 
+#include "Base64.hpp"
+#include "Checksum.hpp"
+#include "EdgeEncoding.hpp"
+#include "EdgeStore.hpp"
 #include "Logger.hpp"
+#include "TextKernels.hpp"
 
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <optional>
 #include <string>
 #include <stdexcept>
 
+struct Snapshot {
+    // Incremented by every snapshot write. The mutation log records which checkpoint it extends.
+    uint32_t checkpoint = 0;
+    std::vector<Graph> graphs;
+    // Bytes of the whole file according to the catalog, 0 for snapshots without one.
+    size_t expected_size = 0;
+};
+
+// Entry of the catalog written ahead of the graphs. Offsets are relative to the start of the graphs array.
+struct CatalogEntry {
+    std::string name;
+    size_t offset = 0;
+    size_t length = 0;
+    std::optional<uint32_t> checksum;
+};
+
 struct Deserialization {
     inline static auto logger = Logger("Deserialization");
 
     static auto parse_string(const std::string &json, size_t &pos) -> std::string {
-        logger.debug(std::format("Deserialization of string started at pos {}", pos));
         if (json[pos] != '"') throw std::runtime_error(std::format("Expected string on pos {}", pos));
 
         ++pos;
         std::string result;
-        while (pos < json.size() && json[pos] != '"') {
-            if (json[pos] == '\\') {
-                ++pos;
-                if (pos >= json.size()) throw std::runtime_error("Invalid escape sequence in string");
-                switch (json[pos]) {
-                    case '"': result += '"';
-                        break;
-                    case '\\': result += '\\';
-                        break;
-                    case 'b': result += '\b';
-                        break;
-                    case 'f': result += '\f';
-                        break;
-                    case 'n': result += '\n';
-                        break;
-                    case 'r': result += '\r';
-                        break;
-                    case 't': result += '\t';
-                        break;
-                    default: throw std::runtime_error("Invalid escape sequence in string");
-                }
-            } else {
-                result += json[pos];
+        const auto *const end = json.data() + json.size();
+        while (pos < json.size()) {
+            // Plain runs are copied in bulk, only quotes and escapes are looked at.
+            const auto *special = TextKernels::find_first<TextKernels::QuoteOrBackslash>(json.data() + pos, end);
+            result.append(json.data() + pos, special);
+            pos = static_cast<size_t>(special - json.data());
+            if (pos >= json.size() || json[pos] == '"') {
+                break;
+            }
+
+            ++pos;
+            if (pos >= json.size()) throw std::runtime_error("Invalid escape sequence in string");
+            switch (json[pos]) {
+                case '"': result += '"';
+                    break;
+                case '\\': result += '\\';
+                    break;
+                case '/': result += '/';
+                    break;
+                case 'b': result += '\b';
+                    break;
+                case 'f': result += '\f';
+                    break;
+                case 'n': result += '\n';
+                    break;
+                case 'r': result += '\r';
+                    break;
+                case 't': result += '\t';
+                    break;
+                case 'u': append_unicode_escape(json, pos, result);
+                    break;
+                default: throw std::runtime_error("Invalid escape sequence in string");
             }
             ++pos;
         }
         if (pos >= json.size() || json[pos] != '"') throw std::runtime_error("Unterminated string");
         ++pos;
-        logger.debug("Successfully parsed string: " + result);
         return result;
     }
 
+    // \uXXXX with pos on the 'u', appended as UTF-8. Surrogate pairs are not combined.
+    static auto append_unicode_escape(const std::string &json, size_t &pos, std::string &out) -> void {
+        unsigned code = 0;
+        if (pos + 4 >= json.size() ||
+            std::from_chars(json.data() + pos + 1, json.data() + pos + 5, code, 16).ptr != json.data() + pos + 5) {
+            throw std::runtime_error("Invalid unicode escape in string");
+        }
+        pos += 4;
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xc0 | code >> 6);
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            out += static_cast<char>(0xe0 | code >> 12);
+            out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
     static auto parse_int(const std::string &json, size_t &pos) -> int {
         logger.debug(std::format("Deserialization for int started at pos {}", pos));
 
-        size_t end_pos;
-        const int value = std::stoi(json.substr(pos), &end_pos);
-        pos += end_pos;
+        // from_chars instead of stoi(json.substr(pos)), which copied the rest of the snapshot for every number.
+        while (pos < json.size() && isspace(json[pos])) ++pos;
+        int value;
+        const auto [end, error] = std::from_chars(json.data() + pos, json.data() + json.size(), value);
+        if (error != std::errc{}) throw std::runtime_error(std::format("Expected integer on pos {}", pos));
+        pos = static_cast<size_t>(end - json.data());
 
         logger.debug(std::format("Deserialization for int finished with {}", value));
         return value;
     }
 
+    static auto parse_size(const std::string &json, size_t &pos) -> size_t {
+        size_t value;
+        const auto [end, error] = std::from_chars(json.data() + pos, json.data() + json.size(), value);
+        if (error != std::errc{}) throw std::runtime_error(std::format("Expected size on pos {}", pos));
+        pos = static_cast<size_t>(end - json.data());
+        return value;
+    }
+
+    static auto parse_number(const std::string &json, size_t &pos) -> BasicValue {
+        auto end = pos;
+        while (end < json.size() && (isdigit(json[end]) || std::string_view("+-.eE").contains(json[end]))) ++end;
+
+        const auto token = std::string_view(json).substr(pos, end - pos);
+        if (token.find_first_of(".eE") == std::string_view::npos) {
+            return BasicValue(parse_int(json, pos));
+        }
+
+        double value;
+        const auto [end_ptr, error] = std::from_chars(json.data() + pos, json.data() + json.size(), value);
+        if (error != std::errc{}) throw std::runtime_error(std::format("Expected number on pos {}", pos));
+        pos = static_cast<size_t>(end_ptr - json.data());
+        logger.debug(std::format("Deserialization for double finished with {}", value));
+        return BasicValue(value);
+    }
+
     static auto parse_value(const std::string &json, size_t &pos) -> BasicValue {
         logger.debug(std::format("Deserialization for BasicValue started at pos {}", pos));
         while (pos < json.size() && isspace(json[pos])) ++pos;
@@ -70,7 +150,7 @@ struct Deserialization {
             return BasicValue(parse_string(json, pos));
         }
         if (isdigit(json[pos]) || json[pos] == '-') {
-            return BasicValue(parse_int(json, pos));
+            return parse_number(json, pos);
         }
         if (json.compare(pos, 4, "true") == 0) {
             pos += 4;
@@ -171,6 +251,101 @@ struct Deserialization {
         return edge;
     }
 
+    static auto parse_encoded_edges(const std::string &json, size_t &pos) -> std::vector<Edge> {
+        logger.debug(std::format("Deserialization for encoded edges started at pos {}", pos));
+        if (json[pos] != '{') throw std::runtime_error("Expected object");
+        ++pos;
+
+        EncodedEdges encoded;
+        while (pos < json.size() && json[pos] != '}') {
+            std::string key = parse_string(json, pos);
+            if (json[pos] != ':') throw std::runtime_error("Expected ':' after key");
+            ++pos;
+
+            if (key == "encoding") {
+                if (const auto encoding = parse_string(json, pos); encoding != EdgeEncoding::name) {
+                    throw std::runtime_error(std::format("Unsupported edge encoding {}", encoding));
+                }
+            } else if (key == "count") {
+                encoded.count = parse_size(json, pos);
+            } else if (key == "blocks") {
+                if (json[pos] != '[') throw std::runtime_error("Expected array");
+                ++pos;
+                while (pos < json.size() && json[pos] != ']') {
+                    if (json[pos] != '[') throw std::runtime_error("Expected array");
+                    ++pos;
+                    EdgeBlock block;
+                    block.first_source = parse_int(json, pos);
+                    if (json[pos] != ',') throw std::runtime_error("Expected ',' in edge block");
+                    ++pos;
+                    block.offset = parse_size(json, pos);
+                    if (json[pos] != ']') throw std::runtime_error("Unterminated array");
+                    ++pos;
+                    encoded.blocks.push_back(block);
+                    if (json[pos] == ',') ++pos;
+                }
+                if (pos >= json.size() || json[pos] != ']') throw std::runtime_error("Unterminated array");
+                ++pos;
+            } else if (key == "data") {
+                // Base64 never contains quotes or escapes, so the blob is sliced out directly.
+                if (json[pos] != '"') throw std::runtime_error("Expected string");
+                const auto end = json.find('"', pos + 1);
+                if (end == std::string::npos) throw std::runtime_error("Unterminated string");
+                encoded.data = Base64::decode(std::string_view(json).substr(pos + 1, end - pos - 1));
+                pos = end + 1;
+            }
+
+            if (json[pos] == ',') ++pos;
+        }
+        if (pos >= json.size() || json[pos] != '}') throw std::runtime_error("Unterminated object");
+        ++pos;
+
+        auto edges = EdgeEncoding::decode(encoded);
+        logger.debug(std::format("Deserialization for {} encoded edges finished", edges.size()));
+        return edges;
+    }
+
+    // Index definitions only, as {"field":...,"kind":...}. Content is rebuilt from nodes after loading.
+    static auto parse_index(const std::string &json, size_t &pos) -> std::pair<std::string, std::string> {
+        logger.debug(std::format("Deserialization for index started at pos {}", pos));
+        if (json[pos] != '{') throw std::runtime_error("Expected object");
+        ++pos;
+
+        std::string field;
+        std::string kind;
+        while (pos < json.size() && json[pos] != '}') {
+            std::string key = parse_string(json, pos);
+            if (json[pos] != ':') throw std::runtime_error("Expected ':' after key");
+            ++pos;
+
+            if (key == "field") {
+                field = parse_string(json, pos);
+            } else if (key == "kind") {
+                kind = parse_string(json, pos);
+            }
+
+            if (json[pos] == ',') ++pos;
+        }
+        if (pos >= json.size() || json[pos] != '}') throw std::runtime_error("Unterminated object");
+        ++pos;
+        return {field, kind};
+    }
+
+    static auto parse_edge_weights(const std::string &text) -> std::vector<float> {
+        const auto bytes = Base64::decode(text);
+        if (bytes.size() % sizeof(float) != 0) throw std::runtime_error("Truncated edge weights");
+        auto weights = std::vector<float>(bytes.size() / sizeof(float));
+        for (size_t i = 0; i < weights.size(); ++i) {
+            uint32_t bits;
+            std::memcpy(&bits, bytes.data() + i * sizeof(float), sizeof(float));
+            if constexpr (std::endian::native == std::endian::big) {
+                bits = std::byteswap(bits);
+            }
+            weights[i] = std::bit_cast<float>(bits);
+        }
+        return weights;
+    }
+
     static auto parse_graph(const std::string &json, size_t &pos) -> Graph {
         logger.debug(std::format("Parsing of graph started at pos {}", pos));
         if (json[pos] != '{') throw std::runtime_error("Expected object");
@@ -185,16 +360,23 @@ struct Deserialization {
             if (key == "name") {
                 graph.name = parse_string(json, pos);
                 ++pos;
+            } else if (key == "last_node_id") {
+                graph.last_node_id = static_cast<int>(parse_size(json, pos));
             } else if (key == "nodes") {
                 if (json[pos] != '[') throw std::runtime_error("Expected array");
                 ++pos;
                 while (pos < json.size() && json[pos] != ']') {
                     graph.nodes.push_back(parse_node(json, pos));
+                    // Snapshots written before last_node_id only know the ids of live nodes.
+                    graph.last_node_id = std::max(graph.last_node_id, graph.nodes.back().id);
                     if (json[pos] == ',') ++pos;
                 }
                 if (pos >= json.size() || json[pos] != ']') throw std::runtime_error("Unterminated array");
                 ++pos;
+            } else if (key == "edges" && json[pos] == '{') {
+                graph.edges = parse_encoded_edges(json, pos);
             } else if (key == "edges") {
+                // Snapshots written before EdgeEncoding store edges as an array of objects.
                 if (json[pos] != '[') throw std::runtime_error("Expected array");
                 ++pos;
                 while (pos < json.size() && json[pos] != ']') {
@@ -203,27 +385,155 @@ struct Deserialization {
                 }
                 if (pos >= json.size() || json[pos] != ']') throw std::runtime_error("Unterminated array");
                 ++pos;
+            } else if (key == "edge_store") {
+                graph.edge_store = EdgeStore::open(parse_string(json, pos));
+                graph.edges.map(graph.edge_store->edges());
+                graph.edge_weights.map(graph.edge_store->weights());
+                ++pos;
+            } else if (key == "edge_weights") {
+                graph.edge_weights = parse_edge_weights(parse_string(json, pos));
+                ++pos;
+            } else if (key == "indexes") {
+                if (json[pos] != '[') throw std::runtime_error("Expected array");
+                ++pos;
+                while (pos < json.size() && json[pos] != ']') {
+                    const auto [field, kind] = parse_index(json, pos);
+                    if (kind == "ORDERED") {
+                        graph.ordered_indexes.try_emplace(field);
+                    } else if (kind == "NGRAM") {
+                        graph.ngram_indexes.try_emplace(field);
+                    } else if (kind == "BITMAP") {
+                        graph.bitmap_indexes.try_emplace(field);
+                    }
+                    if (json[pos] == ',') ++pos;
+                }
+                if (pos >= json.size() || json[pos] != ']') throw std::runtime_error("Unterminated array");
+                ++pos;
             }
 
             if (json[pos] == ',') ++pos;
         }
         if (pos >= json.size() || json[pos] != '}') throw std::runtime_error("Unterminated object");
         ++pos;
+        if (!graph.edge_weights.empty() && graph.edge_weights.size() != graph.edges.size()) {
+            throw std::runtime_error("Edge weights do not match edges");
+        }
+        graph.rebuild_indexes();
         logger.info(std::format("Parsing finished for graph with name {} containing {} nodes and {} edges", graph.name,
                                 graph.nodes.size(), graph.edges.size()));
         return graph;
     }
 
-    static auto parse_graphs(const std::string &json) -> std::vector<Graph> {
+    static auto parse_catalog(const std::string &json, size_t &pos) -> std::vector<CatalogEntry> {
+        if (json[pos] != '[') throw std::runtime_error("Expected array");
+        ++pos;
+
+        auto catalog = std::vector<CatalogEntry>{};
+        while (pos < json.size() && json[pos] != ']') {
+            if (json[pos] != '{') throw std::runtime_error("Expected object");
+            ++pos;
+            auto &entry = catalog.emplace_back();
+            while (pos < json.size() && json[pos] != '}') {
+                const auto key = parse_string(json, pos);
+                if (json[pos] != ':') throw std::runtime_error("Expected ':' after key");
+                ++pos;
+                if (key == "name") {
+                    entry.name = parse_string(json, pos);
+                } else if (key == "offset") {
+                    entry.offset = parse_size(json, pos);
+                } else if (key == "length") {
+                    entry.length = parse_size(json, pos);
+                } else if (key == "crc") {
+                    entry.checksum = static_cast<uint32_t>(parse_size(json, pos));
+                } else {
+                    throw std::runtime_error(std::format("Unknown catalog key {}", key));
+                }
+                if (json[pos] == ',') ++pos;
+            }
+            if (pos >= json.size() || json[pos] != '}') throw std::runtime_error("Unterminated object");
+            ++pos;
+            if (json[pos] == ',') ++pos;
+        }
+        if (pos >= json.size() || json[pos] != ']') throw std::runtime_error("Unterminated array");
+        ++pos;
+        return catalog;
+    }
+
+    // Reads only the header of a snapshot, which ends with the opening bracket of the graphs array.
+    // Graphs are returned unloaded, with their byte ranges taken from the catalog. Snapshots written
+    // before the catalog existed have none, and are parsed entirely with parse_snapshot instead.
+    // The "checksum" key holds the CRC32C of the header up to that key.
+    static auto parse_snapshot_header(const std::string &header) -> std::optional<Snapshot> {
+        size_t pos = 0;
+        if (header.empty() || header[pos] != '{') throw std::runtime_error("Expected object");
+        ++pos;
+
+        auto snapshot = Snapshot{};
+        std::optional<std::vector<CatalogEntry> > catalog;
+        while (pos < header.size()) {
+            const auto key_start = pos;
+            const auto key = parse_string(header, pos);
+            if (header[pos] != ':') throw std::runtime_error("Expected ':' after key");
+            ++pos;
+            if (key == "checkpoint") {
+                snapshot.checkpoint = static_cast<uint32_t>(parse_int(header, pos));
+            } else if (key == "catalog") {
+                catalog = parse_catalog(header, pos);
+            } else if (key == "checksum") {
+                if (parse_size(header, pos) != Crc32c::of(std::string_view(header).substr(0, key_start))) {
+                    throw std::runtime_error("Snapshot header fails its checksum");
+                }
+            } else if (key == "graphs") {
+                if (header[pos] != '[') throw std::runtime_error("Expected array");
+                ++pos;
+                break;
+            } else {
+                throw std::runtime_error(std::format("Unknown snapshot key {}", key));
+            }
+            if (header[pos] == ',') ++pos;
+        }
+        if (!catalog) {
+            return std::nullopt;
+        }
+
+        // Graphs are followed by the closing "]}".
+        snapshot.expected_size = pos + 2;
+        for (auto &entry: *catalog) {
+            auto &graph = snapshot.graphs.emplace_back();
+            graph.name = std::move(entry.name);
+            graph.snapshot_offset = pos + entry.offset;
+            graph.snapshot_length = entry.length;
+            graph.snapshot_checksum = entry.checksum;
+            snapshot.expected_size = std::max(snapshot.expected_size,
+                                              graph.snapshot_offset + graph.snapshot_length + 2);
+            graph.dirty = false;
+            graph.resident = false;
+        }
+        logger.info(std::format("Catalog lists {} graph(s)", snapshot.graphs.size()));
+        return snapshot;
+    }
+
+    static auto parse_snapshot(const std::string &json) -> Snapshot {
         size_t pos = 0;
         logger.info("Parsing started for graphs");
 
         if (json[pos] != '{') throw std::runtime_error("Expected object");
         ++pos;
 
-        std::vector<Graph> graphs;
+        Snapshot snapshot;
+        auto &graphs = snapshot.graphs;
         while (pos < json.size() && json[pos] != '}') {
-            if (const std::string key = parse_string(json, pos); key == "graphs") {
+            const std::string key = parse_string(json, pos);
+            if (key == "checkpoint") {
+                if (json[pos] != ':') throw std::runtime_error("Expected ':' after key");
+                ++pos;
+                snapshot.checkpoint = static_cast<uint32_t>(parse_int(json, pos));
+            } else if (key == "catalog") {
+                // Byte ranges are taken while parsing the graphs below.
+                if (json[pos] != ':') throw std::runtime_error("Expected ':' after key");
+                ++pos;
+                parse_catalog(json, pos);
+            } else if (key == "graphs") {
                 if (json[pos] != ':') throw std::runtime_error("Expected ':' after key");
                 ++pos;
 
@@ -231,7 +541,12 @@ struct Deserialization {
                 ++pos;
 
                 while (pos < json.size() && json[pos] != ']') {
-                    graphs.emplace_back(parse_graph(json, pos));
+                    const auto offset = pos;
+                    auto &graph = graphs.emplace_back(parse_graph(json, pos));
+                    // Byte range of the graph in the snapshot, reused as long as the graph stays clean.
+                    graph.snapshot_offset = offset;
+                    graph.snapshot_length = pos - offset;
+                    graph.dirty = false;
                     if (json[pos] == ',') ++pos;
                 }
                 if (pos >= json.size() || json[pos] != ']') throw std::runtime_error("Unterminated array");
@@ -245,7 +560,7 @@ struct Deserialization {
         ++pos;
 
         logger.info(std::format("Parsing finished for {} graphs in total", graphs.size()));
-        return graphs;
+        return snapshot;
     }
 };
 
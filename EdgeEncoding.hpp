@@ -0,0 +1,236 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef EDGE_ENCODING_HPP
+#define EDGE_ENCODING_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Database.hpp"
+#include "Parallel.hpp"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define EDGE_ENCODING_SIMD 1
+#endif
+
+struct EdgeBlock {
+    // Source of the first edge in the block. Deltas restart at every block, so blocks decode independently.
+    int first_source{};
+    // Byte offset into EncodedEdges::data, which outgrows 32 bits at around two billion edges.
+    uint64_t offset{};
+};
+
+struct EncodedEdges {
+    static constexpr size_t block_size = 1024;
+
+    size_t count = 0;
+    std::vector<EdgeBlock> blocks;
+    std::string data;
+};
+
+// Edge list encoding of the snapshot. Edges are sorted by source and target and every edge becomes two
+// integers: the source delta to the previous edge, and the target delta to the previous target of the
+// same source (or the zigzagged distance to its own source when a new source starts). Both are mostly
+// tiny, so they are packed as group varint: one control byte holding four 2-bit lengths, followed by
+// four little-endian values of 1 to 4 bytes each. Builds with SSSE3 decode a whole group with one
+// byte shuffle picked by the control byte; the last groups of the data, where a 16-byte load would
+// run past the end, and builds without it use the scalar loop. Both read the same format.
+struct EdgeEncoding {
+    static constexpr std::string_view name = "delta-group-varint";
+
+    // Trailing bytes after the last group, so the decoder can always load four bytes at once.
+    static constexpr size_t padding = 3;
+
+    static auto encode(std::vector<Edge> edges) -> EncodedEdges {
+        std::ranges::sort(edges, [](const Edge &left, const Edge &right) {
+            return left.from != right.from ? left.from < right.from : left.to < right.to;
+        });
+
+        auto encoded = EncodedEdges{};
+        encoded.count = edges.size();
+        encoded.blocks.reserve((edges.size() + EncodedEdges::block_size - 1) / EncodedEdges::block_size);
+        encoded.data.reserve(edges.size() * 3 + padding);
+
+        auto values = std::vector<uint32_t>{};
+        values.reserve(EncodedEdges::block_size * 2);
+        for (size_t begin = 0; begin < edges.size(); begin += EncodedEdges::block_size) {
+            const auto end = std::min(edges.size(), begin + EncodedEdges::block_size);
+            encoded.blocks.push_back({edges[begin].from, encoded.data.size()});
+
+            values.clear();
+            auto previous = edges[begin];
+            for (auto i = begin; i < end; ++i) {
+                const auto &edge = edges[i];
+                values.push_back(static_cast<uint32_t>(edge.from) - static_cast<uint32_t>(previous.from));
+                values.push_back(i == begin || edge.from != previous.from
+                                     ? zigzag(static_cast<uint32_t>(edge.to) - static_cast<uint32_t>(edge.from))
+                                     : static_cast<uint32_t>(edge.to) - static_cast<uint32_t>(previous.to));
+                previous = edge;
+            }
+            append_groups(encoded.data, values);
+        }
+        encoded.data.append(padding, '\0');
+        return encoded;
+    }
+
+    static auto decode(const EncodedEdges &encoded) -> std::vector<Edge> {
+        const auto expected_blocks = (encoded.count + EncodedEdges::block_size - 1) / EncodedEdges::block_size;
+        if (encoded.blocks.size() != expected_blocks || encoded.data.size() < padding) {
+            throw std::runtime_error("Edge block index does not match edge count");
+        }
+
+        auto edges = std::vector<Edge>(encoded.count);
+        Parallel::for_chunks(encoded.blocks.size(), Parallel::workers_for(encoded.count),
+                             [&](const size_t begin, const size_t end, size_t) {
+                                 for (auto block = begin; block < end; ++block) {
+                                     const auto first = block * EncodedEdges::block_size;
+                                     const auto count = std::min(EncodedEdges::block_size, encoded.count - first);
+                                     decode_block(encoded, block, std::span(edges).subspan(first, count));
+                                 }
+                             });
+        return edges;
+    }
+
+    // Decodes one block into out, which must hold exactly the number of edges in that block.
+    static auto decode_block(const EncodedEdges &encoded, const size_t block, const std::span<Edge> out) -> void {
+        const auto *data = reinterpret_cast<const uint8_t *>(encoded.data.data());
+        const auto begin = static_cast<size_t>(encoded.blocks[block].offset);
+        const auto end = block + 1 < encoded.blocks.size()
+                             ? static_cast<size_t>(encoded.blocks[block + 1].offset)
+                             : encoded.data.size() - padding;
+        if (begin > end || end > encoded.data.size() - padding) {
+            throw std::runtime_error(std::format("Edge block {} has invalid offsets", block));
+        }
+
+        auto pos = begin;
+        auto source = static_cast<uint32_t>(encoded.blocks[block].first_source);
+        uint32_t target = 0;
+        std::array<uint32_t, 4> group{};
+        for (size_t i = 0; i < out.size(); i += 2) {
+            if (pos >= end || pos + group_size[data[pos]] > end) {
+                throw std::runtime_error(std::format("Edge block {} is truncated", block));
+            }
+            pos = decode_group(data, encoded.data.size(), pos, group);
+
+            for (size_t j = 0; j < 4 && i + j / 2 < out.size(); j += 2) {
+                if (group[j] != 0 || (i == 0 && j == 0)) {
+                    source += group[j];
+                    target = source + unzigzag(group[j + 1]);
+                } else {
+                    target += group[j + 1];
+                }
+                out[i + j / 2] = {static_cast<int>(source), static_cast<int>(target)};
+            }
+        }
+        if (pos != end) {
+            throw std::runtime_error(std::format("Edge block {} has trailing bytes", block));
+        }
+    }
+
+private:
+    static constexpr std::array<uint32_t, 4> masks{0xff, 0xffff, 0xffffff, 0xffffffff};
+
+    // Total encoded size of a group, control byte included, for every control byte.
+    static constexpr auto group_size = [] {
+        auto sizes = std::array<uint8_t, 256>{};
+        for (size_t control = 0; control < sizes.size(); ++control) {
+            sizes[control] = 1;
+            for (size_t i = 0; i < 4; ++i) {
+                sizes[control] += static_cast<uint8_t>((control >> (2 * i) & 3) + 1);
+            }
+        }
+        return sizes;
+    }();
+
+    static constexpr auto zigzag(const uint32_t value) -> uint32_t {
+        return value << 1 ^ static_cast<uint32_t>(static_cast<int32_t>(value) >> 31);
+    }
+
+    static constexpr auto unzigzag(const uint32_t value) -> uint32_t {
+        return value >> 1 ^ (0 - (value & 1));
+    }
+
+    static auto byte_length(const uint32_t value) -> uint8_t {
+        return value < 1u << 8 ? 1 : value < 1u << 16 ? 2 : value < 1u << 24 ? 3 : 4;
+    }
+
+    // Values past the end of the last group are encoded as zeros, the decoder knows the edge count.
+    static auto append_groups(std::string &out, const std::vector<uint32_t> &values) -> void {
+        for (size_t i = 0; i < values.size(); i += 4) {
+            const auto control_pos = out.size();
+            out += '\0';
+            uint8_t control = 0;
+            for (size_t j = 0; j < 4; ++j) {
+                const auto value = i + j < values.size() ? values[i + j] : 0;
+                const auto length = byte_length(value);
+                control |= static_cast<uint8_t>((length - 1) << (2 * j));
+                for (uint8_t byte = 0; byte < length; ++byte) {
+                    out += static_cast<char>(value >> (8 * byte) & 0xff);
+                }
+            }
+            out[control_pos] = static_cast<char>(control);
+        }
+    }
+
+#ifdef EDGE_ENCODING_SIMD
+    // shuffles[control] moves the value bytes of a group into four 32-bit lanes, zeroing the rest.
+    static constexpr auto shuffles = [] {
+        auto result = std::array<std::array<int8_t, 16>, 256>{};
+        for (size_t control = 0; control < result.size(); ++control) {
+            int8_t source = 0;
+            for (size_t i = 0; i < 4; ++i) {
+                const auto length = static_cast<int8_t>((control >> (2 * i) & 3) + 1);
+                for (int8_t byte = 0; byte < 4; ++byte) {
+                    result[control][4 * i + byte] = byte < length ? static_cast<int8_t>(source + byte) : -1;
+                }
+                source += length;
+            }
+        }
+        return result;
+    }();
+#endif
+
+    static auto decode_group(const uint8_t *data, const size_t size, size_t pos,
+                             std::array<uint32_t, 4> &group) -> size_t {
+#ifdef EDGE_ENCODING_SIMD
+        if (pos + 17 <= size) {
+            const auto control = data[pos];
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + 1));
+            const auto shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(shuffles[control].data()));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(group.data()), _mm_shuffle_epi8(bytes, shuffle));
+            return pos + group_size[control];
+        }
+#else
+        static_cast<void>(size);
+#endif
+        return decode_group_scalar(data, pos, group);
+    }
+
+    // Branch-free apart from the loop: each value is one unaligned 4-byte load masked to its length.
+    static auto decode_group_scalar(const uint8_t *data, size_t pos, std::array<uint32_t, 4> &group) -> size_t {
+        const auto control = data[pos++];
+        for (size_t i = 0; i < 4; ++i) {
+            const auto length_code = control >> (2 * i) & 3;
+            uint32_t value;
+            std::memcpy(&value, data + pos, sizeof(value));
+            if constexpr (std::endian::native == std::endian::big) {
+                value = std::byteswap(value);
+            }
+            group[i] = value & masks[length_code];
+            pos += length_code + 1;
+        }
+        return pos;
+    }
+};
+
+#endif //EDGE_ENCODING_HPP
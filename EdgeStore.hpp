@@ -0,0 +1,364 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef EDGE_STORE_HPP
+#define EDGE_STORE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Adjacency.hpp"
+#include "Checksum.hpp"
+#include "Database.hpp"
+#include "FileSync.hpp"
+#include "MappedFile.hpp"
+
+// Edges of a graph in mapped storage, kept in a file and memory-mapped instead of read into memory.
+// The file holds fixed-width edge records sorted by source and target, their weights, and CSR
+// adjacency over node slots for every direction, so traversals page in only the neighbourhoods they
+// touch. Files are never modified: merging changes writes the next generation next to the old one.
+//
+// Layout, every section aligned to 8 bytes: header, edges[edge_count], weights[edge_count] when
+// weighted, then per direction offsets[node_count + 1], targets[n] and, when weighted, weights[n].
+// The header carries the CRC32C of every section and of itself. Opening a store only checks the header
+// and the bounds it implies, so traversals keep paging in just what they touch; verify() reads the
+// whole file to check the sections and that no offset or target would lead outside it.
+class EdgeStore {
+    static constexpr std::array<char, 8> magic{'E', 'D', 'G', 'Y', 'E', 'D', 'G', '2'};
+    // Stores of earlier versions have no checksums, only their structure is checked.
+    static constexpr std::array<char, 8> unchecked_magic{'E', 'D', 'G', 'Y', 'E', 'D', 'G', '1'};
+    // Written in native byte order, a file from a host with other endianness fails the check.
+    static constexpr uint64_t byte_order_mark = 0x0102030405060708;
+    // Edges and weights, then offsets, targets and weights per direction.
+    static constexpr size_t section_count = 2 + 3 * 3;
+
+    struct Header {
+        std::array<char, 8> magic;
+        uint64_t byte_order;
+        uint64_t generation;
+        uint64_t node_count;
+        uint64_t edge_count;
+        uint64_t weighted;
+        std::array<uint64_t, 3> adjacency_edges;
+        std::array<uint32_t, section_count> checksums;
+        // Of the header bytes before it.
+        uint32_t header_checksum;
+    };
+
+    // Stores without checksums end their header before them.
+    static constexpr size_t unchecked_header_size = offsetof(Header, checksums);
+
+    struct Section {
+        size_t offset = 0;
+        size_t bytes = 0;
+    };
+
+    struct Layout {
+        size_t edges = 0;
+        size_t weights = 0;
+        std::array<size_t, 3> offsets{};
+        std::array<size_t, 3> targets{};
+        std::array<size_t, 3> adjacency_weights{};
+        // The same sections in file order, with their unpadded sizes.
+        std::array<Section, section_count> sections{};
+        size_t size = 0;
+    };
+
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "CSR offsets are stored as 64-bit integers");
+
+    std::string file_path;
+    MappedFile file;
+    Header header{};
+    Layout layout;
+
+    static auto aligned(const size_t bytes) -> size_t {
+        return (bytes + 7) & ~size_t{7};
+    }
+
+    static auto layout_of(const Header &header) -> Layout {
+        auto layout = Layout{};
+        auto cursor = aligned(header.magic == magic ? sizeof(Header) : unchecked_header_size);
+        size_t section = 0;
+        auto take = [&](const size_t bytes) {
+            const auto offset = cursor;
+            layout.sections[section++] = {offset, bytes};
+            cursor += aligned(bytes);
+            return offset;
+        };
+        const auto weighted = header.weighted != 0;
+        layout.edges = take(header.edge_count * sizeof(Edge));
+        layout.weights = take(weighted ? header.edge_count * sizeof(float) : 0);
+        for (size_t direction = 0; direction < 3; ++direction) {
+            layout.offsets[direction] = take((header.node_count + 1) * sizeof(size_t));
+            layout.targets[direction] = take(header.adjacency_edges[direction] * sizeof(uint32_t));
+            layout.adjacency_weights[direction] = take(weighted ? header.adjacency_edges[direction] * sizeof(float)
+                                                                : 0);
+        }
+        layout.size = cursor;
+        return layout;
+    }
+
+    static auto bytes_of(const MappedFile &file, const size_t offset, const size_t bytes) -> std::string_view {
+        return {reinterpret_cast<const char *>(file.data()) + offset, bytes};
+    }
+
+public:
+    // Graph names are used verbatim in statements, anything unusual is escaped in the file name.
+    static auto path_for(const std::string_view graph, const uint64_t generation) -> std::string {
+        auto path = std::string("database_edges_");
+        for (const auto c: graph) {
+            if (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-') {
+                path += c;
+            } else {
+                path += std::format("%{:02X}", static_cast<unsigned char>(c));
+            }
+        }
+        return std::format("{}.{}", path, generation);
+    }
+
+    static auto open(const std::string &path) -> std::shared_ptr<const EdgeStore> {
+        auto store = std::make_shared<EdgeStore>();
+        store->file_path = path;
+        store->file = MappedFile::open(path);
+        auto &header = store->header;
+        const auto size = store->file.size();
+        if (size < unchecked_header_size) {
+            throw std::runtime_error(std::format("Edge store {} is truncated", path));
+        }
+        std::memcpy(&header, store->file.data(), unchecked_header_size);
+        if ((header.magic != magic && header.magic != unchecked_magic) || header.byte_order != byte_order_mark) {
+            throw std::runtime_error(std::format("{} is not an edge store of this platform", path));
+        }
+        if (store->checksummed()) {
+            if (size < sizeof(Header)) {
+                throw std::runtime_error(std::format("Edge store {} is truncated", path));
+            }
+            std::memcpy(&header, store->file.data(), sizeof(Header));
+            if (Crc32c::of(bytes_of(store->file, 0, offsetof(Header, header_checksum))) != header.header_checksum) {
+                throw std::runtime_error(std::format("Edge store {} has a damaged header", path));
+            }
+        }
+        // Every count is bounded by the file size first, so the layout arithmetic cannot overflow.
+        constexpr auto outgoing = static_cast<size_t>(Direction::Outgoing);
+        constexpr auto incoming = static_cast<size_t>(Direction::Incoming);
+        constexpr auto both = static_cast<size_t>(Direction::Both);
+        const auto &adjacency_edges = header.adjacency_edges;
+        if (header.node_count >= size || header.edge_count >= size || adjacency_edges[outgoing] > header.edge_count ||
+            adjacency_edges[incoming] != adjacency_edges[outgoing] ||
+            adjacency_edges[both] != 2 * adjacency_edges[outgoing]) {
+            throw std::runtime_error(std::format("Edge store {} has a damaged header", path));
+        }
+        store->layout = layout_of(header);
+        if (size < store->layout.size) {
+            throw std::runtime_error(std::format("Edge store {} is truncated", path));
+        }
+        for (size_t direction = 0; direction < 3; ++direction) {
+            const auto offsets = store->file.array<const size_t>(store->layout.offsets[direction],
+                                                                 header.node_count + 1);
+            if (offsets.front() != 0 || offsets.back() != adjacency_edges[direction]) {
+                throw std::runtime_error(std::format("Edge store {} has damaged offsets in direction {}", path,
+                                                     direction));
+            }
+        }
+        return store;
+    }
+
+    // Writes live edges to a new store. for_each_edge(visit) must call visit(edge, weight) for every
+    // edge in (from, to) order and is run twice, once to count edges and degrees and once to place them.
+    // slot_of maps node ids to slots; edges with an endpoint without a slot are kept in the edge list
+    // but left out of the adjacency, as in Graph::adjacency.
+    template<typename ForEachEdge, typename SlotOf>
+    static auto write(const std::string &path, const uint64_t generation, const size_t node_count,
+                      const bool weighted, ForEachEdge for_each_edge, SlotOf slot_of) -> void {
+        auto header = Header{magic, byte_order_mark, generation, node_count, 0, weighted, {}};
+
+        constexpr auto outgoing = static_cast<size_t>(Direction::Outgoing);
+        constexpr auto incoming = static_cast<size_t>(Direction::Incoming);
+        constexpr auto both = static_cast<size_t>(Direction::Both);
+        auto offsets = std::array<std::vector<size_t>, 3>{};
+        for (auto &direction: offsets) {
+            direction.assign(node_count + 1, 0);
+        }
+        for_each_edge([&](const Edge &edge, float) {
+            ++header.edge_count;
+            const auto from = slot_of(edge.from);
+            const auto to = slot_of(edge.to);
+            if (from && to) {
+                ++offsets[outgoing][*from + 1];
+                ++offsets[incoming][*to + 1];
+                ++offsets[both][*from + 1];
+                ++offsets[both][*to + 1];
+            }
+        });
+        for (size_t direction = 0; direction < 3; ++direction) {
+            for (size_t slot = 0; slot < node_count; ++slot) {
+                offsets[direction][slot + 1] += offsets[direction][slot];
+            }
+            header.adjacency_edges[direction] = offsets[direction].back();
+        }
+
+        // Written under a temporary name, synced and renamed, so a crash never leaves a partial store behind
+        // and a snapshot naming the store is never on disk before it.
+        const auto edge_count = static_cast<size_t>(header.edge_count);
+        const auto layout = layout_of(header);
+        const auto temporary_path = path + ".tmp";
+        {
+            const auto output = MappedFile::create(temporary_path, layout.size);
+            const auto edges = output.array<Edge>(layout.edges, edge_count);
+            const auto weights = output.array<float>(layout.weights, weighted ? edge_count : 0);
+            auto targets = std::array<std::span<uint32_t>, 3>{};
+            auto target_weights = std::array<std::span<float>, 3>{};
+            for (size_t direction = 0; direction < 3; ++direction) {
+                std::ranges::copy(offsets[direction], output.array<size_t>(layout.offsets[direction],
+                                                                           node_count + 1).begin());
+                targets[direction] = output.array<uint32_t>(layout.targets[direction],
+                                                            header.adjacency_edges[direction]);
+                target_weights[direction] = output.array<float>(layout.adjacency_weights[direction],
+                                                                weighted ? header.adjacency_edges[direction] : 0);
+            }
+
+            // offsets turn into the insertion cursor of every slot.
+            size_t written = 0;
+            auto place = [&](const size_t direction, const size_t source, const uint32_t target, const float weight) {
+                const auto position = offsets[direction][source]++;
+                targets[direction][position] = target;
+                if (weighted) {
+                    target_weights[direction][position] = weight;
+                }
+            };
+            for_each_edge([&](const Edge &edge, const float weight) {
+                edges[written] = edge;
+                if (weighted) {
+                    weights[written] = weight;
+                }
+                ++written;
+                const auto from = slot_of(edge.from);
+                const auto to = slot_of(edge.to);
+                if (from && to) {
+                    place(outgoing, *from, *to, weight);
+                    place(incoming, *to, *from, weight);
+                    place(both, *from, *to, weight);
+                    place(both, *to, *from, weight);
+                }
+            });
+            if (written != edge_count) {
+                throw std::logic_error(std::format("Edge store expected {} edges, got {}", edge_count, written));
+            }
+
+            for (size_t section = 0; section < section_count; ++section) {
+                const auto [offset, bytes] = layout.sections[section];
+                header.checksums[section] = Crc32c::of(bytes_of(output, offset, bytes));
+            }
+            header.header_checksum = Crc32c::of(std::string_view(reinterpret_cast<const char *>(&header),
+                                                                 offsetof(Header, header_checksum)));
+            std::memcpy(output.data(), &header, sizeof(Header));
+        }
+        FileSync::file(temporary_path);
+        std::filesystem::rename(temporary_path, path);
+        FileSync::directory_of(path);
+    }
+
+    // Checks every section against its checksum, then that the offsets of every direction never decrease
+    // and every target is a slot. Reads the whole file, so it is left to --verify.
+    auto verify() const -> void {
+        if (checksummed()) {
+            for (size_t section = 0; section < section_count; ++section) {
+                const auto [offset, bytes] = layout.sections[section];
+                if (Crc32c::of(bytes_of(file, offset, bytes)) != header.checksums[section]) {
+                    throw std::runtime_error(std::format("Edge store {} fails the checksum of section {}", file_path,
+                                                         section));
+                }
+            }
+        }
+        for (size_t direction = 0; direction < 3; ++direction) {
+            const auto offsets = file.array<const size_t>(layout.offsets[direction], header.node_count + 1);
+            if (!std::ranges::is_sorted(offsets)) {
+                throw std::runtime_error(std::format("Edge store {} has damaged offsets in direction {}",
+                                                     file_path, direction));
+            }
+            const auto targets = file.array<const uint32_t>(layout.targets[direction],
+                                                            header.adjacency_edges[direction]);
+            if (std::ranges::any_of(targets, [this](const uint32_t target) { return target >= header.node_count; })) {
+                throw std::runtime_error(std::format("Edge store {} has a target past its {} slot(s) in direction {}",
+                                                     file_path, header.node_count, direction));
+            }
+        }
+    }
+
+    [[nodiscard]]
+    auto path() const -> const std::string & {
+        return file_path;
+    }
+
+    [[nodiscard]]
+    auto generation() const -> uint64_t {
+        return header.generation;
+    }
+
+    // Node slots the adjacency was built for.
+    [[nodiscard]]
+    auto node_count() const -> size_t {
+        return header.node_count;
+    }
+
+    // False for stores written before sections carried checksums.
+    [[nodiscard]]
+    auto checksummed() const -> bool {
+        return header.magic == magic;
+    }
+
+    [[nodiscard]]
+    auto weighted() const -> bool {
+        return header.weighted != 0;
+    }
+
+    // Whether every stored edge is in the adjacency, i.e. none names a node that had no slot yet.
+    [[nodiscard]]
+    auto adjacency_complete() const -> bool {
+        return header.adjacency_edges[static_cast<size_t>(Direction::Outgoing)] == header.edge_count;
+    }
+
+    [[nodiscard]]
+    auto size_bytes() const -> size_t {
+        return file.size();
+    }
+
+    [[nodiscard]]
+    auto edges() const -> std::span<const Edge> {
+        return file.array<const Edge>(layout.edges, header.edge_count);
+    }
+
+    // Empty when the store has no weights and every edge weighs 1.
+    [[nodiscard]]
+    auto weights() const -> std::span<const float> {
+        return file.array<const float>(layout.weights, header.weighted ? header.edge_count : 0);
+    }
+
+    // CSR view straight over the file. The view shares ownership of the store.
+    static auto adjacency(const std::shared_ptr<const EdgeStore> &store, const Direction direction) -> Adjacency {
+        const auto index = static_cast<size_t>(direction);
+        const auto &header = store->header;
+        const auto &layout = store->layout;
+        return Adjacency::view(store->file.array<const size_t>(layout.offsets[index], header.node_count + 1),
+                               store->file.array<const uint32_t>(layout.targets[index],
+                                                                 header.adjacency_edges[index]),
+                               store->file.array<const float>(layout.adjacency_weights[index],
+                                                              header.weighted ? header.adjacency_edges[index] : 0),
+                               store);
+    }
+};
+
+#endif //EDGE_STORE_HPP
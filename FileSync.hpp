@@ -0,0 +1,49 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef FILE_SYNC_HPP
+#define FILE_SYNC_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// fsync for files written under a temporary name and renamed into place. Their data has to be on disk
+// before the rename makes them visible, and the rename has to be before anything that relies on the new
+// file, such as truncating the mutation log the snapshot replaces.
+struct FileSync {
+    // Flushes the data of the file at path, including pages written through a mapping.
+    static auto file(const std::string &path) -> void {
+        sync(path, path, O_RDONLY);
+    }
+
+    // Flushes the directory entries of the directory holding path, e.g. a rename into it.
+    static auto directory_of(const std::string &path) -> void {
+        const auto directory = std::filesystem::path(path).parent_path();
+        sync(directory.empty() ? std::string(".") : directory.string(), path, O_RDONLY | O_DIRECTORY);
+    }
+
+private:
+    static auto sync(const std::string &target, const std::string &path, const int flags) -> void {
+        const auto descriptor = ::open(target.c_str(), flags | O_CLOEXEC);
+        if (descriptor < 0) {
+            throw std::runtime_error(std::format("Failed to open {} to sync {}: {}", target, path,
+                                                 std::strerror(errno)));
+        }
+        const auto result = ::fsync(descriptor);
+        const auto error = errno;
+        ::close(descriptor);
+        if (result != 0) {
+            throw std::runtime_error(std::format("Failed to sync {}: {}", target, std::strerror(error)));
+        }
+    }
+};
+
+#endif //FILE_SYNC_HPP
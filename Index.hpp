@@ -0,0 +1,460 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef INDEX_HPP
+#define INDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Bitmap.hpp"
+#include "Value.hpp"
+
+struct IndexBound {
+    BasicValue value;
+    bool inclusive = true;
+};
+
+// Secondary index on one field of complex nodes, mapping values to node slots.
+// Entries live in a sorted run plus a small unsorted delta buffer, so inserts are cheap and a
+// range lookup costs O(log n + k) plus a scan of the delta, which never grows past ~sqrt(n).
+// Erasing a run entry only tombstones it, the run is compacted with the next merge, so updates
+// and deletes are as cheap as inserts.
+class OrderedIndex {
+public:
+    using Entry = std::pair<BasicValue, size_t>;
+
+private:
+    std::vector<Entry> run;
+    std::vector<Entry> delta;
+    // Tombstones of run entries by position, empty while there are none.
+    std::vector<bool> erased;
+    size_t erased_count = 0;
+    // Running number of entries per distinct value, answering equality counts in O(1).
+    std::unordered_map<BasicValue::Data, size_t> counts;
+
+    static auto entry_less(const Entry &left, const Entry &right) -> bool {
+        if (const auto order = left.first <=> right.first; order != 0) {
+            return order < 0;
+        }
+        return left.second < right.second;
+    }
+
+    [[nodiscard]]
+    auto delta_limit() const -> size_t {
+        return std::max<size_t>(64, static_cast<size_t>(std::sqrt(static_cast<double>(run.size()))));
+    }
+
+    auto merge_delta() -> void {
+        if (erased_count > 0) {
+            size_t kept = 0;
+            for (size_t position = 0; position < run.size(); ++position) {
+                if (!erased[position]) {
+                    run[kept++] = std::move(run[position]);
+                }
+            }
+            run.resize(kept);
+            erased.clear();
+            erased_count = 0;
+        }
+        std::ranges::sort(delta, entry_less);
+        const auto middle = run.size();
+        run.insert(run.end(), std::make_move_iterator(delta.begin()), std::make_move_iterator(delta.end()));
+        std::inplace_merge(run.begin(), run.begin() + static_cast<std::ptrdiff_t>(middle), run.end(), entry_less);
+        delta.clear();
+    }
+
+    [[nodiscard]]
+    static auto within(const BasicValue &key, const std::optional<IndexBound> &lower,
+                       const std::optional<IndexBound> &upper) -> bool {
+        const auto &bound = lower ? lower->value : upper->value;
+        if (!key.is_comparable_with(bound)) {
+            return false;
+        }
+        if (lower) {
+            const auto order = key <=> lower->value;
+            if (order < 0 || (order == 0 && !lower->inclusive)) {
+                return false;
+            }
+        }
+        if (upper) {
+            const auto order = key <=> upper->value;
+            if (order > 0 || (order == 0 && !upper->inclusive)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    auto forget(const BasicValue &key) -> void {
+        if (const auto it = counts.find(key.data); it != counts.end() && --it->second == 0) {
+            counts.erase(it);
+        }
+    }
+
+    [[nodiscard]]
+    static auto lowest_comparable_with(const BasicValue &value) -> BasicValue {
+        switch (value.rank()) {
+            case 0: return BasicValue(false);
+            case 1: return BasicValue(-std::numeric_limits<double>::infinity());
+            default: return BasicValue(std::string{});
+        }
+    }
+
+public:
+    auto insert(const BasicValue &key, const size_t slot) -> void {
+        ++counts[key.data];
+        delta.emplace_back(key, slot);
+        if (delta.size() > delta_limit()) {
+            merge_delta();
+        }
+    }
+
+    auto erase(const BasicValue &key, const size_t slot) -> void {
+        const auto in_delta = std::ranges::find_if(delta, [&](const Entry &entry) {
+            return entry.second == slot && entry.first == key;
+        });
+        if (in_delta != delta.end()) {
+            forget(in_delta->first);
+            *in_delta = std::move(delta.back());
+            delta.pop_back();
+            return;
+        }
+        const auto entry = Entry{key, slot};
+        const auto it = std::ranges::lower_bound(run, entry, entry_less);
+        if (it == run.end() || it->second != slot || it->first != key) {
+            return;
+        }
+        const auto position = static_cast<size_t>(it - run.begin());
+        if (erased.empty()) {
+            erased.resize(run.size());
+        } else if (erased[position]) {
+            return;
+        }
+        forget(it->first);
+        erased[position] = true;
+        if (++erased_count > delta_limit()) {
+            merge_delta();
+        }
+    }
+
+    // Replaces the whole content in one sort instead of entries.size() inserts.
+    auto assign(std::vector<Entry> entries) -> void {
+        run = std::move(entries);
+        delta.clear();
+        erased.clear();
+        erased_count = 0;
+        std::ranges::sort(run, entry_less);
+        counts.clear();
+        for (const auto &key: run | std::views::keys) {
+            ++counts[key.data];
+        }
+    }
+
+    auto clear() -> void {
+        run.clear();
+        delta.clear();
+        erased.clear();
+        erased_count = 0;
+        counts.clear();
+    }
+
+    // Number of entries equal to key. Ints and doubles holding the same number are counted together.
+    [[nodiscard]]
+    auto count_equal(const BasicValue &key) const -> size_t {
+        auto count_of = [this](const BasicValue::Data &data) {
+            const auto it = counts.find(data);
+            return it == counts.end() ? size_t{0} : it->second;
+        };
+
+        auto total = count_of(key.data);
+        if (std::holds_alternative<int>(key.data)) {
+            total += count_of(static_cast<double>(std::get<int>(key.data)));
+        } else if (const auto *number = std::get_if<double>(&key.data);
+            number != nullptr && std::trunc(*number) == *number &&
+            std::abs(*number) <= std::numeric_limits<int>::max()) {
+            total += count_of(static_cast<int>(*number));
+        }
+        return total;
+    }
+
+    [[nodiscard]]
+    auto value_counts() const -> const std::unordered_map<BasicValue::Data, size_t> & {
+        return counts;
+    }
+
+    [[nodiscard]]
+    auto size() const -> size_t {
+        return run.size() - erased_count + delta.size();
+    }
+
+    // Approximate heap bytes, for memory accounting. String keys are counted by their inline part only.
+    [[nodiscard]]
+    auto memory_usage() const -> size_t {
+        return (run.capacity() + delta.capacity()) * sizeof(Entry) + erased.capacity() / 8
+               + counts.size() * (sizeof(std::pair<const BasicValue::Data, size_t>) + sizeof(void *))
+               + counts.bucket_count() * sizeof(void *);
+    }
+
+    // Visits slots of all entries between the bounds. At least one bound must be given and only keys
+    // comparable with it are visited, so a numeric range never returns strings.
+    template<typename Visitor>
+    auto for_each_in_range(const std::optional<IndexBound> &lower, const std::optional<IndexBound> &upper,
+                           Visitor visit) const -> void {
+        const auto &anchor = lower ? lower->value : upper->value;
+
+        const auto start = lower ? lower->value : lowest_comparable_with(anchor);
+        auto it = std::ranges::lower_bound(run, start, [](const BasicValue &left, const BasicValue &right) {
+            return (left <=> right) < 0;
+        }, &Entry::first);
+
+        for (; it != run.end(); ++it) {
+            if (!it->first.is_comparable_with(anchor)) {
+                break;
+            }
+            if (upper) {
+                const auto order = it->first <=> upper->value;
+                if (order > 0 || (order == 0 && !upper->inclusive)) {
+                    break;
+                }
+            }
+            if (lower && !lower->inclusive && it->first == lower->value) {
+                continue;
+            }
+            if (!erased.empty() && erased[static_cast<size_t>(it - run.begin())]) {
+                continue;
+            }
+            visit(it->second);
+        }
+
+        for (const auto &[key, slot]: delta) {
+            if (within(key, lower, upper)) {
+                visit(slot);
+            }
+        }
+    }
+};
+
+// Substring index on one string field, mapping every trigram (3 consecutive bytes) of a value to the
+// sorted slots of nodes containing it. A pattern of at least 3 bytes can only occur in values holding
+// all of its trigrams, so intersecting their posting lists yields candidates that are checked against
+// the condition afterwards. Shorter patterns can not be answered and fall back to a scan.
+class NgramIndex {
+    // Slots are stored as 32 bits like in the CSR adjacency, posting lists hold an entry per trigram.
+    std::unordered_map<uint32_t, std::vector<uint32_t> > postings;
+    size_t entries = 0;
+
+    static auto gram_at(const std::string_view text, const size_t position) -> uint32_t {
+        return static_cast<uint32_t>(static_cast<unsigned char>(text[position])) << 16 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[position + 1])) << 8 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[position + 2]));
+    }
+
+    // Distinct trigrams of the text, sorted.
+    static auto grams_of(const std::string_view text) -> std::vector<uint32_t> {
+        auto grams = std::vector<uint32_t>{};
+        if (text.size() < gram_size) {
+            return grams;
+        }
+        grams.reserve(text.size() - gram_size + 1);
+        for (size_t position = 0; position + gram_size <= text.size(); ++position) {
+            grams.push_back(gram_at(text, position));
+        }
+        std::ranges::sort(grams);
+        grams.erase(std::ranges::unique(grams).begin(), grams.end());
+        return grams;
+    }
+
+public:
+    static constexpr size_t gram_size = 3;
+
+    [[nodiscard]]
+    static auto can_answer(const std::string_view pattern) -> bool {
+        return pattern.size() >= gram_size;
+    }
+
+    // Only string values are indexed, other kinds never match a text pattern.
+    auto insert(const BasicValue &key, const size_t slot) -> void {
+        const auto *text = std::get_if<std::string>(&key.data);
+        if (text == nullptr) {
+            return;
+        }
+        for (const auto gram: grams_of(*text)) {
+            auto &posting = postings[gram];
+            // New nodes get the highest slot, so this is an append unless an older node is updated.
+            posting.insert(std::ranges::upper_bound(posting, static_cast<uint32_t>(slot)), static_cast<uint32_t>(slot));
+        }
+        ++entries;
+    }
+
+    auto erase(const BasicValue &key, const size_t slot) -> void {
+        const auto *text = std::get_if<std::string>(&key.data);
+        if (text == nullptr) {
+            return;
+        }
+        for (const auto gram: grams_of(*text)) {
+            const auto it = postings.find(gram);
+            if (it == postings.end()) {
+                continue;
+            }
+            auto &posting = it->second;
+            if (const auto position = std::ranges::lower_bound(posting, static_cast<uint32_t>(slot));
+                position != posting.end() && *position == slot) {
+                posting.erase(position);
+            }
+            if (posting.empty()) {
+                postings.erase(it);
+            }
+        }
+        --entries;
+    }
+
+    // Replaces the whole content, building every posting list in slot order.
+    auto assign(const std::vector<std::pair<BasicValue, size_t> > &values) -> void {
+        clear();
+        auto sorted = values;
+        std::ranges::sort(sorted, {}, &std::pair<BasicValue, size_t>::second);
+        for (const auto &[key, slot]: sorted) {
+            insert(key, slot);
+        }
+    }
+
+    auto clear() -> void {
+        postings.clear();
+        entries = 0;
+    }
+
+    // Number of indexed string values.
+    [[nodiscard]]
+    auto size() const -> size_t {
+        return entries;
+    }
+
+    // Length of the shortest posting list of the pattern, an upper bound of its matches.
+    [[nodiscard]]
+    auto estimate(const std::string_view pattern) const -> size_t {
+        auto shortest = entries;
+        for (const auto gram: grams_of(pattern)) {
+            const auto it = postings.find(gram);
+            shortest = std::min(shortest, it == postings.end() ? size_t{0} : it->second.size());
+        }
+        return shortest;
+    }
+
+    // Sorted slots of values containing every trigram of the pattern. The pattern must be answerable.
+    [[nodiscard]]
+    auto candidates(const std::string_view pattern) const -> std::vector<size_t> {
+        auto lists = std::vector<const std::vector<uint32_t> *>{};
+        for (const auto gram: grams_of(pattern)) {
+            const auto it = postings.find(gram);
+            if (it == postings.end()) {
+                return {};
+            }
+            lists.push_back(&it->second);
+        }
+        // Intersecting from the shortest list keeps every intermediate result small.
+        std::ranges::sort(lists, {}, [](const auto *list) { return list->size(); });
+        auto result = *lists.front();
+        auto next = std::vector<uint32_t>{};
+        for (const auto *list: lists | std::views::drop(1)) {
+            if (result.empty()) {
+                break;
+            }
+            next.clear();
+            std::ranges::set_intersection(result, *list, std::back_inserter(next));
+            result.swap(next);
+        }
+        return {result.begin(), result.end()};
+    }
+
+    // Approximate heap bytes, for memory accounting.
+    [[nodiscard]]
+    auto memory_usage() const -> size_t {
+        size_t bytes = postings.bucket_count() * sizeof(void *);
+        for (const auto &posting: postings | std::views::values) {
+            bytes += sizeof(std::pair<const uint32_t, std::vector<uint32_t> >) + sizeof(void *)
+                    + posting.capacity() * sizeof(uint32_t);
+        }
+        return bytes;
+    }
+};
+
+// Index on a low-cardinality field, holding one compressed bitmap of node slots per distinct value.
+// A condition of any comparator is answered as the union of the bitmaps of matching values, and
+// conditions combine by intersecting and uniting bitmaps without reading nodes.
+class BitmapIndex {
+    std::unordered_map<BasicValue::Data, Bitmap> bitmaps;
+    size_t entries = 0;
+
+public:
+    auto insert(const BasicValue &key, const size_t slot) -> void {
+        bitmaps[key.data].add(static_cast<uint32_t>(slot));
+        ++entries;
+    }
+
+    auto erase(const BasicValue &key, const size_t slot) -> void {
+        const auto it = bitmaps.find(key.data);
+        if (it == bitmaps.end()) {
+            return;
+        }
+        it->second.remove(static_cast<uint32_t>(slot));
+        if (it->second.empty()) {
+            bitmaps.erase(it);
+        }
+        --entries;
+    }
+
+    auto assign(const std::vector<std::pair<BasicValue, size_t> > &values) -> void {
+        clear();
+        auto sorted = values;
+        std::ranges::sort(sorted, {}, &std::pair<BasicValue, size_t>::second);
+        for (const auto &[key, slot]: sorted) {
+            insert(key, slot);
+        }
+    }
+
+    auto clear() -> void {
+        bitmaps.clear();
+        entries = 0;
+    }
+
+    [[nodiscard]]
+    auto size() const -> size_t {
+        return entries;
+    }
+
+    [[nodiscard]]
+    auto distinct_values() const -> size_t {
+        return bitmaps.size();
+    }
+
+    // Calls visit(value, slots) for every distinct value.
+    template<typename Visitor>
+    auto for_each_value(Visitor visit) const -> void {
+        for (const auto &[data, slots]: bitmaps) {
+            visit(BasicValue{data}, slots);
+        }
+    }
+
+    // Approximate heap bytes, for memory accounting.
+    [[nodiscard]]
+    auto memory_usage() const -> size_t {
+        size_t bytes = bitmaps.bucket_count() * sizeof(void *);
+        for (const auto &slots: bitmaps | std::views::values) {
+            bytes += sizeof(std::pair<const BasicValue::Data, Bitmap>) + sizeof(void *) + slots.memory_usage();
+        }
+        return bytes;
+    }
+};
+
+#endif //INDEX_HPP
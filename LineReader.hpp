@@ -0,0 +1,69 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef LINE_READER_HPP
+#define LINE_READER_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Reads lines from a file in large blocks instead of one getline per statement.
+// Handles both \n and \r\n endings and a last line without a newline.
+class LineReader {
+    static constexpr size_t block_size = 1 << 20;
+
+    std::FILE *file;
+    std::vector<char> buffer = std::vector<char>(block_size);
+    size_t begin = 0;
+    size_t end = 0;
+    bool exhausted = false;
+
+    auto refill() -> void {
+        const auto read = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+        end += read;
+        exhausted = read == 0;
+    }
+
+public:
+    explicit LineReader(std::FILE *file) : file(file) {
+    }
+
+    auto next(std::string &line) -> bool {
+        line.clear();
+        while (true) {
+            const auto *const start = buffer.data() + begin;
+            if (const auto *newline = static_cast<const char *>(std::memchr(start, '\n', end - begin))) {
+                line.append(start, newline);
+                begin += static_cast<size_t>(newline - start) + 1;
+                break;
+            }
+            if (exhausted) {
+                if (begin == end && line.empty()) {
+                    return false;
+                }
+                line.append(start, end - begin);
+                begin = end;
+                break;
+            }
+
+            // Keep the partial line at the front of the buffer, grow it only for lines longer than a block.
+            std::memmove(buffer.data(), start, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            refill();
+        }
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        return true;
+    }
+};
+
+#endif //LINE_READER_HPP
@@ -13,6 +13,8 @@ class Logger {
     std::string name;
     fmt::rgb name_color;
     inline static int log_level = 0;
+    // Suppresses INFO messages, e.g. in batch mode where they would be printed for every statement.
+    inline static bool quiet = false;
 
     static auto generate_color_from_name(const std::string &name) -> fmt::rgb {
         constexpr std::hash<std::string> hasher;
@@ -51,7 +53,14 @@ public:
         log_level = level;
     }
 
+    static auto set_quiet(const bool value) -> void {
+        quiet = value;
+    }
+
     auto info(const std::string &message) const -> void {
+        if (quiet) {
+            return;
+        }
         print_with_color("INFO", fmt::color::light_green, message);
     }
 
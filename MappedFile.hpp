@@ -0,0 +1,205 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Memory mapping of a whole file. Pages are read on first access and can be dropped again by the
+// OS at any time, so the mapped data does not need to fit in RAM.
+class MappedFile {
+    std::byte *address = nullptr;
+    size_t length = 0;
+
+    MappedFile(std::byte *address, const size_t length) : address(address), length(length) {
+    }
+
+    static auto fail(const std::string_view action, const std::string &path) -> std::runtime_error {
+        return std::runtime_error(std::format("Failed to {} {}: {}", action, path, std::strerror(errno)));
+    }
+
+    static auto map(const int descriptor, const size_t length, const int protection, const std::string &path)
+        -> MappedFile {
+        if (length == 0) {
+            ::close(descriptor);
+            return {};
+        }
+        void *address = ::mmap(nullptr, length, protection, MAP_SHARED, descriptor, 0);
+        // The mapping keeps its own reference to the file.
+        ::close(descriptor);
+        if (address == MAP_FAILED) {
+            throw fail("map", path);
+        }
+        return {static_cast<std::byte *>(address), length};
+    }
+
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+    MappedFile(MappedFile &&other) noexcept
+        : address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0)) {
+    }
+
+    auto operator=(MappedFile &&other) noexcept -> MappedFile & {
+        std::swap(address, other.address);
+        std::swap(length, other.length);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (address != nullptr) {
+            ::munmap(address, length);
+        }
+    }
+
+    static auto open(const std::string &path) -> MappedFile {
+        const auto descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0) {
+            throw fail("open", path);
+        }
+        struct stat status{};
+        if (::fstat(descriptor, &status) != 0) {
+            ::close(descriptor);
+            throw fail("stat", path);
+        }
+        return map(descriptor, static_cast<size_t>(status.st_size), PROT_READ, path);
+    }
+
+    // Creates or truncates the file to length bytes and maps it writable.
+    static auto create(const std::string &path, const size_t length) -> MappedFile {
+        const auto descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (descriptor < 0) {
+            throw fail("create", path);
+        }
+        if (::ftruncate(descriptor, static_cast<off_t>(length)) != 0) {
+            ::close(descriptor);
+            throw fail("resize", path);
+        }
+        return map(descriptor, length, PROT_READ | PROT_WRITE, path);
+    }
+
+    [[nodiscard]]
+    auto data() const -> std::byte * {
+        return address;
+    }
+
+    [[nodiscard]]
+    auto size() const -> size_t {
+        return length;
+    }
+
+    template<typename T>
+    [[nodiscard]]
+    auto array(const size_t offset, const size_t count) const -> std::span<T> {
+        return {reinterpret_cast<T *>(address + offset), count};
+    }
+};
+
+// Read-only base segment, usually mapped, followed by an in-memory delta that takes all appends.
+// Without a base it behaves like a plain vector.
+template<typename T>
+class SegmentedVector {
+    std::span<const T> base;
+    std::vector<T> delta;
+
+public:
+    SegmentedVector() = default;
+
+    auto operator=(std::vector<T> values) -> SegmentedVector & {
+        base = {};
+        delta = std::move(values);
+        return *this;
+    }
+
+    // Replaces the content with a base segment, dropping the delta.
+    auto map(const std::span<const T> segment) -> void {
+        base = segment;
+        delta.clear();
+        delta.shrink_to_fit();
+    }
+
+    // Copies the base segment into memory, so nothing references the mapping afterwards.
+    auto materialize() -> void {
+        if (base.empty()) {
+            return;
+        }
+        auto values = std::vector<T>(base.begin(), base.end());
+        values.insert(values.end(), delta.begin(), delta.end());
+        *this = std::move(values);
+    }
+
+    [[nodiscard]]
+    auto size() const -> size_t {
+        return base.size() + delta.size();
+    }
+
+    [[nodiscard]]
+    auto empty() const -> bool {
+        return base.empty() && delta.empty();
+    }
+
+    [[nodiscard]]
+    auto base_size() const -> size_t {
+        return base.size();
+    }
+
+    [[nodiscard]]
+    auto base_segment() const -> std::span<const T> {
+        return base;
+    }
+
+    [[nodiscard]]
+    auto delta_size() const -> size_t {
+        return delta.size();
+    }
+
+    // Heap elements only, mapped ones are page cache.
+    [[nodiscard]]
+    auto capacity() const -> size_t {
+        return delta.capacity();
+    }
+
+    auto operator[](const size_t index) const -> const T & {
+        return index < base.size() ? base[index] : delta[index - base.size()];
+    }
+
+    // Only elements past the base segment are writable.
+    auto set(const size_t index, const T &value) -> void {
+        delta[index - base.size()] = value;
+    }
+
+    auto push_back(const T &value) -> void {
+        delta.push_back(value);
+    }
+
+    auto assign(const size_t count, const T &value) -> void {
+        base = {};
+        delta.assign(count, value);
+    }
+
+    // Resizes the delta, the base segment is never cut.
+    auto resize(const size_t count) -> void {
+        delta.resize(count - base.size());
+    }
+};
+
+#endif //MAPPED_FILE_HPP
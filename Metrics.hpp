@@ -0,0 +1,288 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Plain copy of a histogram, merged from all shards when metrics are read.
+struct HistogramSnapshot {
+    // Log-linear buckets as in HdrHistogram: every power of two is split into 2^sub_bucket_bits
+    // linear sub-buckets, so any recorded value is reported within 1/16 of its magnitude.
+    static constexpr int sub_bucket_bits = 4;
+    static constexpr uint64_t sub_buckets = 1 << sub_bucket_bits;
+    static constexpr int magnitudes = 40;
+    static constexpr size_t bucket_count = (magnitudes + 1) * sub_buckets;
+
+    std::array<uint64_t, bucket_count> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    static constexpr auto bucket_of(const uint64_t value) -> size_t {
+        if (value < sub_buckets) {
+            return value;
+        }
+        const auto magnitude = std::bit_width(value) - sub_bucket_bits;
+        const auto sub_bucket = value >> (magnitude - 1) & (sub_buckets - 1);
+        return std::min(bucket_count - 1, static_cast<size_t>(magnitude) * sub_buckets + sub_bucket);
+    }
+
+    // Highest value that falls into the bucket.
+    static constexpr auto upper_bound_of(const size_t bucket) -> uint64_t {
+        if (bucket < sub_buckets) {
+            return bucket;
+        }
+        const auto magnitude = bucket / sub_buckets;
+        const auto sub_bucket = bucket % sub_buckets;
+        return ((sub_buckets + sub_bucket + 1) << (magnitude - 1)) - 1;
+    }
+
+    [[nodiscard]]
+    auto percentile(const double fraction) const -> uint64_t {
+        if (count == 0) {
+            return 0;
+        }
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+            seen += buckets[bucket];
+            if (seen >= rank) {
+                return std::min(upper_bound_of(bucket), max);
+            }
+        }
+        return max;
+    }
+};
+
+// Latency histogram in nanoseconds with a single writer. Updates are relaxed load + store
+// instead of read-modify-write, so recording costs no locked instructions, and readers on
+// other threads still see consistent per-bucket values.
+class LatencyHistogram {
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::bucket_count> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    static auto bump(std::atomic<uint64_t> &counter, const uint64_t amount) -> void {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+public:
+    auto record(const uint64_t nanoseconds) -> void {
+        bump(buckets[HistogramSnapshot::bucket_of(nanoseconds)], 1);
+        bump(count, 1);
+        bump(sum, nanoseconds);
+        if (nanoseconds > max.load(std::memory_order_relaxed)) {
+            max.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    auto add_to(HistogramSnapshot &snapshot) const -> void {
+        for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+            snapshot.buckets[bucket] += buckets[bucket].load(std::memory_order_relaxed);
+        }
+        snapshot.count += count.load(std::memory_order_relaxed);
+        snapshot.sum += sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, max.load(std::memory_order_relaxed));
+    }
+};
+
+// Process-wide statement metrics. Every recording thread owns a shard, registered once, so the
+// hot path never shares cache lines or takes a lock. Readers merge all shards.
+class Metrics {
+public:
+    // Query keywords that get their own counters. Anything else is counted as OTHER.
+    static constexpr std::array<std::string_view, 31> opcodes{
+        "USE", "CREATE GRAPH", "CREATE INDEX", "INSERT NODE", "INSERT NODE COMPLEX", "INSERT EDGE",
+        "INSERT EDGE FROM TO", "UPDATE NODE TO", "UPDATE NODE TO COMPLEX", "DELETE NODE", "DELETE EDGE FROM TO",
+        "SELECT NODE", "SELECT NODE WHERE", "SELECT AGGREGATE", "IS CONNECTED", "IS CONNECTED DIRECTLY",
+        "NEIGHBORS", "NEIGHBORS DIRECTED", "WEIGHTED PATH", "WEIGHTED PATH DIRECTED", "MATCH", "ANALYZE", "BEGIN",
+        "COMMIT", "ROLLBACK", "SET STORAGE", "REORDER GRAPH", "STATS", "EXPLAIN", "PROFILE", "OTHER",
+    };
+
+    enum class Phase { Parse, Execute };
+
+    struct OpcodeSnapshot {
+        std::string_view name;
+        HistogramSnapshot parse;
+        HistogramSnapshot execute;
+    };
+
+    struct Snapshot {
+        std::vector<OpcodeSnapshot> opcodes;
+        HistogramSnapshot sync;
+    };
+
+    // Per-graph values sampled at the time metrics are exported.
+    struct GraphGauges {
+        std::string name;
+        // Graphs not loaded from the snapshot only report this.
+        bool resident{};
+        size_t nodes{};
+        size_t edges{};
+        size_t memory_bytes{};
+        // Size of the edge store of a graph in mapped storage, served from the page cache.
+        size_t mapped_bytes{};
+    };
+
+    static constexpr std::array<double, 3> quantiles{0.5, 0.9, 0.99};
+
+private:
+    struct Shard {
+        std::array<std::array<LatencyHistogram, 2>, opcodes.size()> phases;
+        LatencyHistogram sync;
+    };
+
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<Shard> > shards;
+
+    static auto instance() -> Metrics & {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    // Shards outlive their threads, so nothing recorded is lost when a thread exits.
+    static auto local() -> Shard & {
+        thread_local Shard *shard = [] {
+            auto &metrics = instance();
+            const auto lock = std::scoped_lock(metrics.registry_mutex);
+            return metrics.shards.emplace_back(std::make_unique<Shard>()).get();
+        }();
+        return *shard;
+    }
+
+    static auto to_nanoseconds(const std::chrono::steady_clock::duration duration) -> uint64_t {
+        return static_cast<uint64_t>(std::max<int64_t>(
+            0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+
+public:
+    static auto opcode_of(const std::string_view keyword) -> size_t {
+        const auto it = std::ranges::find(opcodes, keyword);
+        return it == opcodes.end() ? opcodes.size() - 1 : static_cast<size_t>(it - opcodes.begin());
+    }
+
+    static auto record(const size_t opcode, const Phase phase, const std::chrono::steady_clock::duration duration)
+        -> void {
+        local().phases[opcode][static_cast<size_t>(phase)].record(to_nanoseconds(duration));
+    }
+
+    static auto record_sync(const std::chrono::steady_clock::duration duration) -> void {
+        local().sync.record(to_nanoseconds(duration));
+    }
+
+    static auto snapshot() -> Snapshot {
+        auto result = Snapshot{};
+        result.opcodes.resize(opcodes.size());
+        for (size_t opcode = 0; opcode < opcodes.size(); ++opcode) {
+            result.opcodes[opcode].name = opcodes[opcode];
+        }
+
+        auto &metrics = instance();
+        const auto lock = std::scoped_lock(metrics.registry_mutex);
+        for (const auto &shard: metrics.shards) {
+            for (size_t opcode = 0; opcode < opcodes.size(); ++opcode) {
+                shard->phases[opcode][static_cast<size_t>(Phase::Parse)].add_to(result.opcodes[opcode].parse);
+                shard->phases[opcode][static_cast<size_t>(Phase::Execute)].add_to(result.opcodes[opcode].execute);
+            }
+            shard->sync.add_to(result.sync);
+        }
+        return result;
+    }
+
+    // Prometheus text exposition format, latencies as summaries in seconds.
+    static auto to_prometheus(const Snapshot &snapshot, const std::vector<GraphGauges> &graphs) -> std::string {
+        auto out = std::string{};
+        auto append_summary = [&out](const std::string_view metric, const std::string &labels,
+                                     const HistogramSnapshot &histogram) {
+            const auto separator = labels.empty() ? "" : ",";
+            for (const auto quantile: quantiles) {
+                out += std::format("{}{{{}{}quantile=\"{}\"}} {:.9f}\n", metric, labels, separator, quantile,
+                                   static_cast<double>(histogram.percentile(quantile)) / 1e9);
+            }
+            const auto suffix = labels.empty() ? std::string{} : std::format("{{{}}}", labels);
+            out += std::format("{}_sum{} {:.9f}\n", metric, suffix, static_cast<double>(histogram.sum) / 1e9);
+            out += std::format("{}_count{} {}\n", metric, suffix, histogram.count);
+        };
+
+        out += "# HELP edgydb_statements_total Statements executed, by command.\n";
+        out += "# TYPE edgydb_statements_total counter\n";
+        for (const auto &opcode: snapshot.opcodes) {
+            if (opcode.execute.count > 0) {
+                out += std::format("edgydb_statements_total{{command=\"{}\"}} {}\n", opcode.name,
+                                   opcode.execute.count);
+            }
+        }
+        for (const auto &[phase, metric]: {
+                 std::pair{Phase::Parse, std::string_view("edgydb_parse_seconds")},
+                 std::pair{Phase::Execute, std::string_view("edgydb_execute_seconds")},
+             }) {
+            out += std::format("# HELP {} Statement {} latency, by command.\n", metric,
+                               phase == Phase::Parse ? "parse" : "execute");
+            out += std::format("# TYPE {} summary\n", metric);
+            for (const auto &opcode: snapshot.opcodes) {
+                const auto &histogram = phase == Phase::Parse ? opcode.parse : opcode.execute;
+                if (histogram.count > 0) {
+                    append_summary(metric, std::format("command=\"{}\"", opcode.name), histogram);
+                }
+            }
+        }
+        out += "# HELP edgydb_sync_seconds Snapshot write latency.\n";
+        out += "# TYPE edgydb_sync_seconds summary\n";
+        append_summary("edgydb_sync_seconds", "", snapshot.sync);
+
+        out += "# HELP edgydb_graph_resident Whether the graph is loaded in memory.\n";
+        out += "# TYPE edgydb_graph_resident gauge\n";
+        for (const auto &graph: graphs) {
+            out += std::format("edgydb_graph_resident{{graph=\"{}\"}} {}\n", escape_label(graph.name),
+                               graph.resident ? 1 : 0);
+        }
+        for (const auto &[metric, help, value]: {
+                 std::tuple{"edgydb_graph_nodes", "Live nodes", &GraphGauges::nodes},
+                 std::tuple{"edgydb_graph_edges", "Live edges", &GraphGauges::edges},
+                 std::tuple{"edgydb_graph_memory_bytes", "Approximate heap bytes", &GraphGauges::memory_bytes},
+                 std::tuple{"edgydb_graph_mapped_bytes", "Memory-mapped edge store bytes", &GraphGauges::mapped_bytes},
+             }) {
+            out += std::format("# HELP {} {} per graph.\n# TYPE {} gauge\n", metric, help, metric);
+            for (const auto &graph: graphs | std::views::filter(&GraphGauges::resident)) {
+                out += std::format("{}{{graph=\"{}\"}} {}\n", metric, escape_label(graph.name), graph.*value);
+            }
+        }
+        return out;
+    }
+
+private:
+    static auto escape_label(const std::string_view value) -> std::string {
+        auto escaped = std::string{};
+        for (const auto c: value) {
+            if (c == '\\' || c == '"') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+};
+
+#endif //METRICS_HPP
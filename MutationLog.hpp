@@ -0,0 +1,324 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef MUTATION_LOG_HPP
+#define MUTATION_LOG_HPP
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+#include "Checksum.hpp"
+
+// Mutating statements applied since the last snapshot, in the order they were executed.
+struct LogRecord {
+    // Graph selected with USE when the statements ran, empty if none was.
+    std::string graph;
+    // Database::current_id before the first statement, so replay hands out the same node ids.
+    int current_id{};
+    std::vector<std::string> statements;
+};
+
+// Records a follower found past its position in the log.
+struct LogTail {
+    // Checkpoint of the snapshot the log extends.
+    uint32_t checkpoint = 0;
+    // False for logs written before records carried checksums.
+    bool checksummed = true;
+    // False for logs written before record lengths were covered by the checksums.
+    bool lengths_checked = true;
+    std::vector<LogRecord> records;
+    // Just past the last complete record, where the next read continues.
+    size_t offset = 0;
+    // Bytes in the file, including a record that is still being written.
+    size_t size = 0;
+};
+
+// Append-only log of mutating statements, replayed on top of the snapshot after a restart and
+// tailed by read replicas. The file starts with a magic, the checkpoint of the snapshot it extends
+// and the CRC32C of both. Every record is a u32 byte length, the u32 CRC32C of the length, the u32
+// CRC32C of the length followed by the record and the record. A record whose length checks out but
+// that ends early was torn by a crash or is still being written and is left out; a damaged length,
+// or a damaged record followed by others, is reported. Appends are buffered for at most flush_delay;
+// a durable append (COMMIT) writes the buffer and fsyncs once.
+class MutationLog {
+    static constexpr std::string_view magic = "EDGYLOG3";
+    // Logs of earlier versions, read with what they carry until the next reset replaces them: records
+    // checksummed without their lengths, and records without checksums.
+    static constexpr std::string_view unchecked_length_magic = "EDGYLOG2";
+    static constexpr std::string_view unchecked_magic = "EDGYLOG1";
+    static constexpr size_t header_size = magic.size() + 2 * sizeof(uint32_t);
+    static constexpr size_t unchecked_header_size = unchecked_magic.size() + sizeof(uint32_t);
+    static constexpr size_t flush_threshold = 64 * 1024;
+    // Bounds how long replicas can miss a record the primary already applied.
+    static constexpr auto flush_delay = std::chrono::milliseconds(50);
+
+    std::string path;
+    int fd = -1;
+    std::string pending;
+    std::chrono::steady_clock::time_point pending_since;
+
+    template<typename T>
+    static auto append_fixed(std::string &out, T value) -> void {
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    static auto append_string(std::string &out, const std::string_view value) -> void {
+        append_fixed(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    // Reads a T at pos, or fails when the data ends first.
+    template<typename T>
+    static auto read_fixed(const std::string_view data, size_t &pos, T &value) -> bool {
+        if (data.size() - pos < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data.data() + pos, sizeof(T));
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        pos += sizeof(T);
+        return true;
+    }
+
+    static auto read_string(const std::string_view data, size_t &pos, std::string &value) -> bool {
+        uint32_t length;
+        if (!read_fixed(data, pos, length) || data.size() - pos < length) {
+            return false;
+        }
+        value.assign(data.substr(pos, length));
+        pos += length;
+        return true;
+    }
+
+    static auto decode_record(const std::string_view data, LogRecord &record) -> bool {
+        size_t pos = 0;
+        uint32_t count;
+        int32_t current_id;
+        if (!read_string(data, pos, record.graph) || !read_fixed(data, pos, current_id) ||
+            !read_fixed(data, pos, count)) {
+            return false;
+        }
+        record.current_id = current_id;
+        record.statements.resize(count);
+        for (auto &statement: record.statements) {
+            if (!read_string(data, pos, statement)) {
+                return false;
+            }
+        }
+        return pos == data.size();
+    }
+
+    // Shared by tail() and inspect(), a checkpoint of nullopt accepts the log of any snapshot.
+    auto read_from(const std::optional<uint32_t> checkpoint, const size_t offset) const -> std::optional<LogTail> {
+        std::ifstream file(path, std::ios::binary);
+        auto header = std::string(header_size, '\0');
+        file.read(header.data(), static_cast<std::streamsize>(header.size()));
+        header.resize(static_cast<size_t>(file.gcount()));
+        auto log = LogTail{};
+        size_t pos;
+        if (header.starts_with(unchecked_magic) && header.size() >= unchecked_header_size) {
+            pos = unchecked_magic.size();
+            read_fixed(std::string_view(header), pos, log.checkpoint);
+            log.checksummed = false;
+        } else if ((header.starts_with(magic) || header.starts_with(unchecked_length_magic)) &&
+                   header.size() == header_size) {
+            pos = magic.size();
+            log.lengths_checked = header.starts_with(magic);
+            uint32_t header_crc;
+            read_fixed(std::string_view(header), pos, log.checkpoint);
+            read_fixed(std::string_view(header), pos, header_crc);
+            if (Crc32c::of(std::string_view(header).substr(0, magic.size() + sizeof(uint32_t))) != header_crc) {
+                throw std::runtime_error(std::format("Mutation log {} has a damaged header", path));
+            }
+        } else if (header.size() < header_size &&
+                   (header.starts_with(magic) || std::string_view(magic).starts_with(header))) {
+            // Missing, or the header is still being written.
+            return std::nullopt;
+        } else {
+            throw std::runtime_error(std::format("{} is not a mutation log", path));
+        }
+        if (checkpoint && log.checkpoint != *checkpoint) {
+            return std::nullopt;
+        }
+
+        const auto start = std::max(offset, pos);
+        log.offset = start;
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(log.offset));
+        const auto data = std::string(std::istreambuf_iterator(file), {});
+        const auto view = std::string_view(data);
+        log.size = log.offset + data.size();
+        pos = 0;
+        while (true) {
+            const auto record_start = pos;
+            uint32_t length;
+            uint32_t length_crc = 0;
+            if (!read_fixed(view, pos, length) || (log.lengths_checked && !read_fixed(view, pos, length_crc))) {
+                break;
+            }
+            if (log.lengths_checked && Crc32c::of(view.substr(record_start, sizeof(length))) != length_crc) {
+                // A crash can leave the tail of the file zero-filled. Any other damaged length is reported:
+                // the records after it cannot be found, and dropping them as a torn write would lose them.
+                if (std::ranges::all_of(view.substr(record_start), [](const char c) { return c == '\0'; })) {
+                    break;
+                }
+                throw std::runtime_error(std::format("Mutation log record at byte {} has a damaged length",
+                                                     log.offset));
+            }
+            uint32_t crc = 0;
+            if ((log.checksummed && !read_fixed(view, pos, crc)) || view.size() - pos < length) {
+                break;
+            }
+            const auto record_view = view.substr(pos, length);
+            if (log.checksummed &&
+                (log.lengths_checked ? Crc32c::extend(length_crc, record_view) : Crc32c::of(record_view)) != crc) {
+                // A write torn by a crash can only damage the last record.
+                if (pos + length < view.size()) {
+                    throw std::runtime_error(std::format("Mutation log record at byte {} fails its checksum",
+                                                         log.offset));
+                }
+                break;
+            }
+            if (auto record = LogRecord{}; decode_record(record_view, record)) {
+                log.records.push_back(std::move(record));
+            } else if (log.checksummed) {
+                throw std::runtime_error(std::format("Mutation log record at byte {} cannot be decoded",
+                                                     log.offset));
+            } else {
+                break;
+            }
+            pos += length;
+            log.offset = start + pos;
+        }
+        return log;
+    }
+
+    auto write_all(const std::string_view data) -> void {
+        if (fd < 0) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0) {
+                throw std::runtime_error(std::format("Failed to open mutation log {}", path));
+            }
+        }
+        size_t written = 0;
+        while (written < data.size()) {
+            const auto result = ::write(fd, data.data() + written, data.size() - written);
+            if (result < 0) {
+                throw std::runtime_error(std::format("Failed to write mutation log {}", path));
+            }
+            written += static_cast<size_t>(result);
+        }
+    }
+
+public:
+    explicit MutationLog(std::string path) : path(std::move(path)) {
+    }
+
+    MutationLog(const MutationLog &) = delete;
+
+    auto operator=(const MutationLog &) -> MutationLog & = delete;
+
+    ~MutationLog() {
+        try {
+            flush(false);
+        } catch (const std::exception &) {
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // Complete records of the log if it extends the snapshot with the given checkpoint, nothing otherwise.
+    [[nodiscard]]
+    auto read(const uint32_t checkpoint) const -> std::vector<LogRecord> {
+        auto log = tail(checkpoint, 0);
+        return log ? std::move(log->records) : std::vector<LogRecord>{};
+    }
+
+    // Complete records past offset, nullopt while the log does not extend the snapshot with the given
+    // checkpoint, e.g. after the primary wrote a new snapshot and before it reset the log. Throws when
+    // the header or a record length fails its checksum, or a record that is not the last one does.
+    [[nodiscard]]
+    auto tail(const uint32_t checkpoint, const size_t offset) const -> std::optional<LogTail> {
+        return read_from(checkpoint, offset);
+    }
+
+    // All complete records whatever snapshot the log extends, for offline verification.
+    [[nodiscard]]
+    auto inspect() const -> std::optional<LogTail> {
+        return read_from(std::nullopt, 0);
+    }
+
+    auto append(const LogRecord &record, const bool durable) -> void {
+        auto payload = std::string{};
+        append_string(payload, record.graph);
+        append_fixed(payload, static_cast<int32_t>(record.current_id));
+        append_fixed(payload, static_cast<uint32_t>(record.statements.size()));
+        for (const auto &statement: record.statements) {
+            append_string(payload, statement);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (pending.empty()) {
+            pending_since = now;
+        }
+        auto length = std::string{};
+        append_fixed(length, static_cast<uint32_t>(payload.size()));
+        const auto length_crc = Crc32c::of(length);
+        pending += length;
+        append_fixed(pending, length_crc);
+        append_fixed(pending, Crc32c::extend(length_crc, payload));
+        pending += payload;
+
+        if (durable || pending.size() >= flush_threshold || now - pending_since >= flush_delay) {
+            flush(durable);
+        }
+    }
+
+    auto flush(const bool durable) -> void {
+        if (!pending.empty()) {
+            write_all(pending);
+            pending.clear();
+        }
+        if (durable && fd >= 0 && ::fsync(fd) != 0) {
+            throw std::runtime_error(std::format("Failed to sync mutation log {}", path));
+        }
+    }
+
+    // Drops all records, which are covered by the snapshot with the given checkpoint from now on.
+    auto reset(const uint32_t checkpoint) -> void {
+        pending.clear();
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+            throw std::runtime_error(std::format("Failed to open mutation log {}", path));
+        }
+        auto header = std::string(magic);
+        append_fixed(header, checkpoint);
+        append_fixed(header, Crc32c::of(header));
+        write_all(header);
+    }
+};
+
+#endif //MUTATION_LOG_HPP
@@ -0,0 +1,47 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+struct Parallel {
+    // Below this many items per thread spawning threads costs more than it saves.
+    static constexpr size_t min_chunk = 4096;
+
+    [[nodiscard]]
+    static auto thread_count() -> size_t {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    [[nodiscard]]
+    static auto workers_for(const size_t items) -> size_t {
+        return std::clamp<size_t>(items / min_chunk, 1, thread_count());
+    }
+
+    // Splits [0, items) into one contiguous chunk per worker and runs body(begin, end, worker) on each.
+    // Chunks are contiguous so every worker streams through its part of CSR arrays sequentially.
+    template<typename Body>
+    static auto for_chunks(const size_t items, const size_t workers, Body body) -> void {
+        if (workers <= 1) {
+            body(size_t{0}, items, size_t{0});
+            return;
+        }
+
+        std::vector<std::jthread> threads;
+        threads.reserve(workers - 1);
+        const auto chunk = (items + workers - 1) / workers;
+        for (size_t worker = 1; worker < workers; ++worker) {
+            const auto begin = std::min(items, worker * chunk);
+            const auto end = std::min(items, begin + chunk);
+            threads.emplace_back([&body, begin, end, worker] { body(begin, end, worker); });
+        }
+        body(size_t{0}, std::min(items, chunk), size_t{0});
+    }
+};
+
+#endif //PARALLEL_HPP
@@ -0,0 +1,124 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef PATTERN_HPP
+#define PATTERN_HPP
+
+#include <algorithm>
+#include <format>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Adjacency.hpp"
+#include "Condition.hpp"
+
+// Path pattern of a MATCH query, e.g. (a)-(b)<-(c) WHERE a."position" EQ "manager" AND c."age" GT 40 LIMIT 10.
+// Every variable binds a distinct node; a row is produced for every edge path connecting them.
+struct MatchPattern {
+    std::vector<std::string> variables;
+    // Direction of the edge between variables[i] and variables[i + 1], seen from variables[i].
+    std::vector<Direction> edges;
+    // Conjunction of conditions per variable, nullopt when the variable is unconstrained.
+    std::vector<std::optional<ConditionGroup> > conditions;
+    std::optional<size_t> limit;
+
+    static auto parse(const std::string &text) -> MatchPattern {
+        auto pattern = MatchPattern{};
+        auto stream = std::istringstream(text);
+        auto path = std::string{};
+        stream >> path;
+        pattern.parse_path(path);
+        pattern.conditions.resize(pattern.variables.size());
+
+        auto token = std::string{};
+        if (!(stream >> token)) {
+            return pattern;
+        }
+        if (token == "WHERE") {
+            while (stream >> token && token != "LIMIT") {
+                const auto dot = token.find('.');
+                const auto variable = pattern.index_of(token.substr(0, dot));
+                if (dot == std::string::npos || !variable) {
+                    throw std::invalid_argument(std::format(
+                        "MATCH conditions must name a pattern variable, as in a.\"field\", got {}", token));
+                }
+                auto field = std::string{};
+                std::istringstream(token.substr(dot + 1)) >> std::quoted(field);
+
+                auto &group = pattern.conditions[*variable];
+                if (!group) {
+                    group.emplace();
+                } else {
+                    group->operators.emplace_back("AND");
+                }
+                group->conditions.push_back(read_condition(stream, field));
+
+                if (!(stream >> token) || token == "LIMIT") {
+                    break;
+                }
+                if (token != "AND") {
+                    throw std::invalid_argument("MATCH conditions can only be joined with AND");
+                }
+            }
+            if (std::ranges::none_of(pattern.conditions, [](const auto &group) { return group.has_value(); })) {
+                throw std::invalid_argument("WHERE clause requires at least one condition");
+            }
+        }
+        if (token == "LIMIT") {
+            auto limit = size_t{};
+            if (!(stream >> limit)) {
+                throw std::invalid_argument("LIMIT expects a number of rows");
+            }
+            pattern.limit = limit;
+        } else if (stream) {
+            throw std::invalid_argument(std::format("Unexpected {} after MATCH pattern", token));
+        }
+        return pattern;
+    }
+
+    [[nodiscard]]
+    auto index_of(const std::string_view variable) const -> std::optional<size_t> {
+        const auto it = std::ranges::find(variables, variable);
+        return it == variables.end() ? std::nullopt : std::optional(static_cast<size_t>(it - variables.begin()));
+    }
+
+private:
+    // Reads (a)-(b)->(c)<-(d): undirected, outgoing and incoming edges between consecutive variables.
+    auto parse_path(const std::string_view path) -> void {
+        size_t pos = 0;
+        while (true) {
+            const auto close = path.find(')', pos);
+            if (pos >= path.size() || path[pos] != '(' || close == std::string_view::npos || close == pos + 1) {
+                throw std::invalid_argument("MATCH expects a pattern like (a)-(b) or (a)->(b)");
+            }
+            auto variable = std::string(path.substr(pos + 1, close - pos - 1));
+            if (index_of(variable)) {
+                throw std::invalid_argument(std::format("Variable {} appears twice in the MATCH pattern", variable));
+            }
+            variables.push_back(std::move(variable));
+            pos = close + 1;
+            if (pos == path.size()) {
+                return;
+            }
+            if (path.substr(pos, 3) == "->(") {
+                edges.push_back(Direction::Outgoing);
+                pos += 2;
+            } else if (path.substr(pos, 3) == "<-(") {
+                edges.push_back(Direction::Incoming);
+                pos += 2;
+            } else if (path.substr(pos, 2) == "-(") {
+                edges.push_back(Direction::Both);
+                pos += 1;
+            } else {
+                throw std::invalid_argument("MATCH variables must be connected with -, -> or <-");
+            }
+        }
+    }
+};
+
+#endif //PATTERN_HPP
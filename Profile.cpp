@@ -0,0 +1,40 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#include <cstdlib>
+#include <new>
+
+#include "Profile.hpp"
+
+// Global allocation hooks feeding AllocationCounter. Counting is two thread-local increments,
+// cheap enough to stay on outside PROFILE. Aligned and nothrow forms keep their defaults.
+
+auto operator new(const std::size_t size) -> void * {
+    ++AllocationCounter::count;
+    AllocationCounter::bytes += size;
+    if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator new[](const std::size_t size) -> void * {
+    return operator new(size);
+}
+
+auto operator delete(void *pointer) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete[](void *pointer) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete(void *pointer, std::size_t) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete[](void *pointer, std::size_t) noexcept -> void {
+    std::free(pointer);
+}
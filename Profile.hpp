@@ -0,0 +1,157 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+
+// Allocations made by the current thread, counted by the operator new replacement in Profile.cpp.
+struct AllocationCounter {
+    static inline thread_local size_t count = 0;
+    static inline thread_local size_t bytes = 0;
+};
+
+// Counters and per-stage timings of one statement run under PROFILE. Instrumented code asks for
+// the active profile and does nothing when there is none, so outside PROFILE it costs one
+// thread-local load per call site.
+class QueryProfile {
+public:
+    struct Stage {
+        std::string_view name;
+        std::chrono::nanoseconds duration{};
+        size_t allocations = 0;
+        size_t allocated_bytes = 0;
+    };
+
+    size_t rows_examined = 0;
+    size_t conditions_evaluated = 0;
+    size_t index_entries = 0;
+    size_t nodes_visited = 0;
+    size_t edges_visited = 0;
+    size_t rows_returned = 0;
+
+    // Stages in order of first use. Time and allocations of nested stages are subtracted from
+    // the enclosing one, so the stages add up to the total.
+    std::vector<Stage> stages;
+
+    // Measures one stage of the active profile from construction until stop() or destruction.
+    class Timer {
+        QueryProfile *profile;
+        Timer *parent = nullptr;
+        std::string_view name;
+        std::chrono::steady_clock::time_point started;
+        size_t allocations_at_start = 0;
+        size_t bytes_at_start = 0;
+        std::chrono::nanoseconds nested_duration{};
+        size_t nested_allocations = 0;
+        size_t nested_bytes = 0;
+
+    public:
+        explicit Timer(const std::string_view name) : profile(active()), name(name) {
+            if (profile == nullptr) {
+                return;
+            }
+            parent = profile->open_timer;
+            profile->open_timer = this;
+            // Listed when it starts, so stages appear in the order they began.
+            profile->add(name, {}, 0, 0);
+            allocations_at_start = AllocationCounter::count;
+            bytes_at_start = AllocationCounter::bytes;
+            started = std::chrono::steady_clock::now();
+        }
+
+        Timer(const Timer &) = delete;
+
+        auto operator=(const Timer &) -> Timer & = delete;
+
+        ~Timer() {
+            stop();
+        }
+
+        auto stop() -> void {
+            if (profile == nullptr) {
+                return;
+            }
+            const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - started);
+            const auto allocations = AllocationCounter::count - allocations_at_start;
+            const auto bytes = AllocationCounter::bytes - bytes_at_start;
+            profile->add(name, duration - nested_duration, allocations - nested_allocations, bytes - nested_bytes);
+            if (parent != nullptr) {
+                parent->nested_duration += duration;
+                parent->nested_allocations += allocations;
+                parent->nested_bytes += bytes;
+            }
+            profile->open_timer = parent;
+            profile = nullptr;
+        }
+    };
+
+    // Makes this the active profile of the thread while it is alive.
+    QueryProfile() : previous(current) {
+        // Reserved up front so recording a stage does not allocate inside another one.
+        stages.reserve(16);
+        current = this;
+    }
+
+    QueryProfile(const QueryProfile &) = delete;
+
+    auto operator=(const QueryProfile &) -> QueryProfile & = delete;
+
+    ~QueryProfile() {
+        current = previous;
+    }
+
+    [[nodiscard]]
+    static auto active() -> QueryProfile * {
+        return current;
+    }
+
+    auto print(const std::string_view keyword) const -> void {
+        auto total = Stage{"total"};
+        fmt::println("Profile of {}:", keyword);
+        fmt::println("  {:<14} {:>12} {:>12} {:>12}", "Stage", "Time (us)", "Allocations", "Bytes");
+        for (const auto &stage: stages) {
+            print_stage(stage);
+            total.duration += stage.duration;
+            total.allocations += stage.allocations;
+            total.allocated_bytes += stage.allocated_bytes;
+        }
+        print_stage(total);
+        fmt::println("  Rows examined: {}, conditions evaluated: {}, index entries: {}", rows_examined,
+                     conditions_evaluated, index_entries);
+        fmt::println("  Nodes visited: {}, edges visited: {}, rows returned: {}", nodes_visited, edges_visited,
+                     rows_returned);
+    }
+
+private:
+    static inline thread_local QueryProfile *current = nullptr;
+
+    QueryProfile *previous;
+    Timer *open_timer = nullptr;
+
+    auto add(const std::string_view name, const std::chrono::nanoseconds duration, const size_t allocations,
+             const size_t bytes) -> void {
+        auto it = std::ranges::find(stages, name, &Stage::name);
+        if (it == stages.end()) {
+            it = stages.insert(stages.end(), Stage{name});
+        }
+        it->duration += duration;
+        it->allocations += allocations;
+        it->allocated_bytes += bytes;
+    }
+
+    static auto print_stage(const Stage &stage) -> void {
+        fmt::println("  {:<14} {:>12.1f} {:>12} {:>12}", stage.name, static_cast<double>(stage.duration.count()) / 1e3,
+                     stage.allocations, stage.allocated_bytes);
+    }
+};
+
+#endif //PROFILE_HPP
@@ -0,0 +1,110 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef REORDERING_HPP
+#define REORDERING_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "Adjacency.hpp"
+
+// Locality-improving node orders for REORDER GRAPH, computed over the undirected adjacency. Every
+// order lists old slots by new slot, so order[new slot] = old slot.
+struct Reordering {
+    enum class Strategy { BFS, Degree, RCM };
+
+    static auto parse(const std::string_view name) -> std::optional<Strategy> {
+        if (name == "BFS") {
+            return Strategy::BFS;
+        }
+        if (name == "DEGREE") {
+            return Strategy::Degree;
+        }
+        if (name == "RCM") {
+            return Strategy::RCM;
+        }
+        return std::nullopt;
+    }
+
+    static auto order(const Adjacency &both, const Strategy strategy) -> std::vector<uint32_t> {
+        switch (strategy) {
+            case Strategy::BFS:
+                return bfs(both);
+            case Strategy::Degree:
+                return degree(both);
+            case Strategy::RCM:
+                return rcm(both);
+        }
+        return {};
+    }
+
+    // Breadth-first from the highest-degree slot of every component, so the neighbours of a node get
+    // consecutive slots and expanding a frontier reads nearby memory.
+    static auto bfs(const Adjacency &both) -> std::vector<uint32_t> {
+        return breadth_first(both, by_degree(both, true), false);
+    }
+
+    // Descending degree, so the hubs most traversals pass through share a few cache lines and pages.
+    static auto degree(const Adjacency &both) -> std::vector<uint32_t> {
+        return by_degree(both, true);
+    }
+
+    // Reverse Cuthill-McKee: breadth-first from the lowest-degree slot of every component, visiting
+    // neighbours in ascending degree, then reversed. Keeps edges close to the diagonal, i.e. most
+    // neighbours within a small slot distance.
+    static auto rcm(const Adjacency &both) -> std::vector<uint32_t> {
+        auto order = breadth_first(both, by_degree(both, false), true);
+        std::ranges::reverse(order);
+        return order;
+    }
+
+private:
+    // All slots by degree, ties in slot order.
+    static auto by_degree(const Adjacency &both, const bool descending) -> std::vector<uint32_t> {
+        auto slots = std::vector<uint32_t>(both.node_count());
+        std::iota(slots.begin(), slots.end(), uint32_t{0});
+        std::ranges::stable_sort(slots, [&both, descending](const uint32_t left, const uint32_t right) {
+            return descending ? both.degree(left) > both.degree(right) : both.degree(left) < both.degree(right);
+        });
+        return slots;
+    }
+
+    // Visits every component breadth-first, starting from the first unvisited slot of starts.
+    static auto breadth_first(const Adjacency &both, const std::vector<uint32_t> &starts,
+                              const bool neighbors_by_degree) -> std::vector<uint32_t> {
+        auto order = std::vector<uint32_t>{};
+        order.reserve(both.node_count());
+        auto visited = std::vector<bool>(both.node_count());
+        auto neighbors = std::vector<uint32_t>{};
+        for (const auto start: starts) {
+            if (visited[start]) {
+                continue;
+            }
+            visited[start] = true;
+            order.push_back(start);
+            // The order doubles as the queue, slots past head still have to be expanded.
+            for (auto head = order.size() - 1; head < order.size(); ++head) {
+                const auto adjacent = both.neighbors(order[head]);
+                neighbors.assign(adjacent.begin(), adjacent.end());
+                if (neighbors_by_degree) {
+                    std::ranges::stable_sort(neighbors, {}, [&both](const uint32_t slot) { return both.degree(slot); });
+                }
+                for (const auto neighbor: neighbors) {
+                    if (!visited[neighbor]) {
+                        visited[neighbor] = true;
+                        order.push_back(neighbor);
+                    }
+                }
+            }
+        }
+        return order;
+    }
+};
+
+#endif //REORDERING_HPP
@@ -0,0 +1,149 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef RESULT_SINK_HPP
+#define RESULT_SINK_HPP
+
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "BinaryEncoding.hpp"
+#include "Database.hpp"
+#include "Serialization.hpp"
+
+enum class OutputFormat {
+    Text,
+    JsonLines,
+    Binary,
+};
+
+inline auto parse_output_format(const std::string_view value) -> std::optional<OutputFormat> {
+    if (value == "TEXT") return OutputFormat::Text;
+    if (value == "JSONL") return OutputFormat::JsonLines;
+    if (value == "BINARY") return OutputFormat::Binary;
+    return std::nullopt;
+}
+
+// Receives query results one node at a time while the scan is still running.
+// Output is accumulated in a buffer and written out in large chunks.
+class ResultSink {
+    static constexpr size_t flush_threshold = 64 * 1024;
+
+    std::FILE *pipe;
+
+protected:
+    std::string buffer;
+    size_t written = 0;
+
+    auto flush_if_full() -> void {
+        if (buffer.size() >= flush_threshold) {
+            flush();
+        }
+    }
+
+    virtual auto append(const Node &node) -> void = 0;
+
+    virtual auto append_footer() -> void {
+    }
+
+public:
+    explicit ResultSink(std::FILE *pipe) : pipe(pipe) {
+    }
+
+    virtual ~ResultSink() {
+        flush();
+    }
+
+    ResultSink(const ResultSink &) = delete;
+
+    auto operator=(const ResultSink &) -> ResultSink & = delete;
+
+    static auto create(OutputFormat format, std::FILE *pipe = stdout) -> std::unique_ptr<ResultSink>;
+
+    auto write(const Node &node) -> void {
+        append(node);
+        ++written;
+        flush_if_full();
+    }
+
+    auto finish() -> void {
+        append_footer();
+        flush();
+        std::fflush(pipe);
+    }
+
+    auto flush() -> void {
+        if (!buffer.empty()) {
+            std::fwrite(buffer.data(), 1, buffer.size(), pipe);
+            buffer.clear();
+        }
+    }
+
+    [[nodiscard]]
+    auto count() const -> size_t {
+        return written;
+    }
+};
+
+class TextSink final : public ResultSink {
+protected:
+    auto append(const Node &node) -> void override {
+        if (written == 0) {
+            buffer += "Matching nodes:\n";
+        }
+        node.append_to(buffer);
+        buffer += '\n';
+    }
+
+    auto append_footer() -> void override {
+        if (written == 0) {
+            buffer += "No nodes matched the given conditions.\n";
+        }
+    }
+
+public:
+    using ResultSink::ResultSink;
+};
+
+class JsonLinesSink final : public ResultSink {
+protected:
+    auto append(const Node &node) -> void override {
+        buffer += Serialization::serialize_node(node);
+        buffer += '\n';
+    }
+
+public:
+    using ResultSink::ResultSink;
+};
+
+// Length-prefixed records as produced by BinaryEncoding::append_node, terminated by a zero length.
+class BinarySink final : public ResultSink {
+protected:
+    auto append(const Node &node) -> void override {
+        BinaryEncoding::append_node(buffer, node);
+    }
+
+    auto append_footer() -> void override {
+        BinaryEncoding::append_fixed(buffer, uint32_t{0});
+    }
+
+public:
+    using ResultSink::ResultSink;
+};
+
+inline auto ResultSink::create(const OutputFormat format, std::FILE *pipe) -> std::unique_ptr<ResultSink> {
+    switch (format) {
+        case OutputFormat::JsonLines:
+            return std::make_unique<JsonLinesSink>(pipe);
+        case OutputFormat::Binary:
+            return std::make_unique<BinarySink>(pipe);
+        case OutputFormat::Text:
+            break;
+    }
+    return std::make_unique<TextSink>(pipe);
+}
+
+#endif //RESULT_SINK_HPP
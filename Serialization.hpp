@@ -4,9 +4,17 @@
 #ifndef SERIALIZATION_HPP
 #define SERIALIZATION_HPP
 
+#include "Base64.hpp"
 #include "Database.hpp"
+#include "EdgeEncoding.hpp"
+#include "EdgeStore.hpp"
+#include "TextKernels.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <iomanip>
+#include <numeric>
 #include <sstream>
 #include <string>
 
@@ -15,36 +23,10 @@ class Serialization {
 
 public:
     static auto escape_json(const std::string &value) -> std::string {
-        logger.debug(std::format("Escaping JSON for value {}", value));
-
-        std::ostringstream escaped;
-        for (const auto ch: value) {
-            switch (ch) {
-                case '"': escaped << "\"";
-                    break;
-                case '\\': escaped << "\\\\";
-                    break;
-                case '\b': escaped << "\\b";
-                    break;
-                case '\f': escaped << "\\f";
-                    break;
-                case '\n': escaped << "\\n";
-                    break;
-                case '\r': escaped << "\\r";
-                    break;
-                case '\t': escaped << "\\t";
-                    break;
-                default:
-                    if (ch >= 0 && ch <= 31) {
-                        escaped << std::format("\\u{:04x}", static_cast<int>(ch));
-                    } else {
-                        escaped << ch;
-                    }
-            }
-        }
-
-        logger.debug(std::format("Escaped JSON {}", escaped.str()));
-        return escaped.str();
+        std::string escaped;
+        escaped.reserve(value.size());
+        TextKernels::append_json_escaped(escaped, value);
+        return escaped;
     }
 
     static auto serialize_value(const BasicValue &value) -> std::string {
@@ -130,43 +112,99 @@ public:
         return result.str();
     }
 
+    // Edges are stored as one base64 blob in the EdgeEncoding format plus its block index, which is
+    // several times smaller than an array of {"from":...,"to":...} objects and much faster to load.
+    static auto serialize_edges(std::vector<Edge> edges) -> std::string {
+        logger.debug(std::format("Edges serialization started for {} edges", edges.size()));
+
+        const auto encoded = EdgeEncoding::encode(std::move(edges));
+        std::ostringstream result;
+        result << "{\"encoding\":\"" << EdgeEncoding::name << "\",\"count\":" << encoded.count << ",\"blocks\":[";
+        auto separator = "";
+        for (const auto &[first_source, offset]: encoded.blocks) {
+            result << separator << "[" << first_source << "," << offset << "]";
+            separator = ",";
+        }
+        result << "],\"data\":\"" << Base64::encode(encoded.data) << "\"}";
+
+        logger.debug(std::format("Edges serialization completed, {} bytes encoded", encoded.data.size()));
+        return result.str();
+    }
+
+    // Weights as little-endian float32, base64 encoded, in the order of the serialized edges.
+    static auto serialize_edge_weights(const std::vector<float> &weights) -> std::string {
+        auto bytes = std::string(weights.size() * sizeof(float), '\0');
+        for (size_t i = 0; i < weights.size(); ++i) {
+            auto bits = std::bit_cast<uint32_t>(weights[i]);
+            if constexpr (std::endian::native == std::endian::big) {
+                bits = std::byteswap(bits);
+            }
+            std::memcpy(bytes.data() + i * sizeof(float), &bits, sizeof(float));
+        }
+        return "\"" + Base64::encode(bytes) + "\"";
+    }
+
     static auto serialize_graph(const Graph &graph) -> std::string {
         logger.debug(std::format("Graph serialization started for graph with name {}", graph.name));
 
         std::ostringstream result;
         result << "{";
         result << "\"name\":" << "\"" << graph.name << "\",";
+        result << "\"last_node_id\":" << graph.last_node_id << ",";
         result << "\"nodes\":[";
-        for (size_t i = 0; i < graph.nodes.size(); ++i) {
-            result << serialize_node(graph.nodes[i]);
-            if (i + 1 < graph.nodes.size()) result << ",";
+        auto separator = "";
+        for (const auto &node: graph.live_nodes()) {
+            result << separator << serialize_node(node);
+            separator = ",";
         }
         result << "],";
-        result << "\"edges\":[";
-        for (size_t i = 0; i < graph.edges.size(); ++i) {
-            result << serialize_edge(graph.edges[i]);
-            if (i + 1 < graph.edges.size()) result << ",";
+        if (graph.edge_store) {
+            // Mapped edges stay in their store file, which is merged before every snapshot.
+            result << "\"edge_store\":\"" << escape_json(graph.edge_store->path()) << "\",";
+        } else if (graph.edge_weights.empty()) {
+            result << "\"edges\":" << serialize_edges(graph.live_edges() | std::ranges::to<std::vector<Edge> >()) << ",";
+        } else {
+            // EdgeEncoding sorts edges, so put them in its order first to keep weights aligned.
+            auto slots = std::vector<size_t>{};
+            slots.reserve(graph.edges.size() - graph.removed_edges_count);
+            for (size_t slot = 0; slot < graph.edges.size(); ++slot) {
+                if (!graph.is_edge_removed(slot) && !graph.is_edge_dangling(slot)) {
+                    slots.push_back(slot);
+                }
+            }
+            std::ranges::stable_sort(slots, [&graph](const size_t left, const size_t right) {
+                const auto &[left_from, left_to] = graph.edges[left];
+                const auto &[right_from, right_to] = graph.edges[right];
+                return std::tie(left_from, left_to) < std::tie(right_from, right_to);
+            });
+            auto edges = std::vector<Edge>{};
+            auto weights = std::vector<float>{};
+            edges.reserve(slots.size());
+            weights.reserve(slots.size());
+            for (const auto slot: slots) {
+                edges.push_back(graph.edges[slot]);
+                weights.push_back(graph.edge_weights[slot]);
+            }
+            result << "\"edges\":" << serialize_edges(std::move(edges)) << ",";
+            result << "\"edge_weights\":" << serialize_edge_weights(weights) << ",";
         }
-        result << "]" << "}";
-
-        logger.info(std::format("Graph serialization completed for graph with name {}", graph.name));
-        return result.str();
-    }
-
-    static auto serialize_database(Database &database) -> std::string {
-        logger.debug(std::format("Database serialization started"));
-        std::ostringstream result;
-
-        auto const &graphs = database.get_graphs();
-        result << "{";
-        result << "\"graphs\":[";
-        for (size_t i = 0; i < graphs.size(); ++i) {
-            result << serialize_graph(graphs[i]);
-            if (i + 1 < graphs.size()) result << ",";
+        result << "\"indexes\":[";
+        separator = "";
+        for (const auto &field: graph.ordered_indexes | std::views::keys) {
+            result << separator << "{\"field\":\"" << escape_json(field) << "\",\"kind\":\"ORDERED\"}";
+            separator = ",";
+        }
+        for (const auto &field: graph.ngram_indexes | std::views::keys) {
+            result << separator << "{\"field\":\"" << escape_json(field) << "\",\"kind\":\"NGRAM\"}";
+            separator = ",";
+        }
+        for (const auto &field: graph.bitmap_indexes | std::views::keys) {
+            result << separator << "{\"field\":\"" << escape_json(field) << "\",\"kind\":\"BITMAP\"}";
+            separator = ",";
         }
         result << "]" << "}";
 
-        logger.info(std::format("Database serialization completed"));
+        logger.info(std::format("Graph serialization completed for graph with name {}", graph.name));
         return result.str();
     }
 };
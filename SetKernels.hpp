@@ -0,0 +1,158 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef SET_KERNELS_HPP
+#define SET_KERNELS_HPP
+
+#include <bit>
+#include <cstdint>
+#include <span>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SET_KERNELS_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SET_KERNELS_SIMD 1
+#endif
+
+// Set operations over node slots. Sorted lists are intersected by comparing a block of 4 (SSE2) or
+// 8 (AVX2) values of each list all-against-all, by comparing one block with every rotation of the
+// other, and then dropping the block with the smaller last value. Bitsets are combined a whole
+// vector of words at a time. Builds without SIMD and tails shorter than a block use scalar loops.
+struct SetKernels {
+#if defined(__AVX2__)
+    struct Block {
+        using Vector = __m256i;
+        static constexpr size_t width = 8;
+
+        static auto load(const uint32_t *data) -> Vector {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        }
+
+        static auto load(const uint64_t *data) -> Vector {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        }
+
+        static auto store(uint64_t *data, const Vector v) -> void {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), v);
+        }
+
+        static auto both(const Vector a, const Vector b) -> Vector { return _mm256_and_si256(a, b); }
+
+        static auto either(const Vector a, const Vector b) -> Vector { return _mm256_or_si256(a, b); }
+
+        // Bit i is set when a[i] equals any value of b.
+        static auto matches(const Vector a, const Vector b) -> uint32_t {
+            auto any = _mm256_cmpeq_epi32(a, b);
+            for (int shift = 1; shift < 8; ++shift) {
+                const auto rotation = _mm256_setr_epi32(shift, shift + 1, shift + 2, shift + 3, shift + 4,
+                                                        shift + 5, shift + 6, shift + 7);
+                const auto rotated = _mm256_permutevar8x32_epi32(b, _mm256_and_si256(rotation, _mm256_set1_epi32(7)));
+                any = _mm256_or_si256(any, _mm256_cmpeq_epi32(a, rotated));
+            }
+            return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(any)));
+        }
+    };
+#elif defined(__SSE2__)
+    struct Block {
+        using Vector = __m128i;
+        static constexpr size_t width = 4;
+
+        static auto load(const uint32_t *data) -> Vector {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        }
+
+        static auto load(const uint64_t *data) -> Vector {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        }
+
+        static auto store(uint64_t *data, const Vector v) -> void {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data), v);
+        }
+
+        static auto both(const Vector a, const Vector b) -> Vector { return _mm_and_si128(a, b); }
+
+        static auto either(const Vector a, const Vector b) -> Vector { return _mm_or_si128(a, b); }
+
+        // Bit i is set when a[i] equals any value of b.
+        static auto matches(const Vector a, const Vector b) -> uint32_t {
+            const auto any = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+                _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                             _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)))));
+            return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(any)));
+        }
+    };
+#endif
+
+    struct Intersection {
+        static auto apply(const uint64_t a, const uint64_t b) -> uint64_t { return a & b; }
+#ifdef SET_KERNELS_SIMD
+        static auto apply(const Block::Vector a, const Block::Vector b) -> Block::Vector { return Block::both(a, b); }
+#endif
+    };
+
+    struct Union {
+        static auto apply(const uint64_t a, const uint64_t b) -> uint64_t { return a | b; }
+#ifdef SET_KERNELS_SIMD
+        static auto apply(const Block::Vector a, const Block::Vector b) -> Block::Vector { return Block::either(a, b); }
+#endif
+    };
+
+    // out = Op(a, b) word by word over bitsets of equal size. Returns the number of bits set in out.
+    template<typename Op>
+    static auto combine(const std::span<const uint64_t> a, const std::span<const uint64_t> b,
+                        const std::span<uint64_t> out) -> size_t {
+        auto vectorized = size_t{0};
+#ifdef SET_KERNELS_SIMD
+        constexpr auto step = sizeof(Block::Vector) / sizeof(uint64_t);
+        vectorized = out.size() - out.size() % step;
+        for (size_t i = 0; i < vectorized; i += step) {
+            Block::store(out.data() + i, Op::apply(Block::load(a.data() + i), Block::load(b.data() + i)));
+        }
+#endif
+        for (auto i = vectorized; i < out.size(); ++i) {
+            out[i] = Op::apply(a[i], b[i]);
+        }
+        size_t count = 0;
+        for (const auto word: out) {
+            count += static_cast<size_t>(std::popcount(word));
+        }
+        return count;
+    }
+
+    // Calls visit(value) for every value in both lists, in ascending order.
+    template<typename Visit>
+    static auto intersect(const std::span<const uint32_t> a, const std::span<const uint32_t> b, Visit visit) -> void {
+        size_t i = 0;
+        size_t j = 0;
+#ifdef SET_KERNELS_SIMD
+        constexpr auto width = Block::width;
+        while (i + width <= a.size() && j + width <= b.size()) {
+            for (auto mask = Block::matches(Block::load(a.data() + i), Block::load(b.data() + j)); mask != 0;
+                 mask &= mask - 1) {
+                visit(a[i + std::countr_zero(mask)]);
+            }
+            const auto a_last = a[i + width - 1];
+            const auto b_last = b[j + width - 1];
+            i += a_last <= b_last ? width : 0;
+            j += b_last <= a_last ? width : 0;
+        }
+#endif
+        while (i < a.size() && j < b.size()) {
+            if (a[i] < b[j]) {
+                ++i;
+            } else if (b[j] < a[i]) {
+                ++j;
+            } else {
+                visit(a[i]);
+                ++i;
+                ++j;
+            }
+        }
+    }
+};
+
+#endif //SET_KERNELS_HPP
@@ -0,0 +1,122 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "Value.hpp"
+
+// Planner statistics for one field of a graph's complex nodes: how many live nodes hold it, a
+// HyperLogLog sketch of its distinct values and a uniform reservoir sample of its values that
+// serves as the histogram. Any comparator can be estimated by evaluating it on the sample.
+// Inserts and updates feed the sketch and the sample; removals only lower the presence count,
+// everything is rebuilt exactly together with the indexes.
+class FieldStatistics {
+public:
+    static constexpr size_t sample_size = 256;
+    static constexpr int register_bits = 10;
+    static constexpr size_t registers = size_t{1} << register_bits;
+
+private:
+    size_t present = 0;
+    // Values offered to the reservoir so far.
+    size_t seen = 0;
+    std::vector<BasicValue> sample;
+    std::array<uint8_t, registers> ranks{};
+    uint64_t random = 0x9e3779b97f4a7c15;
+
+    static auto mix(uint64_t x) -> uint64_t {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111eb;
+        return x ^ x >> 31;
+    }
+
+    auto next_random() -> uint64_t {
+        random += 0x9e3779b97f4a7c15;
+        return mix(random);
+    }
+
+public:
+    auto add(const BasicValue &value) -> void {
+        ++present;
+        const auto hash = mix(std::hash<BasicValue::Data>{}(value.data));
+        auto &rank = ranks[hash >> (64 - register_bits)];
+        // The guard bit caps the rank once all remaining bits are zero.
+        const auto rest = hash << register_bits | uint64_t{1} << (register_bits - 1);
+        rank = std::max(rank, static_cast<uint8_t>(std::countl_zero(rest) + 1));
+
+        if (++seen <= sample_size) {
+            sample.push_back(value);
+        } else if (const auto slot = next_random() % seen; slot < sample_size) {
+            sample[slot] = value;
+        }
+    }
+
+    auto remove() -> void {
+        present -= present > 0 ? 1 : 0;
+    }
+
+    [[nodiscard]]
+    auto present_count() const -> size_t {
+        return present;
+    }
+
+    // HyperLogLog estimate, with linear counting while many registers are still empty.
+    [[nodiscard]]
+    auto distinct() const -> double {
+        auto sum = 0.0;
+        size_t zeros = 0;
+        for (const auto rank: ranks) {
+            sum += std::ldexp(1.0, -rank);
+            zeros += rank == 0 ? 1 : 0;
+        }
+        constexpr auto m = static_cast<double>(registers);
+        const auto estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        if (estimate <= 2.5 * m && zeros > 0) {
+            return m * std::log(m / static_cast<double>(zeros));
+        }
+        return estimate;
+    }
+
+    // Share of sampled values accepted by test, nullopt before any value was seen.
+    template<typename Test>
+    [[nodiscard]]
+    auto sampled_share(Test test) const -> std::optional<double> {
+        if (sample.empty()) {
+            return std::nullopt;
+        }
+        const auto accepted = std::ranges::count_if(sample, test);
+        return static_cast<double>(accepted) / static_cast<double>(sample.size());
+    }
+
+    [[nodiscard]]
+    auto sampled_count() const -> size_t {
+        return sample.size();
+    }
+
+    [[nodiscard]]
+    auto memory_usage() const -> size_t {
+        auto bytes = sizeof(FieldStatistics) + sample.capacity() * sizeof(BasicValue);
+        for (const auto &value: sample) {
+            if (const auto *text = std::get_if<std::string>(&value.data);
+                text != nullptr && text->capacity() > std::string().capacity()) {
+                bytes += text->capacity();
+            }
+        }
+        return bytes;
+    }
+};
+
+#endif //STATISTICS_HPP
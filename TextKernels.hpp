@@ -0,0 +1,258 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef TEXT_KERNELS_HPP
+#define TEXT_KERNELS_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TEXT_KERNELS_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXT_KERNELS_SIMD 1
+#endif
+
+// Character scanning for the text path. Each kernel classifies a whole block of 16 (SSE2) or 32 (AVX2)
+// bytes at once and returns the position of the first interesting character, so callers can copy the
+// runs in between with a single append. Builds without SIMD use the scalar loop for everything.
+struct TextKernels {
+#if defined(__AVX2__)
+    struct Block {
+        using Vector = __m256i;
+        static constexpr size_t width = 32;
+
+        static auto load(const char *data) -> Vector {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        }
+
+        static auto eq(const Vector v, const char c) -> Vector { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+
+        // Unsigned v <= limit for every byte.
+        static auto at_most(const Vector v, const char limit) -> Vector {
+            const auto bound = _mm256_set1_epi8(limit);
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(v, bound), v);
+        }
+
+        static auto add(const Vector v, const char c) -> Vector { return _mm256_add_epi8(v, _mm256_set1_epi8(c)); }
+
+        static auto either(const Vector a, const Vector b) -> Vector { return _mm256_or_si256(a, b); }
+
+        static auto mask(const Vector v) -> uint32_t { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+    };
+#elif defined(__SSE2__)
+    struct Block {
+        using Vector = __m128i;
+        static constexpr size_t width = 16;
+
+        static auto load(const char *data) -> Vector {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        }
+
+        static auto eq(const Vector v, const char c) -> Vector { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+
+        // Unsigned v <= limit for every byte.
+        static auto at_most(const Vector v, const char limit) -> Vector {
+            const auto bound = _mm_set1_epi8(limit);
+            return _mm_cmpeq_epi8(_mm_min_epu8(v, bound), v);
+        }
+
+        static auto add(const Vector v, const char c) -> Vector { return _mm_add_epi8(v, _mm_set1_epi8(c)); }
+
+        static auto either(const Vector a, const Vector b) -> Vector { return _mm_or_si128(a, b); }
+
+        static auto mask(const Vector v) -> uint32_t { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+    };
+#endif
+
+    // ASCII whitespace as accepted by std::isspace in the C locale: space and \t \n \v \f \r.
+    struct Space {
+        static auto matches(const unsigned char c) -> bool { return c == ' ' || (c >= '\t' && c <= '\r'); }
+#ifdef TEXT_KERNELS_SIMD
+        static auto matches(const Block::Vector v) -> Block::Vector {
+            return Block::either(Block::eq(v, ' '), Block::at_most(Block::add(v, static_cast<char>(-'\t')), '\r' - '\t'));
+        }
+#endif
+    };
+
+    // Characters escape_json has to rewrite.
+    struct JsonSpecial {
+        static auto matches(const unsigned char c) -> bool { return c == '"' || c == '\\' || c < 0x20; }
+#ifdef TEXT_KERNELS_SIMD
+        static auto matches(const Block::Vector v) -> Block::Vector {
+            return Block::either(Block::either(Block::eq(v, '"'), Block::eq(v, '\\')), Block::at_most(v, 0x1f));
+        }
+#endif
+    };
+
+    struct SpaceOrQuote {
+        static auto matches(const unsigned char c) -> bool { return c == '"' || Space::matches(c); }
+#ifdef TEXT_KERNELS_SIMD
+        static auto matches(const Block::Vector v) -> Block::Vector {
+            return Block::either(Block::eq(v, '"'), Space::matches(v));
+        }
+#endif
+    };
+
+    struct QuoteOrBackslash {
+        static auto matches(const unsigned char c) -> bool { return c == '"' || c == '\\'; }
+#ifdef TEXT_KERNELS_SIMD
+        static auto matches(const Block::Vector v) -> Block::Vector {
+            return Block::either(Block::eq(v, '"'), Block::eq(v, '\\'));
+        }
+#endif
+    };
+
+    struct Brace {
+        static auto matches(const unsigned char c) -> bool { return c == '{' || c == '}'; }
+#ifdef TEXT_KERNELS_SIMD
+        static auto matches(const Block::Vector v) -> Block::Vector {
+            return Block::either(Block::eq(v, '{'), Block::eq(v, '}'));
+        }
+#endif
+    };
+
+    struct SpaceOrBrace {
+        static auto matches(const unsigned char c) -> bool { return Brace::matches(c) || Space::matches(c); }
+#ifdef TEXT_KERNELS_SIMD
+        static auto matches(const Block::Vector v) -> Block::Vector {
+            return Block::either(Brace::matches(v), Space::matches(v));
+        }
+#endif
+    };
+
+    // First position in [position, end) holding a character of Class, or end.
+    template<typename Class>
+    static auto find_first(const char *position, const char *const end) -> const char * {
+#ifdef TEXT_KERNELS_SIMD
+        while (static_cast<size_t>(end - position) >= Block::width) {
+            if (const auto mask = Block::mask(Class::matches(Block::load(position))); mask != 0) {
+                return position + std::countr_zero(mask);
+            }
+            position += Block::width;
+        }
+#endif
+        while (position < end && !Class::matches(static_cast<unsigned char>(*position))) {
+            ++position;
+        }
+        return position;
+    }
+
+    static auto append_json_escaped(std::string &out, const std::string_view value) -> void {
+        static constexpr char hex[] = "0123456789abcdef";
+        const auto *position = value.data();
+        const auto *const end = value.data() + value.size();
+        while (position < end) {
+            const auto *special = find_first<JsonSpecial>(position, end);
+            out.append(position, special);
+            if (special == end) {
+                break;
+            }
+            switch (*special) {
+                case '"': out += "\\\"";
+                    break;
+                case '\\': out += "\\\\";
+                    break;
+                case '\b': out += "\\b";
+                    break;
+                case '\f': out += "\\f";
+                    break;
+                case '\n': out += "\\n";
+                    break;
+                case '\r': out += "\\r";
+                    break;
+                case '\t': out += "\\t";
+                    break;
+                default:
+                    out += "\\u00";
+                    out += hex[static_cast<unsigned char>(*special) >> 4];
+                    out += hex[static_cast<unsigned char>(*special) & 0xf];
+            }
+            position = special + 1;
+        }
+    }
+
+    // Drops whitespace outside of string literals. Escaped quotes do not end a literal.
+    static auto minify_json(const std::string_view json) -> std::string {
+        std::string result;
+        result.reserve(json.size());
+        const auto *position = json.data();
+        const auto *const end = json.data() + json.size();
+        while (position < end) {
+            const auto *special = find_first<SpaceOrQuote>(position, end);
+            result.append(position, special);
+            if (special == end) {
+                break;
+            }
+            position = special + 1;
+            if (*special != '"') {
+                continue;
+            }
+
+            result += '"';
+            while (position < end) {
+                const auto *stop = find_first<QuoteOrBackslash>(position, end);
+                result.append(position, stop);
+                if (stop == end) {
+                    position = end;
+                    break;
+                }
+                if (*stop == '"') {
+                    result += '"';
+                    position = stop + 1;
+                    break;
+                }
+                result.append(stop, std::min(stop + 2, end));
+                position = std::min(stop + 2, end);
+            }
+        }
+        return result;
+    }
+
+    // Collapses every whitespace run outside of braces to its first character. Text inside braces is
+    // copied unchanged, so JSON values keep their spacing.
+    static auto collapse_spaces(const std::string_view input) -> std::string {
+        std::string result;
+        result.reserve(input.size());
+        int depth = 0;
+        const auto *position = input.data();
+        const auto *const end = input.data() + input.size();
+        while (position < end) {
+            if (depth > 0) {
+                const auto *brace = find_first<Brace>(position, end);
+                result.append(position, brace);
+                if (brace == end) {
+                    break;
+                }
+                depth += *brace == '{' ? 1 : -1;
+                result += *brace;
+                position = brace + 1;
+                continue;
+            }
+
+            const auto *special = find_first<SpaceOrBrace>(position, end);
+            result.append(position, special);
+            if (special == end) {
+                break;
+            }
+            result += *special;
+            position = special + 1;
+            if (Brace::matches(static_cast<unsigned char>(*special))) {
+                depth += *special == '{' ? 1 : -1;
+            } else {
+                while (position < end && Space::matches(static_cast<unsigned char>(*position))) {
+                    ++position;
+                }
+            }
+        }
+        return result;
+    }
+};
+
+#endif //TEXT_KERNELS_HPP
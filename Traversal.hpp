@@ -0,0 +1,271 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef TRAVERSAL_HPP
+#define TRAVERSAL_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Adjacency.hpp"
+
+// Dense set of node slots, one bit per slot.
+class Bitset {
+    std::vector<uint64_t> words;
+
+public:
+    explicit Bitset(const size_t size = 0) : words((size + 63) / 64) {
+    }
+
+    auto set(const size_t slot) -> void {
+        words[slot / 64] |= uint64_t{1} << (slot % 64);
+    }
+
+    [[nodiscard]]
+    auto test(const size_t slot) const -> bool {
+        return (words[slot / 64] >> (slot % 64)) & 1;
+    }
+
+    auto clear() -> void {
+        std::ranges::fill(words, 0);
+    }
+
+    [[nodiscard]]
+    auto count() const -> size_t {
+        size_t total = 0;
+        for (const auto word: words) {
+            total += std::popcount(word);
+        }
+        return total;
+    }
+
+    template<typename Visitor>
+    auto for_each(Visitor visit) const -> void {
+        for (size_t index = 0; index < words.size(); ++index) {
+            for (auto word = words[index]; word != 0; word &= word - 1) {
+                visit(index * 64 + static_cast<size_t>(std::countr_zero(word)));
+            }
+        }
+    }
+};
+
+// Work done by a traversal, reported by PROFILE.
+struct TraversalStats {
+    size_t edges_examined = 0;
+    size_t bottom_up_levels = 0;
+    size_t nodes_settled = 0;
+};
+
+// Min-heap with four children per node. It is half as deep as a binary heap and the children of
+// one node share a cache line, so pops touch fewer lines. Pushes never look for existing keys;
+// callers skip stale entries instead of decreasing keys in place.
+template<typename Key, typename Value>
+class QuaternaryHeap {
+    std::vector<std::pair<Key, Value> > items;
+
+public:
+    [[nodiscard]]
+    auto empty() const -> bool {
+        return items.empty();
+    }
+
+    auto push(const Key key, const Value value) -> void {
+        auto hole = items.size();
+        items.emplace_back();
+        while (hole > 0) {
+            const auto parent = (hole - 1) / 4;
+            if (!(key < items[parent].first)) {
+                break;
+            }
+            items[hole] = items[parent];
+            hole = parent;
+        }
+        items[hole] = {key, value};
+    }
+
+    auto pop() -> std::pair<Key, Value> {
+        const auto top = items.front();
+        const auto last = items.back();
+        items.pop_back();
+        if (items.empty()) {
+            return top;
+        }
+        size_t hole = 0;
+        while (true) {
+            const auto first_child = hole * 4 + 1;
+            if (first_child >= items.size()) {
+                break;
+            }
+            auto smallest = first_child;
+            const auto end = std::min(first_child + 4, items.size());
+            for (auto child = first_child + 1; child < end; ++child) {
+                if (items[child].first < items[smallest].first) {
+                    smallest = child;
+                }
+            }
+            if (!(items[smallest].first < last.first)) {
+                break;
+            }
+            items[hole] = items[smallest];
+            hole = smallest;
+        }
+        items[hole] = last;
+        return top;
+    }
+};
+
+// Cheapest path between two node slots and its total weight.
+struct WeightedPath {
+    double cost = 0;
+    std::vector<uint32_t> slots;
+};
+
+struct Traversal {
+    // Beamer et al. thresholds: go bottom-up once the frontier touches more than 1/alpha of the
+    // unexplored edges, and back top-down once it shrinks below 1/beta of the nodes.
+    static constexpr size_t alpha = 14;
+    static constexpr size_t beta = 24;
+
+    // Breadth-first levels around source, up to max_depth hops. Level 0 is the source itself.
+    // forward expands the frontier, backward lists predecessors and is used by bottom-up steps,
+    // for an undirected traversal both are the same adjacency.
+    static auto levels_within(const Adjacency &forward, const Adjacency &backward, const uint32_t source,
+                              const int max_depth, TraversalStats *stats = nullptr)
+        -> std::vector<std::vector<uint32_t> > {
+        const auto node_count = forward.node_count();
+        auto levels = std::vector<std::vector<uint32_t> >{{source}};
+
+        auto visited = Bitset(node_count);
+        auto frontier_bits = Bitset(node_count);
+        visited.set(source);
+
+        size_t unexplored_edges = forward.edge_count() - forward.degree(source);
+        bool bottom_up = false;
+
+        for (int depth = 1; depth <= max_depth && !levels.back().empty(); ++depth) {
+            const auto &frontier = levels.back();
+
+            size_t frontier_edges = 0;
+            for (const auto slot: frontier) {
+                frontier_edges += forward.degree(slot);
+            }
+            if (!bottom_up && frontier_edges > unexplored_edges / alpha) {
+                bottom_up = true;
+            } else if (bottom_up && frontier.size() < node_count / beta) {
+                bottom_up = false;
+            }
+
+            auto next = std::vector<uint32_t>{};
+            size_t examined = bottom_up ? 0 : frontier_edges;
+            if (bottom_up) {
+                frontier_bits.clear();
+                for (const auto slot: frontier) {
+                    frontier_bits.set(slot);
+                }
+                // Every unvisited node looks for any parent in the frontier and stops at the first one,
+                // which is what keeps hub expansions cheap.
+                for (uint32_t slot = 0; slot < node_count; ++slot) {
+                    if (visited.test(slot)) {
+                        continue;
+                    }
+                    for (const auto parent: backward.neighbors(slot)) {
+                        ++examined;
+                        if (frontier_bits.test(parent)) {
+                            next.push_back(slot);
+                            break;
+                        }
+                    }
+                }
+                for (const auto slot: next) {
+                    visited.set(slot);
+                }
+            } else {
+                for (const auto slot: frontier) {
+                    for (const auto neighbor: forward.neighbors(slot)) {
+                        if (!visited.test(neighbor)) {
+                            visited.set(neighbor);
+                            next.push_back(neighbor);
+                        }
+                    }
+                }
+            }
+
+            for (const auto slot: next) {
+                unexplored_edges -= std::min(unexplored_edges, forward.degree(slot));
+            }
+            if (stats != nullptr) {
+                stats->edges_examined += examined;
+                stats->bottom_up_levels += bottom_up;
+            }
+            levels.push_back(std::move(next));
+        }
+
+        if (levels.back().empty()) {
+            levels.pop_back();
+        }
+        return levels;
+    }
+
+    // Dijkstra from source to target over non-negative weights, stopping as soon as the target is
+    // settled. An adjacency without weights counts every edge as 1.
+    static auto shortest_path(const Adjacency &adjacency, const uint32_t source, const uint32_t target,
+                              TraversalStats *stats = nullptr) -> std::optional<WeightedPath> {
+        constexpr auto unreached = std::numeric_limits<uint32_t>::max();
+        const auto node_count = adjacency.node_count();
+        auto distances = std::vector(node_count, std::numeric_limits<double>::infinity());
+        auto parents = std::vector(node_count, unreached);
+        auto settled = Bitset(node_count);
+        auto heap = QuaternaryHeap<double, uint32_t>{};
+
+        distances[source] = 0;
+        parents[source] = source;
+        heap.push(0, source);
+        size_t relaxed = 0;
+        size_t settled_count = 0;
+        while (!heap.empty()) {
+            const auto [distance, slot] = heap.pop();
+            if (settled.test(slot)) {
+                continue;
+            }
+            settled.set(slot);
+            ++settled_count;
+            if (slot == target) {
+                break;
+            }
+            const auto neighbors = adjacency.neighbors(slot);
+            const auto weights = adjacency.neighbor_weights(slot);
+            for (size_t i = 0; i < neighbors.size(); ++i) {
+                ++relaxed;
+                const auto neighbor = neighbors[i];
+                const auto candidate = distance + (weights.empty() ? 1.0 : static_cast<double>(weights[i]));
+                if (candidate < distances[neighbor]) {
+                    distances[neighbor] = candidate;
+                    parents[neighbor] = slot;
+                    heap.push(candidate, neighbor);
+                }
+            }
+        }
+        if (stats != nullptr) {
+            stats->edges_examined += relaxed;
+            stats->nodes_settled += settled_count;
+        }
+
+        if (parents[target] == unreached) {
+            return std::nullopt;
+        }
+        auto path = WeightedPath{distances[target], {target}};
+        for (auto slot = target; slot != source; slot = parents[slot]) {
+            path.slots.push_back(parents[slot]);
+        }
+        std::ranges::reverse(path.slots);
+        return path;
+    }
+};
+
+#endif //TRAVERSAL_HPP
@@ -6,68 +6,44 @@
 #define UTILS_HPP
 
 #include <string>
-#include <numeric>
+#include <vector>
+
+#include "TextKernels.hpp"
 
 struct Utils {
     static auto minify_json(const std::string_view json) -> std::string {
-        std::string result;
-        bool in_string = false;
-
-        for (const auto current: json) {
-            if (current == '"') {
-                in_string = !in_string;
-            }
-
-            const auto is_not_space = !std::isspace(static_cast<unsigned char>(current));
-            if (in_string || is_not_space) {
-                result += current;
-            }
-        }
-
-        return result;
+        return TextKernels::minify_json(json);
     }
 
     static auto trim(const std::string_view str) -> std::string {
         auto start = str.begin();
-        while (start != str.end() && std::isspace(*start)) {
+        while (start != str.end() && TextKernels::Space::matches(static_cast<unsigned char>(*start))) {
             ++start;
         }
 
         auto end = str.end();
-        do {
+        while (end != start && TextKernels::Space::matches(static_cast<unsigned char>(*(end - 1)))) {
             --end;
-        } while (std::distance(start, end) > 0 && std::isspace(*end));
+        }
 
-        return {start, end + 1};
+        return {start, end};
     }
 
     static auto remove_consecutive_spaces(const std::string_view input) -> std::string {
-        const auto trimmed = trim(input);
-        std::string result;
-        int braceCount = 0;
-
-        for (const char c: trimmed) {
-            if (c == '{') {
-                braceCount++;
-            } else if (c == '}') {
-                braceCount--;
-            }
-
-            if (braceCount > 0 || !std::isspace(c) || (result.empty() || !std::isspace(result.back()))) {
-                result += c;
-            }
-        }
-
-        return result;
+        return TextKernels::collapse_spaces(trim(input));
     }
 
     static auto get_rest_of_space_separated_string(
         const std::vector<std::string> &str,
         const int start) -> std::string {
-        return std::accumulate(str.begin() + start, str.end(), std::string{},
-                               [](const std::string &a, const std::string &b) {
-                                   return a.empty() ? b : a + " " + b;
-                               });
+        std::string result;
+        for (auto it = str.begin() + start; it != str.end(); ++it) {
+            if (!result.empty()) {
+                result += ' ';
+            }
+            result += *it;
+        }
+        return result;
     }
 };
 
@@ -0,0 +1,549 @@
+//
+// Created by agent on 18/10/2026.
+//
+
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <iterator>
+#include <compare>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+struct BasicValue {
+    using Data = std::variant<int, double, bool, std::string>;
+    Data data;
+
+    [[nodiscard]]
+    auto toString() const -> std::string {
+        return std::visit([]<typename T0>(const T0 &arg) -> std::string {
+            using T = std::decay_t<T0>;
+            if constexpr (std::same_as<T, bool>) {
+                return arg ? "true" : "false";
+            } else if constexpr (std::same_as<T, std::string>) {
+                return arg;
+            } else {
+                return std::to_string(arg);
+            }
+        }, this->data);
+    }
+
+    // Appends the same text as toString() without allocating a temporary string.
+    auto append_to(std::string &out) const -> void {
+        append_data(out, data);
+    }
+
+    // Shared with BasicValueView, whose strings are views.
+    template<typename Variant>
+    static auto append_data(std::string &out, const Variant &data) -> void {
+        std::visit([&out]<typename T0>(const T0 &arg) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::same_as<T, bool>) {
+                out += arg ? "true" : "false";
+            } else if constexpr (std::convertible_to<T, std::string_view>) {
+                out += arg;
+            } else if constexpr (std::same_as<T, int>) {
+                char buffer[16];
+                const auto [end, error] = std::to_chars(std::begin(buffer), std::end(buffer), arg);
+                out.append(buffer, end);
+            } else {
+                std::format_to(std::back_inserter(out), "{:f}", arg);
+            }
+        }, data);
+    }
+
+    [[nodiscard]]
+    auto is_numeric() const -> bool {
+        return std::holds_alternative<int>(data) || std::holds_alternative<double>(data);
+    }
+
+    [[nodiscard]]
+    auto as_number() const -> double {
+        if (std::holds_alternative<int>(data)) {
+            return std::get<int>(data);
+        }
+        return std::get<double>(data);
+    }
+
+    // Values of different kinds never compare as equal or ordered against each other, except ints and doubles.
+    // Ordering kinds by rank gives a total order usable as an index key.
+    [[nodiscard]]
+    auto rank() const -> int {
+        if (std::holds_alternative<bool>(data)) {
+            return 0;
+        }
+        if (is_numeric()) {
+            return 1;
+        }
+        return 2;
+    }
+
+    [[nodiscard]]
+    auto is_comparable_with(const BasicValue &other) const -> bool {
+        return rank() == other.rank();
+    }
+
+    [[nodiscard]]
+    auto operator<=>(const BasicValue &other) const -> std::partial_ordering {
+        if (const auto by_rank = rank() <=> other.rank(); by_rank != 0) {
+            return by_rank;
+        }
+        if (is_numeric()) {
+            return as_number() <=> other.as_number();
+        }
+        if (std::holds_alternative<bool>(data)) {
+            return std::get<bool>(data) <=> std::get<bool>(other.data);
+        }
+        return std::get<std::string>(data) <=> std::get<std::string>(other.data);
+    }
+
+    [[nodiscard]]
+    auto operator==(const BasicValue &other) const -> bool {
+        return (*this <=> other) == 0;
+    }
+};
+
+// Primitive field read in place from a UserDefinedValue, with strings pointing into its blob, so conditions
+// can test fields without allocating. Only valid while the value it was read from is unchanged. Compares
+// against BasicValue under the same rules as BasicValue itself.
+struct BasicValueView {
+    using Data = std::variant<int, double, bool, std::string_view>;
+    Data data;
+
+    [[nodiscard]]
+    auto is_numeric() const -> bool {
+        return std::holds_alternative<int>(data) || std::holds_alternative<double>(data);
+    }
+
+    [[nodiscard]]
+    auto as_number() const -> double {
+        if (std::holds_alternative<int>(data)) {
+            return std::get<int>(data);
+        }
+        return std::get<double>(data);
+    }
+
+    [[nodiscard]]
+    auto rank() const -> int {
+        if (std::holds_alternative<bool>(data)) {
+            return 0;
+        }
+        if (is_numeric()) {
+            return 1;
+        }
+        return 2;
+    }
+
+    [[nodiscard]]
+    auto is_comparable_with(const BasicValue &other) const -> bool {
+        return rank() == other.rank();
+    }
+
+    [[nodiscard]]
+    auto operator<=>(const BasicValue &other) const -> std::partial_ordering {
+        if (const auto by_rank = rank() <=> other.rank(); by_rank != 0) {
+            return by_rank;
+        }
+        if (is_numeric()) {
+            return as_number() <=> other.as_number();
+        }
+        if (std::holds_alternative<bool>(data)) {
+            return std::get<bool>(data) <=> std::get<bool>(other.data);
+        }
+        return std::get<std::string_view>(data) <=> std::string_view(std::get<std::string>(other.data));
+    }
+
+    [[nodiscard]]
+    auto operator==(const BasicValue &other) const -> bool {
+        return (*this <=> other) == 0;
+    }
+
+    auto append_to(std::string &out) const -> void {
+        BasicValue::append_data(out, data);
+    }
+};
+
+// Process-wide table of field names, so complex values store a small id per key instead of the key.
+// Names are only ever added, which keeps ids and the returned references stable.
+class FieldKeys {
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+public:
+    static auto instance() -> FieldKeys & {
+        static FieldKeys keys;
+        return keys;
+    }
+
+    auto intern(const std::string_view name) -> uint32_t {
+        if (const auto it = ids.find(name); it != ids.end()) {
+            return it->second;
+        }
+        const auto id = static_cast<uint32_t>(names.size());
+        ids.emplace(names.emplace_back(name), id);
+        return id;
+    }
+
+    [[nodiscard]]
+    auto lookup(const std::string_view name) const -> std::optional<uint32_t> {
+        const auto it = ids.find(name);
+        return it == ids.end() ? std::nullopt : std::optional(it->second);
+    }
+
+    [[nodiscard]]
+    auto name(const uint32_t id) const -> const std::string & {
+        return names.at(id);
+    }
+};
+
+struct UserDefinedValue {
+    using Field = std::variant<BasicValue, UserDefinedValue>;
+    using Data = std::vector<std::pair<std::string, Field> >;
+
+private:
+    // All fields in insertion order as one contiguous blob. Every field is a varint key id from FieldKeys,
+    // a tag byte and the payload: ints, doubles and bools are fixed-size little-endian, strings and nested
+    // objects are prefixed with their varint byte length. Small objects fit into the string's inline buffer.
+    std::string blob;
+
+    enum Tag : uint8_t { Int = 0, Double = 1, Bool = 2, String = 3, Object = 4 };
+
+    static auto validate_data(const Data &data) -> void {
+        const auto contains_name = std::ranges::find_if(data, [](const auto &pair) {
+            return pair.first == "name";
+        }) != data.end();
+        if (!contains_name) {
+            throw std::runtime_error("UserDefinedValue must have name specified");
+        }
+    }
+
+    static auto append_varint(std::string &out, uint32_t value) -> void {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static auto read_varint(const char *&pos) -> uint32_t {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            const auto byte = static_cast<uint8_t>(*pos++);
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+    }
+
+    template<typename T>
+    static auto append_fixed(std::string &out, T value) -> void {
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    template<typename T>
+    static auto read_fixed(const char *&pos) -> T {
+        T value;
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        return value;
+    }
+
+    static auto append_field(std::string &out, const std::string_view key, const Field &value) -> void {
+        append_varint(out, FieldKeys::instance().intern(key));
+        if (const auto *object = std::get_if<UserDefinedValue>(&value)) {
+            out += static_cast<char>(Object);
+            append_varint(out, static_cast<uint32_t>(object->blob.size()));
+            out += object->blob;
+            return;
+        }
+        std::visit([&out]<typename T0>(const T0 &arg) {
+            using T = std::decay_t<T0>;
+            if constexpr (std::same_as<T, int>) {
+                out += static_cast<char>(Int);
+                append_fixed(out, static_cast<int32_t>(arg));
+            } else if constexpr (std::same_as<T, double>) {
+                out += static_cast<char>(Double);
+                append_fixed(out, std::bit_cast<uint64_t>(arg));
+            } else if constexpr (std::same_as<T, bool>) {
+                out += static_cast<char>(Bool);
+                out += static_cast<char>(arg ? 1 : 0);
+            } else {
+                out += static_cast<char>(String);
+                append_varint(out, static_cast<uint32_t>(arg.size()));
+                out += arg;
+            }
+        }, std::get<BasicValue>(value).data);
+    }
+
+    // Reads the primitive payload at pos. Returns nothing for nested objects, which are skipped.
+    static auto read_basic(const Tag tag, const char *&pos) -> std::optional<BasicValue> {
+        const auto view = read_view(tag, pos);
+        if (!view) {
+            return std::nullopt;
+        }
+        return std::visit([]<typename T>(const T &arg) {
+            if constexpr (std::same_as<T, std::string_view>) {
+                return BasicValue(std::string(arg));
+            } else {
+                return BasicValue(arg);
+            }
+        }, view->data);
+    }
+
+    // Like read_basic, but strings stay in the blob.
+    static auto read_view(const Tag tag, const char *&pos) -> std::optional<BasicValueView> {
+        switch (tag) {
+            case Int:
+                return BasicValueView(static_cast<int>(read_fixed<int32_t>(pos)));
+            case Double:
+                return BasicValueView(std::bit_cast<double>(read_fixed<uint64_t>(pos)));
+            case Bool:
+                return BasicValueView(*pos++ != 0);
+            case String: {
+                const auto length = read_varint(pos);
+                pos += length;
+                return BasicValueView(std::string_view(pos - length, length));
+            }
+            case Object:
+                pos += read_varint(pos);
+                return std::nullopt;
+        }
+        throw std::runtime_error("Corrupted UserDefinedValue");
+    }
+
+    static auto skip_payload(const Tag tag, const char *&pos) -> void {
+        switch (tag) {
+            case Int: pos += sizeof(int32_t);
+                break;
+            case Double: pos += sizeof(uint64_t);
+                break;
+            case Bool: pos += 1;
+                break;
+            case String:
+            case Object:
+                pos += read_varint(pos);
+                break;
+        }
+    }
+
+    // Visits (key id, tag, payload position) of every field without decoding payloads.
+    // Stops early when visit returns true.
+    template<typename Visitor>
+    auto scan(Visitor visit) const -> void {
+        scan(blob, visit);
+    }
+
+    // Same over the encoded fields of a nested object.
+    template<typename Visitor>
+    static auto scan(const std::string_view bytes, Visitor visit) -> void {
+        const auto *pos = bytes.data();
+        const auto *const end = bytes.data() + bytes.size();
+        while (pos < end) {
+            const auto key = read_varint(pos);
+            const auto tag = static_cast<Tag>(*pos++);
+            if (visit(key, tag, pos)) {
+                return;
+            }
+            skip_payload(tag, pos);
+        }
+    }
+
+    // Writes the fields in bytes as "key: value" text, calling before_field(key) ahead of each one.
+    // Nested objects are written as append_to does, all without decoding into a Data.
+    template<typename BeforeField>
+    static auto append_fields(std::string &out, const std::string_view bytes, BeforeField before_field) -> void {
+        scan(bytes, [&](const uint32_t key, const Tag tag, const char *pos) {
+            before_field(FieldKeys::instance().name(key));
+            if (tag == Object) {
+                const auto length = read_varint(pos);
+                append_object(out, std::string_view(pos, length));
+            } else {
+                read_view(tag, pos)->append_to(out);
+            }
+            return false;
+        });
+    }
+
+    static auto append_object(std::string &out, const std::string_view bytes) -> void {
+        out += "{ ";
+        auto first = true;
+        append_fields(out, bytes, [&](const std::string &key) {
+            if (!first) {
+                out += ", ";
+            }
+            first = false;
+            out += '"';
+            out += key;
+            out += "\": ";
+        });
+        out += " }";
+    }
+
+    static auto from_blob(std::string blob) -> UserDefinedValue {
+        auto value = UserDefinedValue{};
+        value.blob = std::move(blob);
+        return value;
+    }
+
+public:
+    UserDefinedValue() = default;
+
+    ~UserDefinedValue() = default;
+
+    explicit UserDefinedValue(Data data) {
+        set_data(std::move(data));
+    }
+
+    auto set_data(Data data) -> void {
+        validate_data(data);
+        blob.clear();
+        for (const auto &[key, value]: data) {
+            append_field(blob, key, value);
+        }
+    }
+
+    // Materializes all fields. Use find() or find_value() when only some fields are needed.
+    [[nodiscard]]
+    auto get_data() const -> Data {
+        auto data = Data{};
+        scan([&data](const uint32_t key, const Tag tag, const char *pos) {
+            if (tag == Object) {
+                const auto length = read_varint(pos);
+                data.emplace_back(FieldKeys::instance().name(key), from_blob(std::string(pos, length)));
+            } else {
+                data.emplace_back(FieldKeys::instance().name(key), *read_basic(tag, pos));
+            }
+            return false;
+        });
+        return data;
+    }
+
+    // Replaces the value under key, or appends it when the key is new.
+    auto set_field(const std::string &key, Field value) -> void {
+        auto data = get_data();
+        const auto it = std::ranges::find_if(data, [&key](const auto &field) {
+            return field.first == key;
+        });
+        if (it != data.end()) {
+            it->second = std::move(value);
+        } else {
+            data.emplace_back(key, std::move(value));
+        }
+        set_data(std::move(data));
+    }
+
+    [[nodiscard]]
+    auto find(const std::string_view key) const -> std::optional<Field> {
+        auto result = std::optional<Field>{};
+        const auto id = FieldKeys::instance().lookup(key);
+        if (!id) {
+            return result;
+        }
+        scan([&](const uint32_t field_key, const Tag tag, const char *pos) {
+            if (field_key != *id) {
+                return false;
+            }
+            if (tag == Object) {
+                const auto length = read_varint(pos);
+                result = from_blob(std::string(pos, length));
+            } else {
+                result = *read_basic(tag, pos);
+            }
+            return true;
+        });
+        return result;
+    }
+
+    // Top level primitive under key, decoded without touching any other field.
+    [[nodiscard]]
+    auto find_value(const std::string_view key) const -> std::optional<BasicValue> {
+        auto result = std::optional<BasicValue>{};
+        const auto id = FieldKeys::instance().lookup(key);
+        if (!id) {
+            return result;
+        }
+        scan([&](const uint32_t field_key, const Tag tag, const char *pos) {
+            if (field_key != *id) {
+                return false;
+            }
+            result = read_basic(tag, pos);
+            return true;
+        });
+        return result;
+    }
+
+    // Same as find_value, but a string is viewed in place instead of copied.
+    [[nodiscard]]
+    auto find_view(const std::string_view key) const -> std::optional<BasicValueView> {
+        auto result = std::optional<BasicValueView>{};
+        const auto id = FieldKeys::instance().lookup(key);
+        if (!id) {
+            return result;
+        }
+        scan([&](const uint32_t field_key, const Tag tag, const char *pos) {
+            if (field_key != *id) {
+                return false;
+            }
+            result = read_view(tag, pos);
+            return true;
+        });
+        return result;
+    }
+
+    // Calls visit(key id, value) for every top level primitive field, nested objects are skipped.
+    template<typename Visitor>
+    auto for_each_value(Visitor visit) const -> void {
+        scan([&visit](const uint32_t key, const Tag tag, const char *pos) {
+            if (tag != Object) {
+                visit(key, *read_basic(tag, pos));
+            }
+            return false;
+        });
+    }
+
+    // Bytes owned by this value, for memory accounting.
+    [[nodiscard]]
+    auto encoded_size() const -> size_t {
+        return blob.size();
+    }
+
+    [[nodiscard]]
+    auto toString() const -> std::string {
+        std::string result;
+        append_to(result);
+        return result;
+    }
+
+    auto append_to(std::string &out) const -> void {
+        append_object(out, blob);
+    }
+
+    // Appends every top level field as "key: value" text, calling before_field(key) ahead of each one.
+    template<typename BeforeField>
+    auto append_fields_to(std::string &out, BeforeField before_field) const -> void {
+        append_fields(out, blob, before_field);
+    }
+};
+
+#endif //VALUE_HPP
@@ -1,19 +1,37 @@
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <fmt/core.h>
 #include <__algorithm/ranges_contains.h>
 
 #include "Database.hpp"
+#include "LineReader.hpp"
 #include "Logger.hpp"
 #include "Utils.hpp"
 
 void repl(Database &db);
 
+auto open_database(DatabaseConfig config) -> std::unique_ptr<Database>;
+
+auto run_batch(Database &db, std::FILE *input) -> void;
+
 auto main(const int argc, char *argv[]) -> int {
     int log_level = 0;
+    std::optional<std::string> exec_path;
+    bool batch = false;
+    std::optional<int> sync_every;
+    std::optional<std::string> metrics_path;
+    std::optional<int> metrics_interval;
+    size_t memory_budget_mib = 0;
+    bool replica = false;
+    std::optional<int> max_staleness;
+    bool verify = false;
     for (int i = 1; i < argc; ++i) {
         if (std::string arg = argv[i]; arg.rfind("--log-level=", 0) == 0) {
             try {
-                std::string level_str = arg.substr(14);
+                std::string level_str = arg.substr(12);
                 log_level = std::stoi(level_str);
                 if (log_level < 0) {
                     throw std::invalid_argument("Trace level cannot be negative.");
@@ -23,19 +41,145 @@ auto main(const int argc, char *argv[]) -> int {
                         std::endl;
                 return 1;
             }
+        } else if (arg == "--exec" && i + 1 < argc) {
+            exec_path = argv[++i];
+        } else if (arg.rfind("--exec=", 0) == 0) {
+            exec_path = arg.substr(7);
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg.rfind("--sync-every=", 0) == 0) {
+            try {
+                sync_every = std::stoi(arg.substr(13));
+                if (*sync_every <= 0) {
+                    throw std::invalid_argument("Sync interval must be positive.");
+                }
+            } catch (const std::exception &e) {
+                std::cerr << "Invalid sync interval. It should be a positive number of statements. Instead it is: "
+                        << arg << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--metrics-file=", 0) == 0) {
+            metrics_path = arg.substr(15);
+        } else if (arg.rfind("--metrics-interval=", 0) == 0) {
+            try {
+                metrics_interval = std::stoi(arg.substr(19));
+                if (*metrics_interval <= 0) {
+                    throw std::invalid_argument("Metrics interval must be positive.");
+                }
+            } catch (const std::exception &e) {
+                std::cerr << "Invalid metrics interval. It should be a positive number of seconds. Instead it is: "
+                        << arg << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--memory-budget=", 0) == 0) {
+            try {
+                const auto budget = std::stoi(arg.substr(16));
+                if (budget <= 0) {
+                    throw std::invalid_argument("Memory budget must be positive.");
+                }
+                memory_budget_mib = static_cast<size_t>(budget);
+            } catch (const std::exception &e) {
+                std::cerr << "Invalid memory budget. It should be a positive number of MiB. Instead it is: "
+                        << arg << std::endl;
+                return 1;
+            }
+        } else if (arg == "--replica") {
+            replica = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg.rfind("--max-staleness=", 0) == 0) {
+            try {
+                max_staleness = std::stoi(arg.substr(16));
+                if (*max_staleness < 0) {
+                    throw std::invalid_argument("Staleness cannot be negative.");
+                }
+            } catch (const std::exception &e) {
+                std::cerr << "Invalid staleness. It should be a number of milliseconds. Instead it is: "
+                        << arg << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << std::format("Unknown argument: {}", arg) << std::endl;
+            return 1;
         }
     }
     Logger::set_log_level(log_level);
 
-    const auto db_config = DatabaseConfig(100);
-    auto db = Database(db_config);
-    repl(db);
+    if (verify) {
+        Logger::set_quiet(log_level == 0);
+        return Database::verify_storage() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
+    if (!exec_path && !batch) {
+        auto db_config = DatabaseConfig(sync_every.value_or(100));
+        db_config.metrics_path = metrics_path;
+        db_config.metrics_interval = std::chrono::seconds(metrics_interval.value_or(10));
+        db_config.memory_budget = memory_budget_mib * 1024 * 1024;
+        db_config.replica = replica;
+        db_config.max_staleness = std::chrono::milliseconds(max_staleness.value_or(0));
+        auto db = open_database(db_config);
+        if (!db) {
+            return EXIT_FAILURE;
+        }
+        repl(*db);
+        return EXIT_SUCCESS;
+    }
+
+    // Batch runs sync once at the end unless an interval is given, and do not log every statement.
+    Logger::set_quiet(log_level == 0);
+    std::FILE *input = stdin;
+    if (exec_path) {
+        input = std::fopen(exec_path->c_str(), "rb");
+        if (input == nullptr) {
+            std::cerr << std::format("Failed to open script {}", *exec_path) << std::endl;
+            return 1;
+        }
+    }
+
+    auto db_config = DatabaseConfig(sync_every.value_or(std::numeric_limits<int>::max()));
+    db_config.metrics_path = metrics_path;
+    db_config.metrics_interval = std::chrono::seconds(metrics_interval.value_or(10));
+    db_config.memory_budget = memory_budget_mib * 1024 * 1024;
+    db_config.replica = replica;
+    db_config.max_staleness = std::chrono::milliseconds(max_staleness.value_or(0));
+    auto db = open_database(db_config);
+    if (!db) {
+        return EXIT_FAILURE;
+    }
+    run_batch(*db, input);
+    if (input != stdin) {
+        std::fclose(input);
+    }
     return EXIT_SUCCESS;
 }
 
+// Restores the database, or reports why it can not be restored and returns nothing.
+auto open_database(const DatabaseConfig config) -> std::unique_ptr<Database> {
+    try {
+        return std::make_unique<Database>(config);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
 void display_help();
 
+namespace {
+    auto const exit_commands = std::vector<std::string>{"exit", "quit"};
+
+    // Parses and executes one statement. Returns false when it was rejected or its handler reported a failure.
+    auto execute_line(Database &db, const std::string &command) -> bool {
+        try {
+            if (auto query = Query::from_string(command); query.has_value()) {
+                return db.execute_query(query.value());
+            }
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+        return false;
+    }
+}
 
 void repl(Database &db) {
     namespace rg = std::ranges;
@@ -44,13 +188,17 @@ void repl(Database &db) {
     fmt::println("Type 'help' for list of options.");
     fmt::println("Type 'exit' or 'quit' to exit and save database.");
 
-    auto const exit_commands = std::vector<std::string>{"exit", "quit"};
-
     while (true) {
+        db.flush_log();
         fmt::print("> ");
         std::string command;
-        std::getline(std::cin, command);
+        if (!std::getline(std::cin, command)) {
+            break;
+        }
         command = Utils::remove_consecutive_spaces(command);
+        if (command.empty()) {
+            continue;
+        }
         if (rg::contains(exit_commands, command)) {
             break;
         }
@@ -59,10 +207,43 @@ void repl(Database &db) {
             display_help();
             continue;
         }
-        if (auto query = Query::from_string(command); query.has_value()) {
-            db.execute_query(query.value());
+        execute_line(db, command);
+    }
+}
+
+// Executes statements back to back without prompts. Blank lines and lines starting with # are skipped.
+// Statistics go to stderr so query output on stdout stays machine-readable.
+auto run_batch(Database &db, std::FILE *input) -> void {
+    namespace rg = std::ranges;
+
+    const auto started = std::chrono::steady_clock::now();
+    auto reader = LineReader(input);
+    std::string line;
+    size_t line_number = 0;
+    size_t executed = 0;
+    size_t failed = 0;
+    while (reader.next(line)) {
+        ++line_number;
+        const auto command = Utils::remove_consecutive_spaces(line);
+        if (command.empty() || command.front() == '#') {
+            continue;
+        }
+        if (rg::contains(exit_commands, command)) {
+            break;
+        }
+        if (execute_line(db, command)) {
+            ++executed;
+        } else {
+            ++failed;
+            std::cerr << std::format("Statement on line {} failed: {}", line_number, command) << std::endl;
         }
     }
+    db.synchronize();
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cerr << std::format("Executed {} statement(s), {} failed, in {:.3f} s ({:.0f} statements/s)",
+                             executed, failed, seconds, static_cast<double>(executed + failed) / std::max(seconds, 1e-9))
+            << std::endl;
 }
 
 void display_help() {
@@ -74,6 +255,24 @@ void display_help() {
     std::println("  CREATE GRAPH [name]");
     std::println("    - Creates a new graph. Example: CREATE GRAPH firefighters");
 
+    std::println("  SET STORAGE MAPPED/MEMORY");
+    std::println("    - Keeps the edges and adjacency of the current graph in a memory-mapped file, for graphs");
+    std::println("      larger than RAM, or moves them back into memory. Example: SET STORAGE MAPPED");
+    std::println("  REORDER GRAPH [BFS/DEGREE/RCM]");
+    std::println("    - Stores the nodes of the current graph in an order that keeps neighbours close in memory,");
+    std::println("      node ids stay the same. Defaults to BFS. Example: REORDER GRAPH RCM");
+
+    std::println("  CREATE ORDERED INDEX ON [field]");
+    std::println("    - Indexes a field of complex nodes to speed up EQ and range conditions.");
+    std::println(R"(      Example: CREATE ORDERED INDEX ON "age")");
+    std::println("  CREATE NGRAM INDEX ON [field]");
+    std::println("    - Indexes trigrams of a string field to speed up CONTAINS and STARTS WITH conditions.");
+    std::println(R"(      Example: CREATE NGRAM INDEX ON "name")");
+    std::println("  CREATE BITMAP INDEX ON [field]");
+    std::println("    - Keeps a compressed slot bitmap per value of a low-cardinality field. Conditions on such");
+    std::println("      fields combine with AND/OR as bitmap operations without reading nodes.");
+    std::println(R"(      Example: CREATE BITMAP INDEX ON "position")");
+
     std::println("\nNode Commands:");
     std::println("  INSERT NODE [data]");
     std::println("    - Adds a node with primitive data. Example: INSERT NODE \"Mariusz\"");
@@ -85,15 +284,34 @@ void display_help() {
     std::println("  UPDATE NODE [node.id] TO COMPLEX [JSON]");
     std::println("    - Updates a node with user-defined structured data.");
     std::println(R"(      Example: UPDATE NODE 1 TO COMPLEX {{"name":"manager", "level":3}})");
+    std::println("  DELETE NODE [node.id]");
+    std::println("    - Deletes a node together with its edges. Example: DELETE NODE 1");
     std::println("  SELECT NODE [node.id]");
     std::println("    - Displays data for a specific node. Example: SELECT NODE 1");
-    std::println("  SELECT NODE WHERE [field] EQ/NEQ [value]");
-    std::println("    - Queries nodes that meet specified conditions.");
+    std::println("  SELECT NODE WHERE [field] EQ/NEQ/LT/LTE/GT/GTE [value]");
+    std::println("    - Queries nodes that meet specified conditions. AND binds tighter than OR.");
     std::println(R"(      Example: SELECT NODE WHERE "position" EQ "manager" AND "age" NEQ 40)");
+    std::println("  SELECT NODE WHERE [field] BETWEEN [low] AND [high]");
+    std::println("    - Queries nodes with field value in the inclusive range.");
+    std::println(R"(      Example: SELECT NODE WHERE "age" BETWEEN 30 AND 40)");
+    std::println("  SELECT NODE WHERE [field] STARTS WITH/CONTAINS [text]");
+    std::println("    - Queries nodes whose string field starts with or contains the text.");
+    std::println(R"(      Example: SELECT NODE WHERE "name" STARTS WITH "Jo")");
+    std::println("  SELECT NODE WHERE [conditions] LIMIT [n] OFFSET [m] FORMAT TEXT/JSONL/BINARY");
+    std::println("    - Optional clauses for paging and machine-readable output.");
+    std::println(R"(      Example: SELECT NODE WHERE "position" EQ "manager" LIMIT 10 FORMAT JSONL)");
+    std::println("  SELECT COUNT(*)/COUNT/SUM/AVG/MIN/MAX([field]), ... WHERE [conditions] GROUP BY [field]");
+    std::println("    - Aggregates node fields in a single pass. WHERE and GROUP BY are optional.");
+    std::println(R"(      Example: SELECT COUNT(*), AVG("age") WHERE "age" GT 30 GROUP BY "position")");
 
     std::println("\nEdge Commands:");
     std::println("  INSERT EDGE FROM [node.id] TO [node.id]");
     std::println("    - Creates a connection between two nodes. Example: INSERT EDGE FROM 1 TO 2");
+    std::println("  INSERT EDGE FROM [node.id] TO [node.id] WEIGHT [number]");
+    std::println("    - Creates a weighted connection, edges without WEIGHT weigh 1.");
+    std::println("      Example: INSERT EDGE FROM 1 TO 2 WEIGHT 2.5");
+    std::println("  DELETE EDGE FROM [node.id] TO [node.id]");
+    std::println("    - Removes connections between two nodes. Example: DELETE EDGE FROM 1 TO 2");
 
     std::println("\nQuery and Connection Commands:");
     std::println("  IS [node.id] CONNECTED TO [node.id]");
@@ -102,6 +320,37 @@ void display_help() {
     std::println("  IS [node.id] CONNECTED DIRECTLY TO [node.id]");
     std::println("    - Checks if there is a direct connection between two nodes.");
     std::println("      Example: IS 2 CONNECTED DIRECTLY TO 3");
+    std::println("  NEIGHBORS OF [node.id] WITHIN [hops] [DIRECTED]");
+    std::println("    - Lists nodes reachable within given number of hops, level by level.");
+    std::println("      Example: NEIGHBORS OF 1 WITHIN 3");
+    std::println("  WEIGHTED PATH FROM [node.id] TO [node.id] [DIRECTED]");
+    std::println("    - Finds the cheapest path between two nodes by edge weight.");
+    std::println("      Example: WEIGHTED PATH FROM 1 TO 5");
+    std::println("  MATCH ([var])-([var])->([var])<-([var]) WHERE [var].[condition] AND ... LIMIT [n]");
+    std::println("    - Finds paths of distinct nodes connected as in the pattern. WHERE and LIMIT are optional.");
+    std::println(R"(      Example: MATCH (a)-(b) WHERE a."position" EQ "manager" AND b."age" GT 40)");
+
+    std::println("\nAnalytics Commands:");
+    std::println("  ANALYZE PAGERANK/DEGREES/SCC/TRIANGLES/CLUSTERING [INTO field]");
+    std::println("    - Runs a whole-graph algorithm, optionally storing per-node results in a field.");
+    std::println("      TRIANGLES stores triangle counts and CLUSTERING local clustering coefficients.");
+    std::println(R"(      Example: ANALYZE PAGERANK INTO "rank")");
+
+    std::println("\nTransaction Commands:");
+    std::println("  BEGIN / COMMIT / ROLLBACK");
+    std::println("    - Queues mutations until COMMIT, which logs and applies them together, or ROLLBACK.");
+    std::println("      Reads inside a transaction see committed data only, and USE is not allowed.");
+
+    std::println("\nDiagnostics Commands:");
+    std::println("  STATS");
+    std::println("    - Shows statement counts and latency percentiles per command, snapshot write times");
+    std::println("      and node, edge and memory figures for every graph.");
+    std::println("  EXPLAIN [statement]");
+    std::println("    - Shows the plan of a statement without running it: index or full scan, condition order,");
+    std::println(R"(      traversal algorithm. Example: EXPLAIN SELECT NODE WHERE "age" GT 30)");
+    std::println("  PROFILE [statement]");
+    std::println("    - Runs a statement and reports time and allocations per stage, rows examined,");
+    std::println("      conditions evaluated and nodes and edges visited. Example: PROFILE IS 1 CONNECTED TO 5");
 
     std::println("\nOther Commands:");
     std::println("  HELP");